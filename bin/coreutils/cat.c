@@ -1,24 +1,30 @@
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-void cat_f(FILE *f) {
-    char buff[1024];
-    while (!feof(f)) {
-        size_t n = fread(buff, sizeof(char), sizeof(buff), f);
-        fwrite(buff, sizeof(char), n, stdout);
+// the kernel moves the data. files on the initrd go straight from memory to
+// the tty, or into a pipe by reference.
+void cat_fd(int fd) {
+    ssize_t n;
+    while ((n = splice(fd, STDOUT_FILENO, 1 << 16)) > 0) {
+    }
+
+    if (n == -1) {
+        perror("splice(2)");
     }
 }
 
 void cat(const char *file) {
     if (file[0] == '-' && file[1] == '\0') {
-        cat_f(stdin);
+        cat_fd(STDIN_FILENO);
     } else {
-        FILE *f = fopen(file, "r");
-        if (f == NULL) {
-            perror("fopen(3)");
+        int fd = open(file, 0);
+        if (fd == -1) {
+            perror("open(2)");
             return;
         }
-        cat_f(f);
-        fclose(f);
+        cat_fd(fd);
+        close(fd);
     }
 
 }
@@ -26,7 +32,7 @@ void cat(const char *file) {
 int main (int argc, char *argv[]) {
 
     if (argc == 1) {
-        cat_f(stdin);
+        cat_fd(STDIN_FILENO);
     } else {
         for (size_t i = 1; i < argc; ++i) {
             cat(argv[i]);
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+
+// irqstat [samples]: what /dev/irqstat went up by, each second. the
+// cycles are also shown as a share of the cycles that went by
+
+#define MAX_ENTRIES 600
+
+struct entry {
+    char name[16];
+    uint64_t count;
+    uint64_t cycles;
+};
+
+static struct entry prev[MAX_ENTRIES], cur[MAX_ENTRIES];
+static char text[MAX_ENTRIES * 64];
+
+static uint64_t rdtsc(void) {
+    uint64_t tsc;
+    asm volatile ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+static const char *parse_num(const char *p, uint64_t *n) {
+    *n = 0;
+    while (*p >= '0' && *p <= '9') {
+        *n = *n * 10 + (*p++ - '0');
+    }
+    return p;
+}
+
+// returns the number of entries, or -1
+static int sample(struct entry *e) {
+    int fd = open("/dev/irqstat", 0);
+    if (fd == -1) {
+        perror("open(2)");
+        return -1;
+    }
+    size_t len = 0;
+    ssize_t n;
+    while ((n = read(fd, text + len, sizeof(text) - 1 - len)) > 0) {
+        len += n;
+    }
+    close(fd);
+    if (n == -1) {
+        perror("read(2)");
+        return -1;
+    }
+    text[len] = '\0';
+
+    int ne = 0;
+    const char *p = text;
+    while (*p != '\0' && ne < MAX_ENTRIES) {
+        size_t i = 0;
+        while (*p != ' ' && *p != '\0') {
+            if (i < sizeof(e[ne].name) - 1) {
+                e[ne].name[i++] = *p;
+            }
+            ++p;
+        }
+        e[ne].name[i] = '\0';
+        p = parse_num(p + (*p == ' '), &e[ne].count);
+        p = parse_num(p + (*p == ' '), &e[ne].cycles);
+        while (*p != '\n' && *p != '\0') {
+            ++p;
+        }
+        p += (*p == '\n');
+        ++ne;
+    }
+    return ne;
+}
+
+static const struct entry *find(const struct entry *e, int ne,
+                                const char *name) {
+    for (int i = 0; i < ne; ++i) {
+        if (strcmp(e[i].name, name) == 0) {
+            return &e[i];
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int samples = (argc > 1)? atoi(argv[1]) : 1;
+
+    int nprev = sample(prev);
+    if (nprev == -1) {
+        return 1;
+    }
+    uint64_t tsc = rdtsc();
+
+    for (int s = 0; s < samples; ++s) {
+        // nothing to wait on but the timeout
+        poll(NULL, 0, 1000);
+
+        int ncur = sample(cur);
+        if (ncur == -1) {
+            return 1;
+        }
+        uint64_t now = rdtsc();
+        uint64_t elapsed = now - tsc;
+
+        printf("name count/s cycles/s\n");
+        for (int i = 0; i < ncur; ++i) {
+            const struct entry *old = find(prev, nprev, cur[i].name);
+            uint64_t count = cur[i].count - ((old != NULL)? old->count : 0);
+            uint64_t cycles = cur[i].cycles - ((old != NULL)? old->cycles : 0);
+            if (count == 0) {
+                continue;
+            }
+
+            printf("%s %llu %llu", cur[i].name, count, cycles);
+            if (cycles != 0 && elapsed != 0) {
+                uint64_t permille = cycles * 1000 / elapsed;
+                printf(" (%llu.%llu%%)", permille / 10, permille % 10);
+            }
+            printf("\n");
+        }
+        fflush(stdout);
+
+        memcpy(prev, cur, sizeof(struct entry) * ncur);
+        nprev = ncur;
+        tsc = now;
+    }
+    return 0;
+}
@@ -2,19 +2,56 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <stdbool.h>
 
 #include <string.h>
 
+static bool longp = false;
+
+static char type_char(uint8_t type) {
+    if (type == DT_DIR) {
+        return 'd';
+    } else if (type == DT_CHR) {
+        return 'c';
+    } else if (type == DT_FIFO) {
+        return 'p';
+    } else if (type == DT_LNK) {
+        return 'l';
+    } else if (type == DT_REG) {
+        return '-';
+    }
+    return '?';
+}
+
+static void print_dent(const struct petix_dirent_stat *d) {
+    if (longp) {
+        printf("%c%s %li %s\n", type_char(d->type),
+               d->exec? "rwxr-xr-x" : "rw-r--r--",
+               (long) d->size, d->name);
+    } else {
+        printf("%s\n", d->name);
+    }
+}
 
 int main(int argc, char *argv[]) {
-    if (argc > 2) {
-        fprintf(stderr, "usage: %s dir\n", argv[0]);
+    int opt;
+    while ((opt = getopt(argc, argv, "l")) != -1) {
+        if (opt == 'l') {
+            longp = true;
+        } else {
+            fprintf(stderr, "usage: %s [-l] dir\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind > 1) {
+        fprintf(stderr, "usage: %s [-l] dir\n", argv[0]);
         return 1;
     }
 
     const char *dir = "/";
-    if (argc == 2) {
-        dir = argv[1];
+    if (argc - optind == 1) {
+        dir = argv[optind];
     }
 
     int fd = open(dir, O_DIRECTORY);
@@ -23,16 +60,20 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    struct petix_dirent dent;
+    // entries come with their type and size, so -l needs no stat calls
+    static char buff[4096] __attribute__((aligned(8)));
 
-    while (1) {
-        int ret = getdent(fd, &dent);
-        if (ret == -1) {
-            perror("getdent(2)");
+    ssize_t n;
+    while ((n = getdents(fd, buff, sizeof(buff))) > 0) {
+        for (ssize_t off = 0; off < n;) {
+            const struct petix_dirent_stat *d = (void *) (buff + off);
+            print_dent(d);
+            off += d->reclen;
         }
-        if (!dent.present) break;
+    }
 
-        printf("%s\n", dent.name);
+    if (n == -1) {
+        perror("getdents(2)");
     }
 
     close(fd);
@@ -0,0 +1,116 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/vdata.h>
+
+// block device throughput.
+//
+// sequential: reads the device from the start twice. the buffer cache
+// holds 1 MB, so with that or less the second pass is served from memory.
+// random (-r): 4 KB reads at random blocks, in MB/s and reads per second.
+//
+// usage: blkbench [-r] [dev] [MB]
+
+#define CHUNK (64 * 1024)
+#define BLOCK 4096
+
+char buf[CHUNK];
+
+static void report(const char *what, size_t n, uint64_t ns) {
+    // the clock only moves once a tick
+    if (ns == 0) {
+        printf("blkbench: %s: %lu KB in under a tick\n", what,
+               (unsigned long) n / 1024);
+        return;
+    }
+    unsigned long kbs = (uint64_t) n * 1000000000 / 1024 / ns;
+    printf("blkbench: %s: %lu KB in %lu ms, %lu.%02lu MB/s\n", what,
+           (unsigned long) n / 1024, (unsigned long) (ns / 1000000),
+           kbs / 1024, (kbs % 1024) * 100 / 1024);
+}
+
+static int sequential(int fd, size_t len) {
+    lseek(fd, 0, SEEK_SET);
+
+    uint64_t start = vdata_monotonic_ns();
+    size_t n = 0;
+    ssize_t ret = 0;
+    while (n < len && (ret = read(fd, buf, CHUNK)) > 0) {
+        n += ret;
+    }
+    uint64_t ns = vdata_monotonic_ns() - start;
+
+    if (ret == -1) {
+        perror("read(2)");
+        return -1;
+    }
+    report("sequential", n, ns);
+    return 0;
+}
+
+static int random_reads(int fd, size_t len) {
+    off_t size = lseek(fd, 0, SEEK_END);
+    size_t nblocks = size / BLOCK;
+    if (nblocks == 0) {
+        printf("blkbench: empty device\n");
+        return -1;
+    }
+
+    uint32_t seed = 12345;
+    size_t count = len / BLOCK;
+
+    uint64_t start = vdata_monotonic_ns();
+    for (size_t i = 0; i < count; ++i) {
+        seed = seed * 1103515245 + 12345;
+        off_t off = (off_t) ((seed >> 8) % nblocks) * BLOCK;
+        if (pread(fd, buf, BLOCK, off) != BLOCK) {
+            perror("pread(2)");
+            return -1;
+        }
+    }
+    uint64_t ns = vdata_monotonic_ns() - start;
+
+    report("random 4k", count * BLOCK, ns);
+    if (ns != 0) {
+        printf("blkbench: %lu reads/s\n",
+               (unsigned long) ((uint64_t) count * 1000000000 / ns));
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    int rand = 0;
+    while ((opt = getopt(argc, argv, "r")) != -1) {
+        if (opt == 'r') {
+            rand = 1;
+        } else {
+            printf("usage: blkbench [-r] [dev] [MB]\n");
+            return 1;
+        }
+    }
+
+    const char *path = (optind < argc)? argv[optind] : "/dev/hda";
+    size_t len = ((optind + 1 < argc)? atoi(argv[optind + 1]) : 16)
+                 * 1024 * 1024;
+
+    int fd = open(path, 0);
+    if (fd == -1) {
+        perror("open(2)");
+        return 1;
+    }
+
+    int ret;
+    if (rand) {
+        ret = random_reads(fd, len);
+    } else {
+        ret = sequential(fd, len);
+        if (ret == 0) {
+            ret = sequential(fd, len);
+        }
+    }
+
+    close(fd);
+    return (ret < 0)? 1 : 0;
+}
@@ -0,0 +1,69 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+
+// writes a pattern through a block device, crossing block boundaries, and
+// reads it back. what was there is put back after, since the disk may hold
+// a mounted fs. needs a ram disk, see make run-ramdisk
+
+#define LEN (64 * 1024)
+#define OFF 1000
+
+char buf[LEN];
+char back[LEN];
+char saved[LEN];
+
+int main(int argc, char *argv[]) {
+    const char *path = (argc > 1)? argv[1] : "/dev/ram0";
+
+    int fd = open(path, 0);
+    if (fd == -1) {
+        perror("open(2)");
+        return 1;
+    }
+
+    for (size_t i = 0; i < LEN; ++i) {
+        buf[i] = (i * 7 + i / 4096) & 0xff;
+    }
+
+    if (pread(fd, saved, LEN, OFF) != LEN) {
+        perror("pread(2)");
+        return 1;
+    }
+    if (pwrite(fd, buf, LEN, OFF) != LEN) {
+        perror("pwrite(2)");
+        return 1;
+    }
+    sync();
+
+    if (pread(fd, back, LEN, OFF) != LEN) {
+        perror("pread(2)");
+        return 1;
+    }
+    if (memcmp(buf, back, LEN) != 0) {
+        printf("blkdev: read back differs\n");
+        return 1;
+    }
+
+    // and sequentially, which reads ahead
+    lseek(fd, OFF, SEEK_SET);
+    size_t n = 0;
+    ssize_t ret;
+    while (n < LEN && (ret = read(fd, back + n, 512)) > 0) {
+        n += ret;
+    }
+    if (n != LEN || memcmp(buf, back, LEN) != 0) {
+        printf("blkdev: sequential read differs\n");
+        return 1;
+    }
+
+    if (pwrite(fd, saved, LEN, OFF) != LEN) {
+        perror("pwrite(2)");
+        return 1;
+    }
+    sync();
+
+    printf("blkdev: %s ok\n", path);
+    return 0;
+}
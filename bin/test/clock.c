@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/vdata.h>
+
+static uint64_t ns(const struct timespec *ts) {
+    return ts->tv_sec * 1000000000ull + ts->tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    int ret = 0;
+
+    // never backwards, and finer than a tick
+    struct timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    bool finer = false;
+    for (int i = 0; i < 100000; ++i) {
+        uint64_t ticks = vdata_ticks();
+        clock_gettime(CLOCK_MONOTONIC, &b);
+        if (ns(&b) < ns(&a)) {
+            printf("clock: went back from %llu to %llu\n", ns(&a), ns(&b));
+            ret = 1;
+            break;
+        }
+        if (ns(&b) != ns(&a) && vdata_ticks() == ticks) {
+            finer = true;
+        }
+        a = b;
+    }
+    if (!finer) {
+        printf("clock: only moved with the ticks\n");
+        ret = 1;
+    }
+
+    // a 200ms sleep should look like one. the tick is 100ms
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    poll(NULL, 0, 200);
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    uint64_t slept = (ns(&b) - ns(&a)) / 1000000;
+    if (slept < 150 || slept > 500) {
+        printf("clock: 200ms sleep took %llums\n", slept);
+        ret = 1;
+    }
+
+    // anything after 2020 will do
+    struct timespec now;
+    if (clock_gettime(CLOCK_REALTIME, &now) != 0
+        || now.tv_sec < 1577836800) {
+        printf("clock: realtime is %lli\n", (long long) now.tv_sec);
+        ret = 1;
+    }
+
+    if (clock_gettime(42, &now) != -1 || errno != EINVAL) {
+        printf("clock: bad clock id accepted\n");
+        ret = 1;
+    }
+
+    printf("clock: %s\n", ret ? "FAIL" : "ok");
+    return ret;
+}
@@ -0,0 +1,218 @@
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+
+// the ext2 fs at /mnt, checked against its own superblock on /dev/ram0:
+// the blocks a file takes with the indirect maps, holes that take none,
+// blocks and inodes going back to the bitmaps, and directories that take
+// several blocks. needs a ram disk, see make run-ramdisk
+
+#define LEN (300 * 1000)
+#define NENTRIES 300
+
+#define SUPER_OFF 1024
+#define EXT2_MAGIC 0xEF53
+
+char buf[LEN];
+char back[LEN];
+char dents[1024] __attribute__((aligned(8)));
+
+int disk;
+
+// the free counts, as written to the disk
+static int counts(uint32_t *blocks, uint32_t *inodes) {
+    uint8_t sb[1024];
+
+    sync();
+    if (pread(disk, sb, sizeof(sb), SUPER_OFF) != sizeof(sb)) {
+        perror("pread(2)");
+        return 1;
+    }
+    uint16_t magic;
+    memcpy(&magic, sb + 56, sizeof(magic));
+    if (magic != EXT2_MAGIC) {
+        printf("ext2: bad magic %x in the superblock\n", magic);
+        return 1;
+    }
+    memcpy(blocks, sb + 12, sizeof(*blocks));
+    memcpy(inodes, sb + 16, sizeof(*inodes));
+    return 0;
+}
+
+// with 4K blocks, 300K is the 12 direct blocks, 62 behind the single
+// indirect one and the indirect block itself. one page at 8M needs the
+// double indirect, one table under it and the data, with nothing for the
+// hole before it
+static int blocks(void) {
+    if (creat("/mnt/big", 0) == -1) {
+        perror("creat(2)");
+        return 1;
+    }
+    int fd = open("/mnt/big", 0);
+    if (fd == -1) {
+        perror("open(2)");
+        return 1;
+    }
+
+    uint32_t before, after, inodes;
+    if (counts(&before, &inodes)) {
+        return 1;
+    }
+    for (size_t i = 0; i < LEN; ++i) {
+        buf[i] = (i * 7 + i / 4096) & 0xff;
+    }
+    if (write(fd, buf, LEN) != LEN) {
+        perror("write(2)");
+        return 1;
+    }
+    if (counts(&after, &inodes)) {
+        return 1;
+    }
+    if (before - after != 12 + 62 + 1) {
+        printf("ext2: 300K took %u blocks, expected 75\n", before - after);
+        return 1;
+    }
+
+    if (pwrite(fd, "end", 3, 8<<20) != 3) {
+        perror("pwrite(2)");
+        return 1;
+    }
+    before = after;
+    if (counts(&after, &inodes)) {
+        return 1;
+    }
+    if (before - after != 3) {
+        printf("ext2: a page past a hole took %u blocks, expected 3\n",
+               before - after);
+        return 1;
+    }
+
+    if (pread(fd, back, LEN, 0) != LEN || memcmp(buf, back, LEN) != 0) {
+        printf("ext2: data changed after sync\n");
+        return 1;
+    }
+    close(fd);
+    return 0;
+}
+
+// creat truncates, which gives every block back, map blocks included
+static int release(void) {
+    uint32_t before, after, inodes;
+    if (counts(&before, &inodes)) {
+        return 1;
+    }
+    if (creat("/mnt/big", 0) == -1) {
+        perror("creat(2)");
+        return 1;
+    }
+    if (counts(&after, &inodes)) {
+        return 1;
+    }
+    if (after - before != 75 + 3) {
+        printf("ext2: truncate gave back %u blocks, expected 78\n",
+               after - before);
+        return 1;
+    }
+    return 0;
+}
+
+// a new directory takes an inode and a block for . and .. then its
+// entries spill into more blocks. getdents sees each once, and leaves
+// out . and ..
+static int entries(void) {
+    // a fresh one each run, so nothing is there before
+    char dir[32];
+    sprintf(dir, "/mnt/dir-%d", getpid());
+
+    uint32_t blocks, inodes, nblocks, ninodes;
+    if (counts(&blocks, &inodes)) {
+        return 1;
+    }
+    if (mkdir(dir, 0) == -1) {
+        perror("mkdir(2)");
+        return 1;
+    }
+    if (counts(&nblocks, &ninodes)) {
+        return 1;
+    }
+    if (inodes - ninodes != 1 || blocks - nblocks != 1) {
+        printf("ext2: mkdir took %u inodes and %u blocks\n",
+               inodes - ninodes, blocks - nblocks);
+        return 1;
+    }
+
+    char name[64];
+    for (int i = 0; i < NENTRIES; ++i) {
+        sprintf(name, "%s/entry-%d", dir, i);
+        if (creat(name, 0) == -1) {
+            perror("creat(2)");
+            return 1;
+        }
+    }
+    if (counts(&nblocks, &ninodes)) {
+        return 1;
+    }
+    if (inodes - ninodes != NENTRIES + 1) {
+        printf("ext2: %d files took %u inodes\n", NENTRIES,
+               inodes - ninodes - 1);
+        return 1;
+    }
+
+    int fd = open(dir, O_DIRECTORY);
+    if (fd == -1) {
+        perror("open(2)");
+        return 1;
+    }
+    int found = 0;
+    ssize_t n;
+    while ((n = getdents(fd, dents, sizeof(dents))) > 0) {
+        for (ssize_t off = 0; off < n;) {
+            const struct petix_dirent_stat *d = (void *) (dents + off);
+            if (d->name[0] == '.') {
+                printf("ext2: getdents returned %s\n", d->name);
+                return 1;
+            }
+            ++found;
+            off += d->reclen;
+        }
+    }
+    if (n == -1) {
+        perror("getdents(2)");
+        return 1;
+    }
+    if (found != NENTRIES) {
+        printf("ext2: %d entries, expected %d\n", found, NENTRIES);
+        return 1;
+    }
+    close(fd);
+
+    struct stat st;
+    if (stat(dir, &st) == -1) {
+        perror("stat(2)");
+        return 1;
+    }
+    if (st.st_blksize != 4096) {
+        printf("ext2: block size %lu, expected 4096\n",
+               (unsigned long) st.st_blksize);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    disk = open("/dev/ram0", 0);
+    if (disk == -1) {
+        perror("open(2)");
+        return 1;
+    }
+    if (blocks() || release() || entries()) {
+        return 1;
+    }
+    printf("ext2: ok\n");
+    return 0;
+}
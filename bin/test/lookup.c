@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/vdata.h>
+
+// path lookup benchmark. build the initrd with `make -C initrd bench` to
+// get /bench/f0 ... /bench/f9999, otherwise it stats files in /bin.
+
+static const char *fallback[] = {
+    "/bin/sh", "/bin/init", "/bin/ls", "/bin/cat", "/dev/comtty",
+};
+#define NFALLBACK (sizeof(fallback)/sizeof(fallback[0]))
+
+int main(int argc, char *argv[]) {
+    int nfiles = 10000;
+    if (argc > 1) {
+        nfiles = atoi(argv[1]);
+    }
+
+    struct stat st;
+    bool bench = stat("/bench/f0", &st) == 0;
+
+    char path[32];
+    uint64_t start = vdata_monotonic_ns();
+
+    int found = 0;
+    for (int i = 0; i < nfiles; ++i) {
+        const char *p;
+        if (bench) {
+            sprintf(path, "/bench/f%i", i);
+            p = path;
+        } else {
+            p = fallback[i % NFALLBACK];
+        }
+
+        if (stat(p, &st) == 0) {
+            ++found;
+        }
+    }
+
+    uint64_t ns = vdata_monotonic_ns() - start;
+    printf("lookup: %i/%i paths in %lu ms (%s)\n", found, nfiles,
+           (unsigned long) (ns / 1000000), bench? "/bench" : "/bin");
+
+    return found == nfiles? 0 : 1;
+}
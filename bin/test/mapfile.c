@@ -0,0 +1,60 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+
+#define MAX_SIZE (1<<16)
+
+char map[MAX_SIZE] __attribute__((aligned(4096)));
+char buf[MAX_SIZE];
+
+int main(int argc, char *argv[]) {
+    const char *path = (argc > 1)? argv[1] : "/COPYING";
+
+    int fd = open(path, 0);
+    if (fd == -1) {
+        perror("open(2)");
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("fstat(2)");
+        return 1;
+    }
+    if (st.st_size > MAX_SIZE) {
+        printf("mapfile: %s is too big\n", path);
+        return 1;
+    }
+
+    size_t n = 0;
+    ssize_t ret;
+    while ((ret = read(fd, buf + n, MAX_SIZE - n)) > 0) {
+        n += ret;
+    }
+    if (ret == -1 || n != (size_t) st.st_size) {
+        printf("mapfile: short read\n");
+        return 1;
+    }
+
+    if (mmap(map, sizeof(map), PROT_READ, MAP_SHARED, fd, 0) == MAP_FAILED) {
+        perror("mmap(2)");
+        return 1;
+    }
+
+    if (memcmp(map, buf, n) != 0) {
+        printf("mapfile: mapping differs from read\n");
+        return 1;
+    }
+    for (size_t i = n; i < sizeof(map); ++i) {
+        if (map[i] != 0) {
+            printf("mapfile: nonzero byte past the end of the file\n");
+            return 1;
+        }
+    }
+
+    printf("mapfile: %s ok (%lu bytes)\n", path, (unsigned long) n);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+int main(int argc, char *argv[]) {
+    int filedes[2];
+    if (pipe2(filedes, O_NONBLOCK) == -1) {
+        perror("pipe2(2)");
+        return 1;
+    }
+
+    char buff[512];
+    if (read(filedes[0], buff, sizeof(buff)) != -1 || errno != EAGAIN) {
+        printf("nonblock: empty read did not fail with EAGAIN\n");
+        return 1;
+    }
+
+    // fill the pipe. writes come back short instead of blocking
+    memset(buff, 'x', sizeof(buff));
+    size_t total = 0;
+    ssize_t ret;
+    while ((ret = write(filedes[1], buff, sizeof(buff))) > 0) {
+        total += ret;
+    }
+    if (errno != EAGAIN) {
+        perror("write(2)");
+        return 1;
+    }
+    printf("nonblock: pipe holds %lu bytes\n", (unsigned long) total);
+
+    // a partial read of what is there
+    ret = read(filedes[0], buff, 100);
+    printf("nonblock: read %li\n", (long) ret);
+
+    if (fcntl(filedes[0], F_SETFL, 0) == -1
+        || fcntl(filedes[0], F_GETFL) != 0
+        || fcntl(filedes[1], F_GETFL) != O_NONBLOCK) {
+        printf("nonblock: fcntl(F_SETFL) failed\n");
+        return 1;
+    }
+
+    printf("nonblock: ok\n");
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+// one process serving two pipes
+int main(int argc, char *argv[]) {
+    int a[2], b[2];
+    if (pipe(a) == -1 || pipe(b) == -1) {
+        perror("pipe(2)");
+        return 1;
+    }
+
+    struct pollfd fds[2] = {
+        { .fd = a[0], .events = POLLIN },
+        { .fd = b[0], .events = POLLIN },
+    };
+
+    // nothing written yet, so this should time out
+    int ret = poll(fds, 2, 100);
+    printf("poll: timeout -> %i\n", ret);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(a[0]);
+        close(b[0]);
+        write(b[1], "b", 1);
+        write(a[1], "a", 1);
+        close(a[1]);
+        close(b[1]);
+        return 0;
+    } else if (pid < 0) {
+        perror("fork(2)");
+        return 1;
+    }
+
+    close(a[1]);
+    close(b[1]);
+
+    int nopen = 2;
+    while (nopen > 0) {
+        if (poll(fds, 2, -1) == -1) {
+            perror("poll(2)");
+            return 1;
+        }
+
+        for (int i = 0; i < 2; ++i) {
+            if (fds[i].revents & POLLIN) {
+                char ch;
+                if (read(fds[i].fd, &ch, 1) == 1) {
+                    printf("poll: fd %i: '%c'\n", fds[i].fd, ch);
+                }
+            } else if (fds[i].revents & POLLHUP) {
+                printf("poll: fd %i hung up\n", fds[i].fd);
+                fds[i].fd = -1;
+                --nopen;
+            }
+        }
+    }
+
+    int wstatus;
+    waitpid(pid, &wstatus, 0);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ring.h>
+#include <sys/syscall.h>
+
+static const char *msgs[] = {
+    "ring: first\n",
+    "ring: second\n",
+    "ring: third\n",
+};
+
+#define NMSGS (sizeof(msgs)/sizeof(msgs[0]))
+
+int main(int argc, char *argv[]) {
+    struct petix_ring *ring = ring_setup(0);
+    if (ring == NULL) {
+        perror("ring_setup(2)");
+        return 1;
+    }
+
+    for (size_t i = 0; i < NMSGS; ++i) {
+        struct ring_sqe *sqe = ring_get_sqe(ring);
+        sqe->nr = SYS_NR_WRITE;
+        sqe->args[0] = STDOUT_FILENO;
+        sqe->args[1] = (uint32_t) msgs[i];
+        sqe->args[2] = strlen(msgs[i]);
+        sqe->user_data = i;
+    }
+
+    // one trap for all three writes
+    int n = ring_submit(ring);
+    if (n != NMSGS) {
+        fprintf(stderr, "FAIL: submitted %i of %i\n", n, (int) NMSGS);
+        return 1;
+    }
+
+    size_t seen = 0;
+    struct ring_cqe *cqe;
+    while ((cqe = ring_peek_cqe(ring)) != NULL) {
+        if (cqe->user_data != seen || cqe->res != strlen(msgs[seen])) {
+            fprintf(stderr, "FAIL: bad completion %i: res=%i\n",
+                    (int) cqe->user_data, (int) cqe->res);
+            return 1;
+        }
+        ring_cqe_seen(ring);
+        ++seen;
+    }
+
+    if (seen != NMSGS) {
+        fprintf(stderr, "FAIL: got %i completions\n", (int) seen);
+        return 1;
+    }
+
+    printf("ring test passed!\n");
+    return 0;
+}
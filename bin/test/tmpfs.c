@@ -0,0 +1,186 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+// things only tmpfs does: the radix tree of pages growing under a file,
+// directories listing in creation order, and shared mappings using the
+// file's own pages
+
+#define NENTRIES 100
+
+char buf[4096];
+char map[4096] __attribute__((aligned(4096)));
+
+// the tree grows a level for a far page. the old root moves down and its
+// pages have to stay where they were
+static int grow(void) {
+    if (creat("/tmp/sparse", 0) == -1) {
+        perror("creat(2)");
+        return 1;
+    }
+    int fd = open("/tmp/sparse", 0);
+    if (fd == -1) {
+        perror("open(2)");
+        return 1;
+    }
+
+    if (pwrite(fd, "first", 5, 0) != 5
+        || pwrite(fd, "far", 3, 5<<20) != 3) {
+        perror("pwrite(2)");
+        return 1;
+    }
+    if (pread(fd, buf, 5, 0) != 5 || memcmp(buf, "first", 5) != 0) {
+        printf("tmpfs: first page lost when the tree grew\n");
+        return 1;
+    }
+    if (pread(fd, buf, sizeof(buf), 1<<20) != sizeof(buf)) {
+        perror("pread(2)");
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        if (buf[i] != 0) {
+            printf("tmpfs: hole isn't zeroed\n");
+            return 1;
+        }
+    }
+
+    // two levels are all there is
+    if (pwrite(fd, "x", 1, (off_t) 4 << 30) != -1 || errno != EFBIG) {
+        printf("tmpfs: wrote past the largest file\n");
+        return 1;
+    }
+
+    // creat truncates, and stat doesn't see the old size
+    struct stat st;
+    if (stat("/tmp/sparse", &st) == -1 || st.st_size != (5<<20) + 3) {
+        printf("tmpfs: wrong size before truncating\n");
+        return 1;
+    }
+    if (creat("/tmp/sparse", 0) == -1) {
+        perror("creat(2)");
+        return 1;
+    }
+    if (stat("/tmp/sparse", &st) == -1 || st.st_size != 0) {
+        printf("tmpfs: creat didn't truncate\n");
+        return 1;
+    }
+
+    close(fd);
+    return 0;
+}
+
+// getdents gives entries back in the order they were made, through the
+// hash growing underneath
+static int order(void) {
+    if (mkdir("/tmp/order", 0) == -1 && errno != EEXIST) {
+        perror("mkdir(2)");
+        return 1;
+    }
+
+    char name[64];
+    for (int i = NENTRIES - 1; i >= 0; --i) {
+        sprintf(name, "/tmp/order/%d", i);
+        if (creat(name, 0) == -1) {
+            perror("creat(2)");
+            return 1;
+        }
+    }
+
+    int fd = open("/tmp/order", O_DIRECTORY);
+    if (fd == -1) {
+        perror("open(2)");
+        return 1;
+    }
+
+    int next = NENTRIES - 1;
+    ssize_t n;
+    while ((n = getdents(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t off = 0; off < n;) {
+            const struct petix_dirent_stat *d = (void *) (buf + off);
+            sprintf(name, "%d", next--);
+            if (strcmp(d->name, name) != 0) {
+                printf("tmpfs: got %s, expected %s\n", d->name, name);
+                return 1;
+            }
+            off += d->reclen;
+        }
+    }
+    if (n == -1) {
+        perror("getdents(2)");
+        return 1;
+    }
+    if (next != -1) {
+        printf("tmpfs: %d entries missing\n", next + 1);
+        return 1;
+    }
+
+    if (mkdir("/tmp/order", 0) != -1 || errno != EEXIST) {
+        printf("tmpfs: mkdir over a directory\n");
+        return 1;
+    }
+    if (creat("/tmp/order", 0) != -1 || errno != EISDIR) {
+        printf("tmpfs: creat over a directory\n");
+        return 1;
+    }
+
+    close(fd);
+    return 0;
+}
+
+// a shared mapping is the file's page itself, so writes show up both ways,
+// and a truncate zeroes the page rather than pulling it out from under us
+static int shared(void) {
+    if (creat("/tmp/shared", 0) == -1) {
+        perror("creat(2)");
+        return 1;
+    }
+    int fd = open("/tmp/shared", 0);
+    if (fd == -1) {
+        perror("open(2)");
+        return 1;
+    }
+    if (write(fd, "abc", 3) != 3) {
+        perror("write(2)");
+        return 1;
+    }
+
+    if (mmap(map, sizeof(map), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+        == MAP_FAILED) {
+        perror("mmap(2)");
+        return 1;
+    }
+    map[0] = 'Z';
+    if (pread(fd, buf, 1, 0) != 1 || buf[0] != 'Z') {
+        printf("tmpfs: write through the mapping was lost\n");
+        return 1;
+    }
+    if (pwrite(fd, "Y", 1, 1) != 1 || map[1] != 'Y') {
+        printf("tmpfs: mapping doesn't see writes to the file\n");
+        return 1;
+    }
+
+    if (creat("/tmp/shared", 0) == -1) {
+        perror("creat(2)");
+        return 1;
+    }
+    if (map[0] != 0 || map[2] != 0) {
+        printf("tmpfs: truncate left data in the mapping\n");
+        return 1;
+    }
+
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (grow() || order() || shared()) {
+        return 1;
+    }
+    printf("tmpfs: ok\n");
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/vdata.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+int main(int argc, char *argv[]) {
+    int ret = 0;
+
+    if (getpid() != __sys_getpid()) {
+        printf("vdata: getpid() = %li, syscall = %li\n",
+               (long) getpid(), (long) __sys_getpid());
+        ret = 1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // the child's page must have been rewritten after fork
+        if (getpid() != __sys_getpid() || getppid() != __sys_getppid()) {
+            printf("vdata: child pid %li ppid %li, syscall %li %li\n",
+                   (long) getpid(), (long) getppid(),
+                   (long) __sys_getpid(), (long) __sys_getppid());
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (status != 0) {
+        ret = 1;
+    }
+
+    uint64_t start = vdata_monotonic_ns();
+    uint64_t ticks = vdata_ticks();
+    while (vdata_ticks() == ticks) {
+        __sys_sched_yield();
+    }
+    if (vdata_monotonic_ns() <= start) {
+        printf("vdata: clock did not advance\n");
+        ret = 1;
+    }
+
+    printf("vdata: %s\n", ret ? "FAIL" : "ok");
+    return ret;
+}
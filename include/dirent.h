@@ -6,4 +6,26 @@
 // raw syscall, non-posix
 int getdent(int fd, struct petix_dirent *dent);
 
+#define DT_UNKNOWN 0
+#define DT_FIFO    1
+#define DT_CHR     2
+#define DT_DIR     4
+#define DT_REG     8
+#define DT_LNK     10
+
+// a record in the buffer filled by getdents. records are variable length,
+// the next one starts reclen bytes later.
+struct petix_dirent_stat {
+    uint16_t reclen;
+    uint8_t type; // DT_*
+    bool exec;
+    size_t inode_id;
+    off_t size;
+    char name[]; // nul terminated
+};
+
+// fills buf with as many records as fit. returns the number of bytes used,
+// or 0 at the end of the directory. non-posix
+ssize_t getdents(int fd, void *buf, size_t len);
+
 #endif
@@ -16,10 +16,14 @@ enum errno_ns {
     ECHILD = 10,
 
     EAGAIN = 11,
+    ENOMEM = 12,
 
     EACCES = 13,
     EFAULT = 14,
 
+    EBUSY  = 16,
+    EEXIST = 17,
+
     ENODEV  = 19,
     ENOTDIR = 20,
     EISDIR  = 21,
@@ -28,9 +32,20 @@ enum errno_ns {
     EMFILE  = 24,
     ENOTTY  = 25,
 
+    EFBIG   = 27,
+    ENOSPC  = 28,
+
+    ESPIPE  = 29,
+
+    EPIPE   = 32,
+
+    ENAMETOOLONG = 36,
+
     ENOSYS  = 38,
 
     ENOTSUP = 95,
 };
 
+#define EWOULDBLOCK EAGAIN
+
 #endif
@@ -1,12 +1,27 @@
 #ifndef FCNTL_H
 #define FCNTL_H
 
+#include <stddef.h>
 #include <sys/types.h>
 
 #define O_DIRECTORY (1 << 0)
 #define O_CLOEXEC   (1 << 1)
+#define O_NONBLOCK  (1 << 2)
+
+// fcntl commands
+#define F_GETFD 1
+#define F_SETFD 2
+#define F_GETFL 3
+#define F_SETFL 4
+
+#define FD_CLOEXEC 1
 
 int open(const char *path, int flags, ...);
+int fcntl(int fd, int cmd, ...);
+
+// moves up to len bytes from fd_in to fd_out inside the kernel. unlike
+// linux, neither end has to be a pipe. non-posix
+ssize_t splice(int fd_in, int fd_out, size_t len);
 
 int creat(const char *pathname, mode_t mode);
 
@@ -0,0 +1,25 @@
+#ifndef POLL_H
+#define POLL_H
+
+#define POLLIN   0x01
+#define POLLPRI  0x02
+#define POLLOUT  0x04
+#define POLLERR  0x08
+#define POLLHUP  0x10
+#define POLLNVAL 0x20
+
+#define POLLRDNORM POLLIN
+#define POLLWRNORM POLLOUT
+
+typedef unsigned int nfds_t;
+
+struct pollfd {
+    int fd;
+    short events;
+    short revents;
+};
+
+// timeout is in milliseconds, -1 waits forever
+int poll(struct pollfd fds[], nfds_t nfds, int timeout);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef SYS_RING_H
+#define SYS_RING_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// a batched syscall interface. the submission and completion rings live in
+// one page shared between the process and the kernel. userspace fills
+// submission entries and bumps sq_tail; the kernel consumes them (on
+// ring_enter, or on every syscall exit in RING_SQPOLL mode), runs them
+// through the normal syscall table and posts a completion for each.
+
+#define RING_SQ_ENTRIES 64
+#define RING_CQ_ENTRIES 128
+
+// ring_setup flags
+#define RING_SQPOLL (1 << 0)
+
+struct ring_sqe {
+    uint32_t nr;        // SYS_NR_*
+    uint32_t args[5];   // same as the syscall registers
+    uint32_t user_data; // copied to the completion
+};
+
+struct ring_cqe {
+    int32_t res;        // syscall result, -errno on error
+    uint32_t user_data;
+};
+
+struct petix_ring {
+    // indices are free running, mask with (ENTRIES - 1)
+    volatile uint32_t sq_head; // written by the kernel
+    volatile uint32_t sq_tail; // written by userspace
+    volatile uint32_t cq_head; // written by userspace
+    volatile uint32_t cq_tail; // written by the kernel
+    uint32_t flags;
+    struct ring_sqe sq[RING_SQ_ENTRIES];
+    struct ring_cqe cq[RING_CQ_ENTRIES];
+};
+
+// maps the ring page into the process and returns it, NULL on error
+struct petix_ring *ring_setup(int flags);
+
+// consumes up to to_submit published entries (0 for all), returns how many
+// were consumed
+int ring_enter(unsigned to_submit);
+
+// returns the next free submission entry, NULL if the ring is full. entries
+// are not visible to the kernel until ring_submit.
+struct ring_sqe *ring_get_sqe(struct petix_ring *ring);
+
+// publishes the entries from ring_get_sqe and enters the kernel
+int ring_submit(struct petix_ring *ring);
+
+// returns the next completion, NULL if there is none
+struct ring_cqe *ring_peek_cqe(struct petix_ring *ring);
+void ring_cqe_seen(struct petix_ring *ring);
+
+#endif
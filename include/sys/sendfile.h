@@ -0,0 +1,12 @@
+#ifndef SYS_SENDFILE_H
+#define SYS_SENDFILE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// copies up to count bytes from in_fd to out_fd inside the kernel. reads at
+// *offset and advances it if offset is not NULL, otherwise uses and updates
+// in_fd's file offset.
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+
+#endif
@@ -4,6 +4,33 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#define S_IFMT   0170000
+#define S_IFIFO  0010000
+#define S_IFCHR  0020000
+#define S_IFDIR  0040000
+#define S_IFBLK  0060000
+#define S_IFREG  0100000
+#define S_IFLNK  0120000
+
+#define S_ISFIFO(m) (((m) & S_IFMT) == S_IFIFO)
+#define S_ISCHR(m)  (((m) & S_IFMT) == S_IFCHR)
+#define S_ISDIR(m)  (((m) & S_IFMT) == S_IFDIR)
+#define S_ISBLK(m)  (((m) & S_IFMT) == S_IFBLK)
+#define S_ISREG(m)  (((m) & S_IFMT) == S_IFREG)
+#define S_ISLNK(m)  (((m) & S_IFMT) == S_IFLNK)
+
+struct stat {
+    dev_t st_dev;
+    size_t st_ino;
+    mode_t st_mode;
+    dev_t st_rdev;   // for device files
+    off_t st_size;
+    size_t st_blksize; // preferred io size
+};
+
 int mkdir(const char *pathname, mode_t mode);
 
+int stat(const char *path, struct stat *buf);
+int fstat(int fd, struct stat *buf);
+
 #endif
@@ -3,30 +3,168 @@
 
 #include <stddef.h>
 #include <sys/types.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/ring.h>
+#include <poll.h>
+#include <sys/stat.h>
 
 #define SYSCALL_INT_NUM 0x80
 
 enum syscall_nums {
-    SYS_NR_READ  = 0,
-    SYS_NR_WRITE = 1,
-    SYS_NR_OPEN  = 2,
-    SYS_NR_CLOSE = 3,
-    SYS_NR_WAITPID = 4,
-    SYS_NR_DUP2  = 5,
-    SYS_NR_GETDENT = 6,
-    SYS_NR_PIPE    = 7,
-    SYS_NR_IOCTL   = 8,
-    SYS_NR_MMAP    = 9,
-    SYS_NR_CREAT   = 10,
-    SYS_NR_MKDIR   = 11,
-    SYS_NR_SCHED_YIELD = 24,
-    SYS_NR_FORK     = 57,
-    SYS_NR_EXEC     = 59,
-    SYS_NR_EXIT     = 60,
-    SYS_NR_DB_PRINT = 255
+#define SYSCALL0(NAME, name, nr) SYS_NR_##NAME = nr,
+#define SYSCALL1(NAME, name, nr, ...) SYS_NR_##NAME = nr,
+#define SYSCALL2(NAME, name, nr, ...) SYS_NR_##NAME = nr,
+#define SYSCALL3(NAME, name, nr, ...) SYS_NR_##NAME = nr,
+#define SYSCALL4(NAME, name, nr, ...) SYS_NR_##NAME = nr,
+#define SYSCALL5(NAME, name, nr, ...) SYS_NR_##NAME = nr,
+#include <bits/syscall.def>
+#undef SYSCALL0
+#undef SYSCALL1
+#undef SYSCALL2
+#undef SYSCALL3
+#undef SYSCALL4
+#undef SYSCALL5
 };
 
-// call with whatever args the syscall takes
+// argument structs for wide syscalls
+struct sys_mmap_args {
+    void *addr;
+    size_t len;
+    int prot;
+    int flags;
+    int fd;
+    off_t off;
+};
+
+// the resulting offset is written back to off
+struct sys_lseek_args {
+    int fd;
+    int whence;
+    off_t off;
+};
+
+// shared by pread and pwrite
+struct sys_pread_args {
+    int fd;
+    void *buf;
+    size_t count;
+    off_t off;
+};
+
+// results in this range are -errno, everything else is a value. this only
+// matters for syscalls that return addresses (mmap), the rest never return
+// negative values on success.
+#define SYSCALL_MAX_ERRNO 4095
+#define SYSCALL_IS_ERR(res) ((size_t)(res) >= (size_t)-SYSCALL_MAX_ERRNO)
+
+// per-arity stubs. the kernel's isr saves and restores every register but
+// %eax, so only the result needs an output constraint.
+static inline ssize_t __syscall0(size_t nr) {
+    ssize_t ret;
+    asm volatile ("int %[vec]"
+                  : "=a" (ret)
+                  : [vec] "i" (SYSCALL_INT_NUM), "a" (nr)
+                  : "memory");
+    return ret;
+}
+
+static inline ssize_t __syscall1(size_t nr, size_t a) {
+    ssize_t ret;
+    asm volatile ("int %[vec]"
+                  : "=a" (ret)
+                  : [vec] "i" (SYSCALL_INT_NUM), "a" (nr), "b" (a)
+                  : "memory");
+    return ret;
+}
+
+static inline ssize_t __syscall2(size_t nr, size_t a, size_t b) {
+    ssize_t ret;
+    asm volatile ("int %[vec]"
+                  : "=a" (ret)
+                  : [vec] "i" (SYSCALL_INT_NUM), "a" (nr), "b" (a), "c" (b)
+                  : "memory");
+    return ret;
+}
+
+static inline ssize_t __syscall3(size_t nr, size_t a, size_t b, size_t c) {
+    ssize_t ret;
+    asm volatile ("int %[vec]"
+                  : "=a" (ret)
+                  : [vec] "i" (SYSCALL_INT_NUM), "a" (nr), "b" (a), "c" (b),
+                    "d" (c)
+                  : "memory");
+    return ret;
+}
+
+static inline ssize_t __syscall4(size_t nr, size_t a, size_t b, size_t c,
+                                 size_t d) {
+    ssize_t ret;
+    asm volatile ("int %[vec]"
+                  : "=a" (ret)
+                  : [vec] "i" (SYSCALL_INT_NUM), "a" (nr), "b" (a), "c" (b),
+                    "d" (c), "S" (d)
+                  : "memory");
+    return ret;
+}
+
+static inline ssize_t __syscall5(size_t nr, size_t a, size_t b, size_t c,
+                                 size_t d, size_t e) {
+    ssize_t ret;
+    asm volatile ("int %[vec]"
+                  : "=a" (ret)
+                  : [vec] "i" (SYSCALL_INT_NUM), "a" (nr), "b" (a), "c" (b),
+                    "d" (c), "S" (d), "D" (e)
+                  : "memory");
+    return ret;
+}
+
+// typed stubs generated from the spec: __sys_read(fd, buf, count), etc.
+#define SYSCALL0(NAME, name, nr)                                        \
+    static inline ssize_t __sys_##name(void) {                          \
+        return __syscall0(SYS_NR_##NAME);                               \
+    }
+#define SYSCALL1(NAME, name, nr, t1)                                    \
+    static inline ssize_t __sys_##name(t1 a) {                          \
+        return __syscall1(SYS_NR_##NAME, (size_t) a);                   \
+    }
+#define SYSCALL2(NAME, name, nr, t1, t2)                                \
+    static inline ssize_t __sys_##name(t1 a, t2 b) {                    \
+        return __syscall2(SYS_NR_##NAME, (size_t) a, (size_t) b);       \
+    }
+#define SYSCALL3(NAME, name, nr, t1, t2, t3)                            \
+    static inline ssize_t __sys_##name(t1 a, t2 b, t3 c) {              \
+        return __syscall3(SYS_NR_##NAME, (size_t) a, (size_t) b,        \
+                          (size_t) c);                                  \
+    }
+#define SYSCALL4(NAME, name, nr, t1, t2, t3, t4)                        \
+    static inline ssize_t __sys_##name(t1 a, t2 b, t3 c, t4 d) {        \
+        return __syscall4(SYS_NR_##NAME, (size_t) a, (size_t) b,        \
+                          (size_t) c, (size_t) d);                      \
+    }
+#define SYSCALL5(NAME, name, nr, t1, t2, t3, t4, t5)                    \
+    static inline ssize_t __sys_##name(t1 a, t2 b, t3 c, t4 d, t5 e) {  \
+        return __syscall5(SYS_NR_##NAME, (size_t) a, (size_t) b,        \
+                          (size_t) c, (size_t) d, (size_t) e);          \
+    }
+#include <bits/syscall.def>
+#undef SYSCALL0
+#undef SYSCALL1
+#undef SYSCALL2
+#undef SYSCALL3
+#undef SYSCALL4
+#undef SYSCALL5
+
+// sets errno and returns -1 if res is negative
+static inline ssize_t __syscall_errno(ssize_t res) {
+    if (res < 0) {
+        errno = -res;
+        return -1;
+    }
+    return res;
+}
+
+// call with whatever args the syscall takes (at most 5)
 ssize_t raw_syscall(size_t sys_num, ...);
 
 // sets errno and returns -1 if result is negative
@@ -0,0 +1,51 @@
+#ifndef SYS_VDATA_H
+#define SYS_VDATA_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// read-only pages the kernel maps into every process, so that frequent
+// queries don't need a syscall.
+
+// shared by every process
+#define VDATA_ADDR      0xffffd000
+// private to each process
+#define VDATA_PROC_ADDR 0xffffe000
+
+struct petix_vdata {
+    // seqlock: odd while the kernel is updating. readers retry if it is odd
+    // or changed while they were reading.
+    volatile uint32_t seq;
+    volatile uint64_t ticks;   // timer interrupts since boot
+    volatile uint64_t mono_ns; // monotonic time of the last tick
+    volatile uint32_t tick_ns; // length of a tick
+
+    // with a tsc, the monotonic time is the cycles since tsc_base, as
+    // ns = cycles * tsc_mult >> tsc_shift, and mono_ns is that as of the
+    // last tick. tsc_mult is 0 without one
+    volatile uint64_t tsc_base;
+    volatile uint32_t tsc_mult;
+    volatile uint32_t tsc_shift;
+
+    // the wall clock at mono_ns 0, from the rtc
+    volatile uint64_t boot_realtime_ns;
+};
+
+// split, so that the product fits in 64 bits
+static inline uint64_t vdata_cycles_to_ns(uint64_t cycles, uint32_t mult,
+                                          uint32_t shift) {
+    return (((cycles >> 32) * mult) << (32 - shift))
+           + (((cycles & 0xffffffff) * mult) >> shift);
+}
+
+struct petix_vdata_proc {
+    pid_t pid;
+    pid_t ppid;
+};
+
+// lock-free readers of the shared page. non-posix
+uint64_t vdata_ticks(void);
+uint64_t vdata_monotonic_ns(void);
+uint64_t vdata_realtime_ns(void);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef TIME_H
+#define TIME_H
+
+#include <stdint.h>
+
+typedef int64_t time_t;
+typedef int clockid_t;
+
+struct timespec {
+    time_t tv_sec;
+    long tv_nsec;
+};
+
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
+
+// read from the vdata page, no syscall needed
+int clock_gettime(clockid_t clk, struct timespec *ts);
+
+#endif
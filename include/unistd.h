@@ -16,11 +16,16 @@ enum seek_types {
 
 ssize_t read(int fd, void *buf, size_t count);
 ssize_t write(int fd, const void *buf, size_t count);
+off_t lseek(int fd, off_t offset, int whence);
+ssize_t pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset);
 int close(int fd);
 
 int dup2(int fd, int fd2);
 
 pid_t fork(void);
+pid_t getpid(void);
+pid_t getppid(void);
 
 int execve(const char *path, char *const argv[], char *const envp[]);
 int execvp(const char *path, char *const argv[]);
@@ -28,6 +33,8 @@ int execvp(const char *path, char *const argv[]);
 int pipe(int filedes[2]);
 int pipe2(int filedes[2], int flags);
 
+void sync(void);
+
 void _exit(int status);
 
 int getopt(int argc, char * argv[], const char *optstring);
@@ -0,0 +1,325 @@
+// mkpack: converts a tar archive into a packed initrd image (see
+// kernel/fs/packfmt.h). runs on the host.
+//
+// usage: mkpack in.tar out.pack
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../kernel/fs/packfmt.h"
+
+#define TAR_BLOCKSIZE 512
+
+struct node {
+    char *path;
+    uint32_t type;
+    uint32_t exec;
+    uint32_t major, minor;
+    const char *data;
+    uint32_t size;
+    uint32_t parent;
+    uint32_t children;
+    uint32_t nchildren;
+};
+
+static struct node *nodes;
+static uint32_t nnodes, cap;
+
+static void *xrealloc(void *p, size_t n) {
+    p = realloc(p, n);
+    if (p == NULL) {
+        perror("mkpack: realloc");
+        exit(1);
+    }
+    return p;
+}
+
+static size_t tar_field(const char *f, size_t len) {
+    size_t n = 0;
+    for (size_t i = 0; i < len && f[i] >= '0' && f[i] <= '7'; ++i) {
+        n = n*8 + (f[i] - '0');
+    }
+    return n;
+}
+
+static uint32_t find(const char *path) {
+    for (uint32_t i = 0; i < nnodes; ++i) {
+        if (strcmp(nodes[i].path, path) == 0) {
+            return i;
+        }
+    }
+    return PACK_NONE;
+}
+
+static uint32_t add(const char *path, uint32_t type);
+
+// finds or creates the directory holding path
+static uint32_t parent_of(const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (slash == NULL) {
+        return 0;
+    }
+
+    char *dir = strndup(path, slash - path);
+    uint32_t p = find(dir);
+    if (p == PACK_NONE) {
+        p = add(dir, PACK_DIR);
+    }
+    free(dir);
+    return p;
+}
+
+static uint32_t add(const char *path, uint32_t type) {
+    uint32_t i = find(path);
+    if (i != PACK_NONE) {
+        // later entries replace earlier ones, as with tar -x
+        nodes[i].type = type;
+        return i;
+    }
+
+    uint32_t parent = (nnodes == 0)? PACK_NONE : parent_of(path);
+
+    if (nnodes == cap) {
+        cap = (cap == 0)? 64 : cap*2;
+        nodes = xrealloc(nodes, cap * sizeof(struct node));
+    }
+    i = nnodes++;
+    memset(&nodes[i], 0, sizeof(struct node));
+    nodes[i].path = strdup(path);
+    nodes[i].type = type;
+    nodes[i].parent = parent;
+    nodes[i].exec = (type == PACK_DIR);
+    return i;
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+
+    char *buf = NULL;
+    size_t n = 0, bcap = 0;
+    for (;;) {
+        if (n == bcap) {
+            bcap = (bcap == 0)? (1<<20) : bcap*2;
+            buf = xrealloc(buf, bcap);
+        }
+        size_t ret = fread(buf + n, 1, bcap - n, f);
+        if (ret == 0) {
+            break;
+        }
+        n += ret;
+    }
+    fclose(f);
+
+    *len = n;
+    return buf;
+}
+
+static void parse_tar(const char *tar, size_t len) {
+    char *longname = NULL;
+
+    for (size_t off = 0; off + TAR_BLOCKSIZE <= len;) {
+        const char *h = tar + off;
+        if (h[0] == '\0') {
+            break;
+        }
+
+        size_t size = tar_field(h + 124, 12);
+        char typeflag = h[156];
+        const char *data = h + TAR_BLOCKSIZE;
+        off += TAR_BLOCKSIZE + (size + TAR_BLOCKSIZE - 1)
+                               / TAR_BLOCKSIZE * TAR_BLOCKSIZE;
+        if (off > len) {
+            fprintf(stderr, "mkpack: truncated archive\n");
+            exit(1);
+        }
+
+        // gnu long names come as an entry before the real one
+        if (typeflag == 'L') {
+            free(longname);
+            longname = strndup(data, size);
+            continue;
+        }
+
+        char *path = (longname != NULL)? longname : strndup(h, 100);
+        longname = NULL;
+
+        // no leading "./" or '/', and no trailing '/'
+        char *p = path;
+        while (p[0] == '.' && p[1] == '/') {
+            p += 2;
+        }
+        while (*p == '/') {
+            ++p;
+        }
+        size_t plen = strlen(p);
+        while (plen > 0 && p[plen - 1] == '/') {
+            p[--plen] = '\0';
+        }
+
+        uint32_t type;
+        if (typeflag == '0' || typeflag == '\0') {
+            type = PACK_REGULAR;
+        } else if (typeflag == '5') {
+            type = PACK_DIR;
+        } else if (typeflag == '3' || typeflag == '4') {
+            type = PACK_SPECIAL;
+        } else {
+            // links, fifos and the rest aren't supported, same as tarfs
+            free(path);
+            continue;
+        }
+
+        if (plen == 0) {
+            free(path);
+            continue;
+        }
+
+        uint32_t i = add(p, type);
+        nodes[i].exec = (tar_field(h + 100, 8) & 0111) != 0;
+        nodes[i].major = tar_field(h + 329, 8);
+        nodes[i].minor = tar_field(h + 337, 8);
+        if (type == PACK_REGULAR) {
+            nodes[i].data = data;
+            nodes[i].size = size;
+        }
+        free(path);
+    }
+
+    free(longname);
+}
+
+#define ALIGN(x, a) (((x) + (a) - 1) / (a) * (a))
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s in.tar out.pack\n", argv[0]);
+        return 1;
+    }
+
+    size_t tarlen;
+    char *tar = read_file(argv[1], &tarlen);
+
+    add("", PACK_DIR);
+    parse_tar(tar, tarlen);
+
+    // children are stored contiguously, in archive order
+    uint32_t *children = xrealloc(NULL, nnodes * sizeof(uint32_t));
+    uint32_t nchildren = 0;
+    for (uint32_t i = 0; i < nnodes; ++i) {
+        if (nodes[i].parent != PACK_NONE) {
+            nodes[nodes[i].parent].nchildren++;
+        }
+    }
+    for (uint32_t i = 0; i < nnodes; ++i) {
+        nodes[i].children = nchildren;
+        nchildren += nodes[i].nchildren;
+        nodes[i].nchildren = 0;
+    }
+    for (uint32_t i = 0; i < nnodes; ++i) {
+        struct node *p = (nodes[i].parent != PACK_NONE)?
+                         &nodes[nodes[i].parent] : NULL;
+        if (p != NULL) {
+            children[p->children + p->nchildren++] = i;
+        }
+    }
+
+    uint32_t nbuckets = 16;
+    while (nbuckets < nnodes * 2) {
+        nbuckets *= 2;
+    }
+    uint32_t *buckets = xrealloc(NULL, nbuckets * sizeof(uint32_t));
+    for (uint32_t i = 0; i < nbuckets; ++i) {
+        buckets[i] = PACK_NONE;
+    }
+
+    // lay out the image
+    struct pack_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    hdr.version = PACK_VERSION;
+    hdr.nnodes = nnodes;
+    hdr.nbuckets = nbuckets;
+    hdr.nodes_off = sizeof(hdr);
+    hdr.buckets_off = hdr.nodes_off + nnodes * sizeof(struct pack_node);
+    hdr.children_off = hdr.buckets_off + nbuckets * sizeof(uint32_t);
+    hdr.names_off = hdr.children_off + nnodes * sizeof(uint32_t);
+
+    struct pack_node *pnodes = xrealloc(NULL,
+                                        nnodes * sizeof(struct pack_node));
+    size_t names_len = 0;
+    for (uint32_t i = 0; i < nnodes; ++i) {
+        names_len += strlen(nodes[i].path) + 1;
+    }
+    char *names = xrealloc(NULL, names_len);
+
+    size_t name_off = 0;
+    size_t data_off = ALIGN(hdr.names_off + names_len, 16);
+    for (uint32_t i = 0; i < nnodes; ++i) {
+        struct node *n = &nodes[i];
+        struct pack_node *pn = &pnodes[i];
+        size_t len = strlen(n->path);
+        const char *base = strrchr(n->path, '/');
+
+        memset(pn, 0, sizeof(*pn));
+        pn->name = name_off;
+        pn->namelen = len;
+        pn->base = (base == NULL)? 0 : base + 1 - n->path;
+        pn->hash = pack_hash(n->path, len);
+        pn->parent = n->parent;
+        pn->type = n->type;
+        pn->exec = n->exec;
+        pn->major = n->major;
+        pn->minor = n->minor;
+        pn->size = n->size;
+        pn->children = n->children;
+        pn->nchildren = n->nchildren;
+        // a partial page is copied when it is mapped anyway, so only files
+        // of a page or more get aligned
+        if (n->size >= PACK_PAGE_SIZE) {
+            data_off = ALIGN(data_off, PACK_PAGE_SIZE);
+        }
+        if (n->size > 0) {
+            pn->data = data_off;
+            data_off = ALIGN(data_off + n->size, 16);
+        }
+
+        uint32_t b = pn->hash & (nbuckets - 1);
+        pn->next = buckets[b];
+        buckets[b] = i;
+
+        memcpy(names + name_off, n->path, len + 1);
+        name_off += len + 1;
+    }
+    hdr.image_size = data_off;
+
+    char *image = calloc(1, data_off);
+    if (image == NULL) {
+        perror("mkpack: calloc");
+        return 1;
+    }
+    memcpy(image, &hdr, sizeof(hdr));
+    memcpy(image + hdr.nodes_off, pnodes, nnodes * sizeof(struct pack_node));
+    memcpy(image + hdr.buckets_off, buckets, nbuckets * sizeof(uint32_t));
+    memcpy(image + hdr.children_off, children, nnodes * sizeof(uint32_t));
+    memcpy(image + hdr.names_off, names, names_len);
+    for (uint32_t i = 0; i < nnodes; ++i) {
+        if (nodes[i].size > 0) {
+            memcpy(image + pnodes[i].data, nodes[i].data, nodes[i].size);
+        }
+    }
+
+    FILE *out = fopen(argv[2], "wb");
+    if (out == NULL || fwrite(image, 1, data_off, out) != data_off
+        || fclose(out) != 0) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    printf("mkpack: %u entries, %lu bytes\n", nnodes,
+           (unsigned long) data_off);
+    return 0;
+}
@@ -2,11 +2,16 @@
 #define CPU_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 /* sets up the cpu/interrupts
    disables interrupts */
 void init_cpu(void);
 
+// moves irqs from the pic to the local apic and ioapic, if there are
+// any. needs paging
+void init_apic(void);
+
 /* disable interrupts */
 void cli(void);
 /* enable interrupts */
@@ -14,6 +19,18 @@ void sti(void);
 
 void halt(void);
 
+// the cpu's cycle counter, for timing things before the timer runs
+uint64_t read_cycles(void);
+
+// measures how fast read_cycles counts. called by init_cpu
+void init_clock(void);
+// read_cycles per second, or 0 if it couldn't be measured
+uint64_t cycles_hz(void);
+
+// seconds since the epoch, from the battery backed clock. it's taken to
+// be in utc
+uint64_t read_rtc(void);
+
 typedef void(*keypress_cb_t)(int scancode);
 void register_keypress(keypress_cb_t callback);
 
@@ -0,0 +1,348 @@
+#include "../cpu.h"
+#include "../paging.h"
+#include "apic.h"
+#include "interrupts.h"
+#include "io.h"
+#include "mmu.h"
+#include "pit.h"
+#include "../../kdebug.h"
+#include <string.h>
+
+// the local apic and one ioapic, found through the acpi madt. eois are a
+// single mmio write, and spurious interrupts get their own vector, so
+// nothing has to ask the pic. without them, the pic stays in charge.
+
+#define LAPIC_ID       0x020
+#define LAPIC_EOI      0x0b0
+#define LAPIC_SVR      0x0f0
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CUR  0x390
+#define LAPIC_TIMER_DIV  0x3e0
+
+#define SVR_ENABLE (1 << 8)
+#define LVT_MASKED (1 << 16)
+#define LVT_PERIODIC (1 << 17)
+#define TIMER_DIV_16 0x3
+
+#define IOAPIC_SEL 0x00
+#define IOAPIC_WIN 0x10
+#define IOAPIC_VER 0x01
+#define IOAPIC_REDTBL 0x10
+
+#define RED_LOW_ACTIVE (1 << 13)
+#define RED_LEVEL      (1 << 15)
+#define RED_MASKED     (1 << 16)
+
+#define MSR_APIC_BASE 0x1b
+#define APIC_BASE_ENABLE (1 << 11)
+
+#define CPUID_APIC (1 << 9)
+
+bool apic_enabled = false;
+
+static volatile uint32_t *lapic;
+static volatile uint32_t *ioapic;
+static uint32_t ioapic_pins;
+static uint8_t lapic_id;
+
+// isa irq to ioapic pin, and the pin's polarity and trigger mode
+#define NO_GSI 0xffffffff
+static uint32_t irq_gsi[16];
+static uint32_t irq_flags[16];
+static bool overridden[16];
+
+// timer counts per 10ms, at divide by 16. 0 until calibrated
+static uint32_t timer_10ms = 0;
+
+static uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static void lapic_write(uint32_t reg, uint32_t val) {
+    lapic[reg / 4] = val;
+}
+
+static uint32_t ioapic_read(uint32_t reg) {
+    ioapic[IOAPIC_SEL / 4] = reg;
+    return ioapic[IOAPIC_WIN / 4];
+}
+
+static void ioapic_write(uint32_t reg, uint32_t val) {
+    ioapic[IOAPIC_SEL / 4] = reg;
+    ioapic[IOAPIC_WIN / 4] = val;
+}
+
+void apic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+void ioapic_set_mask(uint8_t irq, bool masked) {
+    if (irq >= 16 || irq_gsi[irq] >= ioapic_pins) {
+        return;
+    }
+    uint32_t reg = IOAPIC_REDTBL + 2*irq_gsi[irq];
+    uint32_t low = ioapic_read(reg);
+    ioapic_write(reg, masked? (low | RED_MASKED) : (low & ~RED_MASKED));
+}
+
+
+// acpi tables. the bios area is identity mapped, and so is the ram the
+// tables sit in, as long as it is below the mmio region
+
+struct acpi_header {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem[6];
+    char oem_table[8];
+    uint32_t oem_revision;
+    uint32_t creator;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+struct madt_entry {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed));
+
+#define MADT_IOAPIC   1
+#define MADT_OVERRIDE 2
+
+static bool checksum_ok(const void *p, size_t len) {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < len; ++i) {
+        sum += ((const uint8_t *) p)[i];
+    }
+    return sum == 0;
+}
+
+static bool acpi_reachable(uintptr_t addr, size_t len) {
+    return addr != 0 && addr < MMIO_REGION && len < MMIO_REGION - addr;
+}
+
+// the ebda would be searched too, but its pointer is in the zero page,
+// which is unmapped. seabios and most others put it here
+static const char *find_rsdp(void) {
+    for (uintptr_t p = 0xe0000; p < 0x100000; p += 16) {
+        if (memcmp((const char *) p, "RSD PTR ", 8) == 0
+            && checksum_ok((const void *) p, 20)) {
+            return (const char *) p;
+        }
+    }
+    return NULL;
+}
+
+static const struct acpi_header *find_madt(void) {
+    const char *rsdp = find_rsdp();
+    if (rsdp == NULL) {
+        return NULL;
+    }
+
+    uint32_t rsdt_addr;
+    memcpy(&rsdt_addr, rsdp + 16, 4);
+    const struct acpi_header *rsdt = (void *) rsdt_addr;
+    if (!acpi_reachable(rsdt_addr, sizeof(struct acpi_header))
+        || !acpi_reachable(rsdt_addr, rsdt->length)
+        || memcmp(rsdt->signature, "RSDT", 4) != 0) {
+        return NULL;
+    }
+
+    size_t n = (rsdt->length - sizeof(struct acpi_header)) / 4;
+    const uint32_t *tables = (const uint32_t *) (rsdt + 1);
+    for (size_t i = 0; i < n; ++i) {
+        const struct acpi_header *h = (void *) tables[i];
+        if (acpi_reachable(tables[i], sizeof(struct acpi_header))
+            && memcmp(h->signature, "APIC", 4) == 0
+            && acpi_reachable(tables[i], h->length)
+            && checksum_ok(h, h->length)) {
+            return h;
+        }
+    }
+    return NULL;
+}
+
+// returns the first ioapic's address, and fills in the isa overrides
+static uint32_t parse_madt(const struct acpi_header *madt) {
+    uint32_t addr = 0;
+
+    // after the header, the lapic address and flags
+    const char *p = (const char *) madt + sizeof(struct acpi_header) + 8;
+    const char *end = (const char *) madt + madt->length;
+    while (p + sizeof(struct madt_entry) <= end) {
+        const struct madt_entry *e = (const void *) p;
+        if (e->length < 2 || p + e->length > end) {
+            break;
+        }
+
+        if (e->type == MADT_IOAPIC && e->length >= 12) {
+            uint32_t a, gsi_base;
+            memcpy(&a, p + 4, 4);
+            memcpy(&gsi_base, p + 8, 4);
+            // the isa irqs are on the one starting at 0
+            if (gsi_base == 0 && addr == 0) {
+                addr = a;
+            }
+        } else if (e->type == MADT_OVERRIDE && e->length >= 10) {
+            uint8_t bus = p[2];
+            uint8_t irq = p[3];
+            uint32_t gsi;
+            uint16_t flags;
+            memcpy(&gsi, p + 4, 4);
+            memcpy(&flags, p + 8, 2);
+
+            if (bus == 0 && irq < 16) {
+                irq_gsi[irq] = gsi;
+                irq_flags[irq] = 0;
+                overridden[irq] = true;
+                // polarity 3 is active low, trigger mode 3 is level
+                if ((flags & 0x3) == 0x3) {
+                    irq_flags[irq] |= RED_LOW_ACTIVE;
+                }
+                if (((flags >> 2) & 0x3) == 0x3) {
+                    irq_flags[irq] |= RED_LEVEL;
+                }
+            }
+        }
+        p += e->length;
+    }
+
+    // an irq moved onto another's pin takes it over. on most machines the
+    // timer takes 2, the cascade, which has no use here
+    for (int i = 0; i < 16; ++i) {
+        for (int j = 0; j < 16; ++j) {
+            if (i != j && overridden[i] && !overridden[j]
+                && irq_gsi[j] == irq_gsi[i]) {
+                irq_gsi[j] = NO_GSI;
+            }
+        }
+    }
+    return addr;
+}
+
+
+static uint64_t rdmsr(uint32_t msr) {
+    uint64_t val;
+    asm volatile ("rdmsr" : "=A" (val) : "c" (msr));
+    return val;
+}
+
+static void wrmsr(uint32_t msr, uint64_t val) {
+    asm volatile ("wrmsr" :: "c" (msr), "A" (val));
+}
+
+static bool has_apic(void) {
+    uint32_t a, b, c, d;
+    asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (1));
+    return (d & CPUID_APIC) != 0;
+}
+
+static void spurious_handler(struct pushed_regs *regs) {
+    // no eoi for these
+    ++irq_stats.spurious;
+}
+
+static void timer_calibrate(void) {
+    lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED | APIC_TIMER_VECTOR);
+
+    // the tsc is already known, and 1ms of it is plenty. the pit takes 10
+    uint64_t hz = cycles_hz();
+    if (hz != 0) {
+        uint64_t start = read_cycles();
+        lapic_write(LAPIC_TIMER_INIT, 0xffffffff);
+        while (read_cycles() - start < hz / 1000) {
+        }
+        uint32_t cur = lapic_read(LAPIC_TIMER_CUR);
+        lapic_write(LAPIC_TIMER_INIT, 0);
+        timer_10ms = (0xffffffff - cur) * 10;
+        return;
+    }
+
+    pit_delay_start();
+    lapic_write(LAPIC_TIMER_INIT, 0xffffffff);
+    bool ok = pit_delay_wait();
+    uint32_t cur = lapic_read(LAPIC_TIMER_CUR);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+
+    if (ok) {
+        timer_10ms = 0xffffffff - cur;
+    }
+}
+
+bool apic_timer_start(size_t usecs, uint32_t *tick_ns) {
+    if (!apic_enabled || timer_10ms == 0) {
+        return false;
+    }
+
+    uint64_t count = (uint64_t) timer_10ms * usecs / 10000;
+    if (count == 0 || count > 0xffffffff) {
+        return false;
+    }
+    *tick_ns = count * 10000000ull / timer_10ms;
+
+    lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_PERIODIC | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, count);
+    return true;
+}
+
+void init_apic(void) {
+    if (!has_apic()) {
+        kprintf("apic: none, using the pic\n");
+        return;
+    }
+
+    for (int i = 0; i < 16; ++i) {
+        irq_gsi[i] = i;
+        irq_flags[i] = 0;
+        overridden[i] = false;
+    }
+
+    const struct acpi_header *madt = find_madt();
+    uint32_t ioapic_addr = (madt != NULL)? parse_madt(madt) : 0;
+    if (ioapic_addr == 0) {
+        kprintf("apic: no ioapic in the acpi tables, using the pic\n");
+        return;
+    }
+
+    uint64_t base = rdmsr(MSR_APIC_BASE);
+    wrmsr(MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+    lapic = map_mmio(base & 0xfffff000, PAGE_SIZE, false);
+    ioapic = map_mmio(ioapic_addr, PAGE_SIZE, false);
+    if (lapic == NULL || ioapic == NULL) {
+        kprintf("apic: can't map it, using the pic\n");
+        return;
+    }
+
+    lapic_id = lapic_read(LAPIC_ID) >> 24;
+    ioapic_pins = ((ioapic_read(IOAPIC_VER) >> 16) & 0xff) + 1;
+
+    register_interrupt_handler(APIC_SPURIOUS_VECTOR, spurious_handler);
+    lapic_write(LAPIC_SVR, SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+
+    // whatever the pic let through, the ioapic does too. the timer is
+    // routed when it is started, and 2 is only the cascade
+    uint16_t pic_masks = inb(0x21) | (inb(0xa1) << 8);
+    outb(0xa1, 0xff);
+    outb(0x21, 0xff);
+
+    for (int irq = 0; irq < 16; ++irq) {
+        if (irq_gsi[irq] >= ioapic_pins) {
+            continue;
+        }
+        bool masked = irq == 0 || irq == 2 || (pic_masks & (1 << irq));
+        uint32_t reg = IOAPIC_REDTBL + 2*irq_gsi[irq];
+        ioapic_write(reg + 1, (uint32_t) lapic_id << 24);
+        ioapic_write(reg, (32 + irq) | irq_flags[irq]
+                          | (masked? RED_MASKED : 0));
+    }
+
+    apic_enabled = true;
+    timer_calibrate();
+
+    kprintf("apic: lapic %u, ioapic with %lu pins, timer %lu kHz\n",
+            (unsigned) lapic_id, (unsigned long) ioapic_pins,
+            (unsigned long) (timer_10ms / 10));
+}
@@ -0,0 +1,24 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// the local apic's own interrupts
+#define APIC_TIMER_VECTOR    48
+#define APIC_SPURIOUS_VECTOR 0xff
+
+// set once interrupts come through the ioapic instead of the pic
+extern bool apic_enabled;
+
+void apic_eoi(void);
+
+// isa irqs, through the acpi overrides
+void ioapic_set_mask(uint8_t irq, bool masked);
+
+// starts the local apic timer at APIC_TIMER_VECTOR, every usecs. returns
+// false if it couldn't be calibrated. sets the real interval in ns
+bool apic_timer_start(size_t usecs, uint32_t *tick_ns);
+
+#endif
@@ -0,0 +1,115 @@
+#include "../cpu.h"
+#include "pit.h"
+#include "io.h"
+#include "../../kdebug.h"
+
+// the tsc, timed against the pit, and the wall clock from the cmos rtc
+
+static uint64_t tsc_hz = 0;
+
+void init_clock(void) {
+    pit_delay_start();
+    uint64_t start = read_cycles();
+    bool ok = pit_delay_wait();
+    uint64_t cycles = read_cycles() - start;
+
+    if (!ok) {
+        kprintf("clock: the pit never finished, no tsc clock\n");
+        return;
+    }
+    tsc_hz = cycles * 100;
+    kprintf("clock: tsc at %llu kHz\n", tsc_hz / 1000);
+}
+
+uint64_t cycles_hz(void) {
+    return tsc_hz;
+}
+
+
+#define CMOS_SELECT 0x70
+#define CMOS_DATA   0x71
+// keeps nmis off while we're at it
+#define CMOS_NMI_OFF 0x80
+
+#define RTC_SECONDS  0x00
+#define RTC_MINUTES  0x02
+#define RTC_HOURS    0x04
+#define RTC_DAY      0x07
+#define RTC_MONTH    0x08
+#define RTC_YEAR     0x09
+#define RTC_STATUS_A 0x0a
+#define RTC_STATUS_B 0x0b
+
+#define A_UPDATING (1 << 7)
+#define B_24H      (1 << 1)
+#define B_BINARY   (1 << 2)
+#define HOURS_PM   0x80
+
+struct rtc_time {
+    uint8_t sec, min, hour, day, month, year;
+};
+
+static uint8_t cmos_read(uint8_t reg) {
+    outb(CMOS_SELECT, CMOS_NMI_OFF | reg);
+    return inb(CMOS_DATA);
+}
+
+static void rtc_read_raw(struct rtc_time *t) {
+    while (cmos_read(RTC_STATUS_A) & A_UPDATING) {
+    }
+    t->sec   = cmos_read(RTC_SECONDS);
+    t->min   = cmos_read(RTC_MINUTES);
+    t->hour  = cmos_read(RTC_HOURS);
+    t->day   = cmos_read(RTC_DAY);
+    t->month = cmos_read(RTC_MONTH);
+    t->year  = cmos_read(RTC_YEAR);
+}
+
+static uint8_t from_bcd(uint8_t n) {
+    return (n >> 4) * 10 + (n & 0xf);
+}
+
+// days from 1970-01-01 to y-m-d, in the proleptic gregorian calendar
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = y - era * 400;
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t) doe - 719468;
+}
+
+uint64_t read_rtc(void) {
+    // an update can land between the reads, so read until two agree
+    struct rtc_time t, again;
+    rtc_read_raw(&t);
+    for (;;) {
+        rtc_read_raw(&again);
+        if (t.sec == again.sec && t.min == again.min && t.hour == again.hour
+            && t.day == again.day && t.month == again.month
+            && t.year == again.year) {
+            break;
+        }
+        t = again;
+    }
+
+    uint8_t status = cmos_read(RTC_STATUS_B);
+    bool pm = (t.hour & HOURS_PM) != 0;
+    t.hour &= ~HOURS_PM;
+    if (!(status & B_BINARY)) {
+        t.sec = from_bcd(t.sec);
+        t.min = from_bcd(t.min);
+        t.hour = from_bcd(t.hour);
+        t.day = from_bcd(t.day);
+        t.month = from_bcd(t.month);
+        t.year = from_bcd(t.year);
+    }
+    // 12 am is 0, 12 pm is 12
+    if (!(status & B_24H)) {
+        t.hour = (t.hour % 12) + (pm ? 12 : 0);
+    }
+
+    // the century register isn't always there. take it to be this one
+    int64_t days = days_from_civil(2000 + t.year, t.month, t.day);
+    return days * 86400 + t.hour * 3600 + t.min * 60 + t.sec;
+}
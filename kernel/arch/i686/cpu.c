@@ -21,6 +21,8 @@ void init_cpu(void) {
          "    mov %%eax, %%cr0\n"
          "    fninit\n"
          ::: "eax");
+
+    init_clock();
 }
 
 /* disable interrupts */
@@ -37,6 +39,12 @@ void halt(void) {
     asm("hlt");
 }
 
+uint64_t read_cycles(void) {
+    uint64_t tsc;
+    asm volatile ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
 static keypress_cb_t keyboard_callback = NULL;
 
 static void keypress_int_handler(struct pushed_regs *regs) {
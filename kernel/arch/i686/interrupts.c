@@ -1,6 +1,8 @@
 #include "interrupts.h"
+#include "apic.h"
 #include "../../kdebug.h"
 #include "io.h"
+#include "../../proc.h"
 #include <stddef.h>
 
 
@@ -15,6 +17,11 @@
 #define PIC_READ_ISR 0x0b
 
 void send_eoi(int irq) {
+    if (apic_enabled) {
+        apic_eoi();
+        return;
+    }
+
     if(irq >= 8) {
 		outb(PIC2_COMMAND,PIC_EOI);
     }
@@ -30,6 +37,8 @@ static uint16_t pic_read_isr(void) {
 
 static interrupt_handler_t handlers[256];
 
+struct irq_stats irq_stats;
+
 void clear_interrupt_handlers(void) {
     for (size_t i = 0; i < 256; ++i) {
         handlers[i] = NULL;
@@ -41,30 +50,50 @@ void register_interrupt_handler(int vecn, interrupt_handler_t handler) {
 }
 
 
+static void dispatch(struct pushed_regs *regs) {
+    if (handlers[regs->vecn] != NULL) {
+        handlers[regs->vecn](regs);
+    } else if (regs->irq != -1) {
+        if (regs->irq != 0) {
+           kprintf("got unhandled irq: %li, vecn=%li\n",
+                   regs->irq, regs->vecn);
+        }
+        send_eoi(regs->irq);
+    } else if (regs->exception != -1) {
+        kprintf("got exception: vecn=%li, code=%li, error_code=0x%08lX, eip=0x%08lX\n",
+                regs->vecn, regs->exception, regs->error_code, regs->eip);
+        panic("unhandled exception");
+    } else {
+        kprintf("got unhandled interrupt: %li\n", regs->vecn);
+    }
+}
+
 void general_interrupt_handler(struct pushed_regs regs) {
-    if (regs.irq != -1 && !(pic_read_isr() & (1 << regs.irq))) {
+    // the apic has its own vector for spurious interrupts
+    if (regs.irq != -1 && !apic_enabled
+        && !(pic_read_isr() & (1 << regs.irq))) {
         // spurious irq
+        ++irq_stats.spurious;
         if(regs.irq >= 8) {
             outb(PIC1_COMMAND,PIC_EOI);
         }
         return;
     }
 
-    if (handlers[regs.vecn] != NULL) {
-        handlers[regs.vecn](&regs);
-    } else if (regs.irq != -1) {
-        if (regs.irq != 0) {
-           kprintf("got unhandled irq: %li, vecn=%li\n",
-                   regs.irq, regs.vecn);
-        }
-        send_eoi(regs.irq);
-    } else if (regs.exception != -1) {
-        kprintf("got exception: vecn=%li, code=%li, error_code=%lx, eip=%lx\n",
-                regs.vecn, regs.exception, regs.error_code, regs.eip);
-        panic("unhandled exception");
-    } else {
-        kprintf("got unhandled interrupt: %li\n", regs.vecn);
-    }
+    // counted first, since exit never comes back
+    ++irq_stats.count[regs.vecn & 0xff];
+
+    uint64_t away = get_away_cycles();
+    uint64_t start = read_cycles();
+
+    dispatch(&regs);
+
+    uint64_t cycles = read_cycles() - start;
+    // a forked child comes back here with its parent's start and away
+    // cycles, so don't let it go below 0
+    away = get_away_cycles() - away;
+    cycles = (away < cycles)? cycles - away : 0;
+    irq_stats.cycles[regs.vecn & 0xff] += cycles;
 }
 
 // from osdev wiki
@@ -115,6 +144,11 @@ void IRQ_set_mask(unsigned char IRQline) {
     uint16_t port;
     uint8_t value;
 
+    if (apic_enabled) {
+        ioapic_set_mask(IRQline, true);
+        return;
+    }
+
     if(IRQline < 8) {
         port = PIC1_DATA;
     } else {
@@ -129,11 +163,18 @@ void IRQ_clear_mask(unsigned char IRQline) {
     uint16_t port;
     uint8_t value;
 
+    if (apic_enabled) {
+        ioapic_set_mask(IRQline, false);
+        return;
+    }
+
     if(IRQline < 8) {
         port = PIC1_DATA;
     } else {
         port = PIC2_DATA;
         IRQline -= 8;
+        // the slave's irqs come through the cascade
+        outb(PIC1_DATA, inb(PIC1_DATA) & ~(1 << 2));
     }
     value = inb(port) & ~(1 << IRQline);
     outb(port, value);
@@ -23,6 +23,29 @@ struct pushed_regs {
 
 typedef void(*interrupt_handler_t)(struct pushed_regs *regs);
 
+// page faults, by what the handler had to do. the last two go by the
+// error code, and overlap the others
+enum {
+    PF_TABLE,  // allocated a page table
+    PF_ZERO,   // allocated a zeroed page
+    PF_STALE,  // neither, already mapped by the time we looked
+    PF_USER,
+    PF_WRITE,
+    PF_NCOUNTS,
+};
+
+// counted since boot, and never reset. the cycles a handler spends
+// switched out or halted aren't its own, so they're left out
+struct irq_stats {
+    uint64_t count[256];
+    uint64_t cycles[256];
+    uint64_t spurious;
+    uint64_t syscalls[256];
+    uint64_t page_faults[PF_NCOUNTS];
+};
+
+extern struct irq_stats irq_stats;
+
 void send_eoi(int irq);
 
 void clear_interrupt_handlers(void);
@@ -6,8 +6,6 @@
 #include <stddef.h>
 #include <string.h>
 
-#define PROC_REGION 0xC0000000
-
 static page_dir_t kpagedir;
 
 #define identity_len ((PROC_REGION/PAGE_SIZE)/PTAB_SIZE)
@@ -23,20 +21,21 @@ void init_paging(void) {
     kassert((((uint32_t) page_tabs) & 0xfff) == 0);
 
     memset(&kpagedir, 0, sizeof(kpagedir));
-    memset(&page_tabs, 0, sizeof(page_tabs));
 
-    // identity page up to 0xc000000
+    // identity page up to 0xc000000. every entry is written whole, so the
+    // 3MB of tables needn't be cleared first
     for (size_t i = 0; i < identity_len; ++i) {
         kpagedir.ents[i].present    = 1;
         kpagedir.ents[i].rw         = 1;
         kpagedir.ents[i].page_table = ((uint32_t) page_tabs[i].ents) >> PAGE_SHIFT;
 
         for (size_t j = 0; j < PTAB_SIZE; ++j) {
-            struct page_tab_ent *pte = &(page_tabs[i].ents[j]);
-            pte->present = 1;
-            pte->rw = 1;
-            pte->global = 1;
-            pte->addr = (i*(PAGE_SIZE*PTAB_SIZE) + j*PAGE_SIZE) >> PAGE_SHIFT;
+            page_tabs[i].ents[j] = (struct page_tab_ent) {
+                .present = 1,
+                .rw = 1,
+                .global = 1,
+                .addr = (i*(PAGE_SIZE*PTAB_SIZE) + j*PAGE_SIZE) >> PAGE_SHIFT,
+            };
         }
     }
 
@@ -60,11 +59,11 @@ static void page_fault_handler(struct pushed_regs *regs) {
     uintptr_t linaddr;
     asm ("mov %%cr2, %0": "=r" (linaddr));
 
-    //kprintf("page fault: pfla=%lx, ec=%lx\n",
+    //kprintf("page fault: pfla=0x%08lX, ec=0x%08lX\n",
     //        linaddr, regs->error_code);
 
     if ((regs->error_code & 0x9) != 0) {
-        kprintf("unrecoverable page fault. pfla=%lx, ec=%lx\n",
+        kprintf("unrecoverable page fault. pfla=0x%08lX, ec=0x%08lX\n",
                 linaddr, regs->error_code);
         panic("unrecoverable page fault");
     }
@@ -72,8 +71,15 @@ static void page_fault_handler(struct pushed_regs *regs) {
     uint32_t dir_idx, tab_idx;
     split_addr(linaddr, dir_idx, tab_idx);
 
+    if (regs->error_code & 0x4) {
+        ++irq_stats.page_faults[PF_USER];
+    }
+    if (regs->error_code & 0x2) {
+        ++irq_stats.page_faults[PF_WRITE];
+    }
+
     if (!pd[dir_idx].present && !pd[dir_idx].petix_alloc) {
-        kprintf("this should be a segfault (dir). pfla=%lx, ec=%lx, %%eip=%lx\n",
+        kprintf("this should be a segfault (dir). pfla=0x%08lX, ec=0x%08lX, %%eip=0x%08lX\n",
                 linaddr, regs->error_code, regs->eip);
         panic("unrecoverable page fault");
     }
@@ -90,6 +96,7 @@ static void page_fault_handler(struct pushed_regs *regs) {
         }
         pd[dir_idx].present = 1;
         pd[dir_idx].page_table = (uint32_t) tab >> PAGE_SHIFT;
+        ++irq_stats.page_faults[PF_TABLE];
     }
 
     // allocate a page if needed
@@ -99,7 +106,7 @@ static void page_fault_handler(struct pushed_regs *regs) {
     struct page_tab_ent *tab = (void *) (pd[dir_idx].page_table << 12);
 
     if (!tab[tab_idx].present && !tab[tab_idx].petix_alloc) {
-        kprintf("this should be a segfault (page). pfla=%lx, ec=%lx, %%eip=%lx\n",
+        kprintf("this should be a segfault (page). pfla=0x%08lX, ec=0x%08lX, %%eip=0x%08lX\n",
                 linaddr, regs->error_code, regs->eip);
         panic("unrecoverable page fault");
     }
@@ -110,6 +117,9 @@ static void page_fault_handler(struct pushed_regs *regs) {
         tab[tab_idx].present = 1;
         tab[tab_idx].global = 0;
         tab[tab_idx].addr = (uint32_t) page >> PAGE_SHIFT;
+        ++irq_stats.page_faults[PF_ZERO];
+    } else {
+        ++irq_stats.page_faults[PF_STALE];
     }
 
     // TODO: figure out if we need this
@@ -118,6 +128,78 @@ static void page_fault_handler(struct pushed_regs *regs) {
     release_global();
 }
 
+// returns the page table for dir_idx, allocating it if needed
+static struct page_tab_ent *get_user_page_table(addr_space_t as,
+                                                uint32_t dir_idx) {
+    if (!as[dir_idx].present) {
+        struct page_tab_ent *tab = alloc_page_ptr_sync();
+        memset(tab, 0, PAGE_SIZE);
+        for (size_t i = 0; i < PTAB_SIZE; ++i) {
+            tab[i].petix_alloc = 1;
+            tab[i].present = 0;
+            tab[i].rw   = as[dir_idx].rw;
+            tab[i].user = as[dir_idx].user;
+        }
+        as[dir_idx].present = 1;
+        as[dir_idx].page_table = (uint32_t) tab >> PAGE_SHIFT;
+    }
+    return (void *) (as[dir_idx].page_table << PAGE_SHIFT);
+}
+
+#define MAX_SHARED_PAGES 4
+
+static struct {
+    void *virt;
+    void *phys;
+} shared_pages[MAX_SHARED_PAGES];
+static size_t nshared_pages = 0;
+
+void map_shared_user_page(void *virt, void *phys) {
+    kassert(nshared_pages < MAX_SHARED_PAGES);
+    kassert(((uintptr_t) virt & PAGE_MASK) == 0);
+    kassert(((uintptr_t) phys & PAGE_MASK) == 0);
+
+    shared_pages[nshared_pages].virt = virt;
+    shared_pages[nshared_pages].phys = phys;
+    nshared_pages++;
+}
+
+void *alloc_user_page_ro(addr_space_t as, void *virt) {
+    uintptr_t dir_idx, tab_idx;
+    split_addr((uintptr_t)virt, dir_idx, tab_idx);
+
+    struct page_tab_ent *tab = get_user_page_table(as, dir_idx);
+
+    void *page = alloc_page_ptr_sync();
+    memset(page, 0, PAGE_SIZE);
+
+    // petix_alloc: owned by the address space, so it is copied on fork and
+    // freed with it
+    tab[tab_idx].present = 1;
+    tab[tab_idx].rw = 0;
+    tab[tab_idx].user = 1;
+    tab[tab_idx].global = 0;
+    tab[tab_idx].petix_alloc = 1;
+    tab[tab_idx].addr = (uintptr_t) page >> PAGE_SHIFT;
+
+    return page;
+}
+
+void *get_user_page(addr_space_t as, void *virt) {
+    uintptr_t dir_idx, tab_idx;
+    split_addr((uintptr_t)virt, dir_idx, tab_idx);
+
+    if (!as[dir_idx].present) {
+        return NULL;
+    }
+
+    struct page_tab_ent *tab = (void *) (as[dir_idx].page_table << PAGE_SHIFT);
+    if (!tab[tab_idx].present) {
+        return NULL;
+    }
+    return (void *) (tab[tab_idx].addr << PAGE_SHIFT);
+}
+
 addr_space_t create_proc_addr_space(void) {
     struct page_dir_ent *pd = alloc_page_ptr_sync();
     memcpy(pd, kpagedir.ents, PAGE_SIZE);
@@ -130,6 +212,19 @@ addr_space_t create_proc_addr_space(void) {
         pd[i].petix_alloc = 1;
     }
 
+    // read-only for userspace, and not owned by the address space
+    for (size_t i = 0; i < nshared_pages; ++i) {
+        uintptr_t dir_idx, tab_idx;
+        split_addr((uintptr_t)shared_pages[i].virt, dir_idx, tab_idx);
+
+        struct page_tab_ent *tab = get_user_page_table(pd, dir_idx);
+        tab[tab_idx].present = 1;
+        tab[tab_idx].rw = 0;
+        tab[tab_idx].user = 1;
+        tab[tab_idx].petix_alloc = 0;
+        tab[tab_idx].addr = (uintptr_t) shared_pages[i].phys >> PAGE_SHIFT;
+    }
+
     return pd;
 }
 
@@ -224,6 +319,45 @@ int remap_page_user(addr_space_t as, void *virt, void *phys) {
     }
 
     tab[tab_idx].addr = (uintptr_t) phys >> 12;
+    // it may have been read-only before
+    tab[tab_idx].rw = 1;
+    return 0;
+}
+
+int remap_page_user_ro(addr_space_t as, void *virt, void *phys) {
+    if (remap_page_user(as, virt, phys) == -1) {
+        return -1;
+    }
+
+    uintptr_t dir_idx, tab_idx;
+    split_addr((uintptr_t)virt, dir_idx, tab_idx);
+
+    struct page_tab_ent *tab = (void *) (as[dir_idx].page_table << 12);
+    tab[tab_idx].rw = 0;
+    return 0;
+}
+
+int unmap_page_user(addr_space_t as, void *virt) {
+    if (virt < (void*)PROC_REGION || (char *)virt > USER_STACK_TOP) {
+        return -1;
+    }
+
+    uintptr_t dir_idx, tab_idx;
+    split_addr((uintptr_t)virt, dir_idx, tab_idx);
+
+    if (!as[dir_idx].present) {
+        return -1;
+    }
+    struct page_tab_ent *tab = (void *) (as[dir_idx].page_table << 12);
+
+    if (tab[tab_idx].petix_alloc) {
+        // not remapped
+        return -1;
+    }
+
+    tab[tab_idx].present = 0;
+    tab[tab_idx].petix_alloc = 1;
+    tab[tab_idx].addr = 0;
     return 0;
 }
 
@@ -243,3 +377,33 @@ void remap_page_kernel(void *virt, void *phys) {
 
     tab[tab_idx].addr = (uintptr_t) phys >> 12;
 }
+
+static uintptr_t mmio_next = MMIO_REGION;
+
+void *map_mmio(uintptr_t phys, size_t len, bool wt) {
+    uintptr_t off = phys & PAGE_MASK;
+    size_t npages = (off + len + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    acquire_global();
+    if (npages > (PROC_REGION - mmio_next) / PAGE_SIZE) {
+        release_global();
+        return NULL;
+    }
+    uintptr_t virt = mmio_next;
+    mmio_next += npages * PAGE_SIZE;
+
+    for (size_t i = 0; i < npages; ++i) {
+        uintptr_t dir_idx, tab_idx;
+        split_addr(virt + i*PAGE_SIZE, dir_idx, tab_idx);
+        struct page_tab_ent *tab = page_tabs[dir_idx].ents;
+
+        tab[tab_idx].addr = ((phys & ~PAGE_MASK) >> PAGE_SHIFT) + i;
+        tab[tab_idx].write_through = 1;
+        tab[tab_idx].cache_disable = !wt;
+        // the mapping is global, so a cr3 reload wouldn't drop it
+        asm volatile ("invlpg (%0)" :: "r" (virt + i*PAGE_SIZE) : "memory");
+    }
+    release_global();
+
+    return (void *) (virt + off);
+}
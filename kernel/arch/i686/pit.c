@@ -1,29 +1,41 @@
 #include "../cpu.h"
 #include "interrupts.h"
+#include "apic.h"
+#include "pit.h"
 #include "../../sync.h"
 #include "../../kdebug.h"
 #include "io.h"
-
-static const double pitfreq = 1.193181666666666; // MHz = cycles/usec
+#include "../../vdata.h"
 
 // io registers
 static const uint16_t c0_data  = 0x40;
 //static const uint16_t c1_data  = 0x41;
-//static const uint16_t c2_data  = 0x42;
+static const uint16_t c2_data  = 0x42;
 static const uint16_t mode_com = 0x43;
+// channel 2's gate and the speaker, and its output in bit 5
+static const uint16_t c2_gate  = 0x61;
 
-#define SELECT_0    (3 << 6)
+#define SELECT_0    (0 << 6)
+#define SELECT_2    (2 << 6)
 #define AM_LOHI     (3 << 4)
+#define MODE_ONESHOT (0 << 1)
 #define MODE_SQUARE (3 << 1)
 
+#define GATE_ON    0x01
+#define SPEAKER_ON 0x02
+#define C2_OUT     0x20
+
 
 static timer_cb_t timer_callback = NULL;
 static size_t softdiv;
 static size_t sdc = 0;
+// length of one interrupt, for the vdata clock. 65536 counts by default
+static uint32_t tick_ns = 54925409;
 
 
 static void timer_interrupt_handler(struct pushed_regs *regs) {
     send_eoi(regs->irq);
+    vdata_tick(tick_ns);
 
     if (softdiv == 0) {
         timer_callback();
@@ -38,11 +50,39 @@ static void timer_interrupt_handler(struct pushed_regs *regs) {
 
 void register_timer(timer_cb_t callback) {
     register_interrupt_handler(32, timer_interrupt_handler);
+    register_interrupt_handler(APIC_TIMER_VECTOR, timer_interrupt_handler);
     timer_callback = callback;
 }
 
+void pit_delay_start(void) {
+    uint8_t gate = inb(c2_gate) & ~(SPEAKER_ON | GATE_ON);
+    outb(c2_gate, gate);
+    outb(mode_com, SELECT_2 | AM_LOHI | MODE_ONESHOT);
+    outb(c2_data, (PIT_HZ / 100) & 0xff);
+    outb(c2_data, (PIT_HZ / 100) >> 8);
+    // counting starts on the rising edge of the gate
+    outb(c2_gate, gate | GATE_ON);
+}
+
+bool pit_delay_wait(void) {
+    // a broken pit would hang us here. give up after ~2^28 spins
+    for (uint32_t i = 0; !(inb(c2_gate) & C2_OUT); ++i) {
+        if (i == (1u << 28)) {
+            return false;
+        }
+    }
+    outb(c2_gate, inb(c2_gate) & ~GATE_ON);
+    return true;
+}
+
 void set_cpu_interval(size_t usecs) {
-    size_t fdiv = (size_t) (pitfreq * usecs);
+    // the local apic timer needs no port io to ack
+    if (apic_timer_start(usecs, &tick_ns)) {
+        softdiv = 0;
+        return;
+    }
+
+    uint64_t fdiv = (uint64_t) PIT_HZ * usecs / 1000000;
 
     uint16_t reload;
     if (fdiv > 65536) {
@@ -55,12 +95,15 @@ void set_cpu_interval(size_t usecs) {
 
     kassert(reload != 1);
 
+    tick_ns = (reload ? reload : 65536) * 1000000000ull / PIT_HZ;
+
     acquire_global();
 
     outb(mode_com, SELECT_0 | AM_LOHI | MODE_SQUARE);
 
     outb(c0_data, reload & 0xff);
     outb(c0_data, (reload >> 8) & 0xff);
+    IRQ_clear_mask(0);
 
     release_global();
 }
@@ -0,0 +1,15 @@
+#ifndef PIT_H
+#define PIT_H
+
+#include <stdbool.h>
+
+// counts per second
+#define PIT_HZ 1193182
+
+// a 10ms one shot on channel 2, with the speaker off, for calibrating the
+// other clocks against. start it, start what's being measured, then wait
+void pit_delay_start(void);
+// false if the pit never finished
+bool pit_delay_wait(void);
+
+#endif
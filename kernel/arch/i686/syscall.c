@@ -1,10 +1,12 @@
 #include "../../syscall.h"
+#include "../../ring.h"
 #include "interrupts.h"
 #include "../../kdebug.h"
 
 void syscall_interrupt_handler(struct pushed_regs *regs) {
     kassert(regs->eax < 256);
     kassert(syscall_table[regs->eax] != NULL);
+    ++irq_stats.syscalls[regs->eax];
     size_t ret = syscall_table[regs->eax](
                      regs->ebx,
                      regs->ecx,
@@ -13,4 +15,7 @@ void syscall_interrupt_handler(struct pushed_regs *regs) {
                      regs->edi);
 
     regs->eax = ret;
+
+    // batched submissions ride along on every trap in polling mode
+    ring_poll();
 }
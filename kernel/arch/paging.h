@@ -1,14 +1,25 @@
 #ifndef PAGING_H
 #define PAGING_H
 
+#include <sys/vdata.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
 //TODO: something more portable
 struct page_dir_ent;
 typedef struct page_dir_ent * addr_space_t;
 
 //TODO: something more portable
+#define PROC_REGION 0xC0000000
 #define KERNEL_STACK_SIZE 4096
 #define KERNEL_STACK_TOP (char *)0xffffffff
-#define USER_STACK_TOP (KERNEL_STACK_TOP - KERNEL_STACK_SIZE)
+// the vdata pages sit between the kernel stack and the user stack
+#define USER_STACK_TOP ((char *)VDATA_ADDR - 1)
+// the top of the identity mapped region is kept free of ram, so device
+// memory can be mapped there
+#define MMIO_SIZE 0x4000000
+#define MMIO_REGION (PROC_REGION - MMIO_SIZE)
 
 void init_paging(void);
 
@@ -24,10 +35,29 @@ void use_addr_space(addr_space_t as);
 void lock_page(addr_space_t as, void *addr);
 
 int remap_page_user(addr_space_t as, void *virt, void *phys);
+// same as remap_page_user, but userspace can't write to the page
+int remap_page_user_ro(addr_space_t as, void *virt, void *phys);
+// undoes remap_page_user, the page is demand allocated again. does not free
+// the old page.
+int unmap_page_user(addr_space_t as, void *virt);
 
 //must be used before init_proc
 void remap_page_kernel(void *virt, void *phys);
 
+// maps len bytes of device memory at phys into the kernel, uncached, or
+// write through with wt. returns NULL if the mmio region is full
+void *map_mmio(uintptr_t phys, size_t len, bool wt);
+
+// maps phys read-only for userspace at virt in every address space created
+// afterwards. must be used before init_proc
+void map_shared_user_page(void *virt, void *phys);
+
+// maps a new zeroed page, read-only for userspace. returns the page
+void *alloc_user_page_ro(addr_space_t as, void *virt);
+
+// returns the page backing virt, or NULL
+void *get_user_page(addr_space_t as, void *virt);
+
 void flush_tlb(void);
 
 #endif
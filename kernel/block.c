@@ -0,0 +1,625 @@
+#include "block.h"
+#include "device.h"
+#include "fs/devfs.h"
+#include "kmalloc.h"
+#include "proc.h"
+#include "kdebug.h"
+#include <errno.h>
+#include <string.h>
+
+#define MIN(a, b) (((a)<(b))? (a):(b))
+
+#define NBUF 256
+#define NBUCKETS 64
+
+// a request holds at least one busy buffer, so there are never more
+// requests than buffers
+#define NREQ NBUF
+
+// read-ahead window, in blocks. it doubles while reads stay sequential
+#define RA_MIN 4
+#define RA_MAX REQ_MAX_BUFS
+
+static struct block_dev *devs[MAX_BLOCK_DEVS];
+static size_t ndevs = 0;
+
+// the hash, lru and refcnts. the queues and the busy, valid and dirty bits
+// are shared with irqs, so they are under the global lock
+static petix_lock_t cache_lock;
+static struct buffer bufs[NBUF];
+static struct buffer *buckets[NBUCKETS];
+static struct buffer *lru_head, *lru_tail;
+
+static struct block_request reqs[NREQ];
+static struct block_request *free_reqs;
+
+
+static size_t hash(struct block_dev *dev, size_t blkno) {
+    return (blkno ^ (dev->minor * 0x9e37)) % NBUCKETS;
+}
+
+// the cache lock must be held
+static struct buffer *lookup(struct block_dev *dev, size_t blkno) {
+    for (struct buffer *b = buckets[hash(dev, blkno)]; b != NULL;
+         b = b->hnext) {
+        if (b->dev == dev && b->blkno == blkno) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+static void unhash(struct buffer *b) {
+    if (b->dev == NULL) {
+        return;
+    }
+
+    struct buffer **p = &buckets[hash(b->dev, b->blkno)];
+    while (*p != b) {
+        p = &(*p)->hnext;
+    }
+    *p = b->hnext;
+}
+
+static void lru_remove(struct buffer *b) {
+    if (b->prev != NULL) {
+        b->prev->next = b->next;
+    } else {
+        lru_head = b->next;
+    }
+    if (b->next != NULL) {
+        b->next->prev = b->prev;
+    } else {
+        lru_tail = b->prev;
+    }
+}
+
+static void lru_touch(struct buffer *b) {
+    lru_remove(b);
+    b->prev = NULL;
+    b->next = lru_head;
+    if (lru_head != NULL) {
+        lru_head->prev = b;
+    } else {
+        lru_tail = b;
+    }
+    lru_head = b;
+}
+
+
+// the global lock must be held
+static void dispatch(struct block_dev *dev) {
+    // a driver that completes inside start comes back through here
+    if (dev->dispatching) {
+        return;
+    }
+    dev->dispatching = true;
+
+    bool started = false;
+    while (dev->inflight < dev->depth && dev->queue != NULL
+           && dev->plugged == 0) {
+        // one way elevator: the first request past the head, or wrap around
+        struct block_request **p = &dev->queue;
+        while (*p != NULL && (*p)->blkno < dev->head) {
+            p = &(*p)->next;
+        }
+        if (*p == NULL) {
+            p = &dev->queue;
+        }
+
+        struct block_request *req = *p;
+        *p = req->next;
+        req->next = NULL;
+
+        dev->inflight++;
+        dev->head = req->blkno + req->nbufs;
+        dev->ops->start(dev, req);
+        started = true;
+    }
+
+    if (started && dev->ops->kick != NULL) {
+        dev->ops->kick(dev);
+    }
+
+    dev->dispatching = false;
+}
+
+// adds b to dev's queue, merging it into a request for the blocks next to
+// it if there is one. the global lock must be held
+static void enqueue(struct buffer *b, enum block_op op) {
+    struct block_dev *dev = b->dev;
+
+    b->busy = true;
+    b->err = 0;
+    if (op == BLOCK_WRITE) {
+        // anything written from here on needs another write back
+        b->dirty = false;
+    }
+
+    struct block_request **p = &dev->queue;
+    for (; *p != NULL; p = &(*p)->next) {
+        struct block_request *req = *p;
+        if (req->op != op || req->nbufs == REQ_MAX_BUFS) {
+            continue;
+        }
+
+        if (req->blkno + req->nbufs == b->blkno) {
+            req->bufs[req->nbufs++] = b;
+
+            // it may close the gap to the next one
+            struct block_request *next = req->next;
+            if (next != NULL && next->op == op
+                && next->blkno == req->blkno + req->nbufs
+                && req->nbufs + next->nbufs <= REQ_MAX_BUFS) {
+                memcpy(req->bufs + req->nbufs, next->bufs,
+                       next->nbufs * sizeof(struct buffer *));
+                req->nbufs += next->nbufs;
+                req->next = next->next;
+                next->next = free_reqs;
+                free_reqs = next;
+            }
+            return;
+        } else if (b->blkno + 1 == req->blkno) {
+            memmove(req->bufs + 1, req->bufs,
+                    req->nbufs * sizeof(struct buffer *));
+            req->bufs[0] = b;
+            req->nbufs++;
+            req->blkno--;
+            return;
+        }
+    }
+
+    struct block_request *req = free_reqs;
+    kassert(req != NULL);
+    free_reqs = req->next;
+
+    req->op = op;
+    req->blkno = b->blkno;
+    req->nbufs = 1;
+    req->bufs[0] = b;
+
+    // keep the queue sorted
+    for (p = &dev->queue; *p != NULL && (*p)->blkno < b->blkno;
+         p = &(*p)->next) {}
+    req->next = *p;
+    *p = req;
+}
+
+static void submit(struct buffer *b, enum block_op op) {
+    acquire_global();
+    enqueue(b, op);
+    dispatch(b->dev);
+    release_global();
+}
+
+static void plug(struct block_dev *dev) {
+    acquire_global();
+    dev->plugged++;
+    release_global();
+}
+
+static void unplug(struct block_dev *dev) {
+    acquire_global();
+    dev->plugged--;
+    dispatch(dev);
+    release_global();
+}
+
+void block_complete(struct block_request *req, int err) {
+    acquire_global();
+
+    struct block_dev *dev = req->bufs[0]->dev;
+    for (size_t i = 0; i < req->nbufs; ++i) {
+        struct buffer *b = req->bufs[i];
+        b->err = err;
+        if (req->op == BLOCK_READ) {
+            b->valid = (err == 0);
+        } else if (err != 0) {
+            // retrying would keep failing, and eviction would never get
+            // past it. the data is lost, the next sync says so
+            b->dirty = false;
+            b->valid = false;
+            dev->wb_err = err;
+        }
+        b->busy = false;
+        cond_wake(&b->wait);
+    }
+
+    dev->inflight--;
+    req->next = free_reqs;
+    free_reqs = req;
+
+    dispatch(dev);
+
+    release_global();
+}
+
+static void wait_buffer(struct buffer *b) {
+    while (b->busy) {
+        if (is_global_held()) {
+            // at boot, with irqs off
+            kassert(b->dev->ops->poll != NULL);
+            b->dev->ops->poll(b->dev);
+        } else {
+            cond_wait(&b->wait);
+        }
+    }
+    // everyone waiting was woken, but only one got the signal
+    cond_wake(&b->wait);
+}
+
+
+// writes back up to REQ_MAX_BUFS dirty buffers from the cold end of the
+// lru in one batch, and waits for them. the cache lock must be held, and
+// is dropped while waiting
+static void write_back_lru(void) {
+    struct buffer *batch[REQ_MAX_BUFS];
+    size_t n = 0;
+
+    for (struct buffer *b = lru_tail; b != NULL && n < REQ_MAX_BUFS;
+         b = b->prev) {
+        if (b->refcnt == 0 && b->dirty && !b->busy) {
+            b->refcnt++;
+            batch[n++] = b;
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        plug(batch[i]->dev);
+        submit(batch[i], BLOCK_WRITE);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        unplug(batch[i]->dev);
+    }
+
+    release_lock(&cache_lock);
+    for (size_t i = 0; i < n; ++i) {
+        wait_buffer(batch[i]);
+    }
+    acquire_lock(&cache_lock);
+
+    for (size_t i = 0; i < n; ++i) {
+        batch[i]->refcnt--;
+    }
+}
+
+// returns blkno, held. with may_block false, returns NULL rather than wait
+// to evict something
+static struct buffer *getblk(struct block_dev *dev, size_t blkno,
+                             bool may_block) {
+    acquire_lock(&cache_lock);
+
+    for (;;) {
+        struct buffer *b = lookup(dev, blkno);
+        if (b != NULL) {
+            b->refcnt++;
+            lru_touch(b);
+            release_lock(&cache_lock);
+            return b;
+        }
+
+        bool dirty = false;
+        for (b = lru_tail; b != NULL; b = b->prev) {
+            if (b->refcnt == 0 && !b->busy) {
+                if (!b->dirty) {
+                    break;
+                }
+                dirty = true;
+            }
+        }
+
+        if (b == NULL && !may_block) {
+            release_lock(&cache_lock);
+            return NULL;
+        } else if (b == NULL && dirty) {
+            write_back_lru();
+            continue;
+        } else if (b == NULL) {
+            // everything is held or in flight
+            release_lock(&cache_lock);
+            sched();
+            acquire_lock(&cache_lock);
+            continue;
+        }
+
+        if (b->data == NULL) {
+            b->data = alloc_page_ptr_sync();
+            if (b->data == NULL) {
+                release_lock(&cache_lock);
+                return NULL;
+            }
+        }
+
+        unhash(b);
+        b->dev = dev;
+        b->blkno = blkno;
+        b->valid = false;
+        b->err = 0;
+        b->refcnt = 1;
+        size_t h = hash(dev, blkno);
+        b->hnext = buckets[h];
+        buckets[h] = b;
+        lru_touch(b);
+
+        release_lock(&cache_lock);
+        return b;
+    }
+}
+
+// the cache lock must be held
+static bool cached(struct block_dev *dev, size_t blkno) {
+    return blkno >= dev->nblocks || lookup(dev, blkno) != NULL;
+}
+
+// starts reading the blocks after blkno that aren't cached. only takes
+// buffers that are free to evict, so it never waits
+static void read_ahead(struct block_dev *dev, size_t blkno, size_t n) {
+    for (size_t i = 1; i <= n && blkno + i < dev->nblocks; ++i) {
+        struct buffer *b = getblk(dev, blkno + i, false);
+        if (b == NULL) {
+            break;
+        }
+
+        acquire_global();
+        if (!b->valid && !b->busy) {
+            enqueue(b, BLOCK_READ);
+        }
+        release_global();
+
+        // busy keeps it from being evicted under the read
+        brelse(b);
+    }
+}
+
+struct buffer *bread(struct block_dev *dev, size_t blkno) {
+    if (blkno >= dev->nblocks) {
+        return NULL;
+    }
+
+    struct buffer *b = getblk(dev, blkno, true);
+    if (b == NULL) {
+        return NULL;
+    }
+
+    // the window grows while reads are sequential, and closes when not
+    bool sequential = (blkno == dev->ra_next);
+    dev->ra_next = blkno + 1;
+    if (!sequential) {
+        dev->ra_size = 0;
+    } else if (dev->ra_size == 0) {
+        dev->ra_size = RA_MIN;
+    } else {
+        dev->ra_size = MIN(dev->ra_size * 2, RA_MAX);
+    }
+
+    // the next window is read once this one is half used, so a sequential
+    // reader rarely waits, and the reads go out in big batches
+    acquire_lock(&cache_lock);
+    bool ra = dev->ra_size > 0
+              && (!b->valid || !cached(dev, blkno + dev->ra_size/2));
+    release_lock(&cache_lock);
+
+    plug(dev);
+    acquire_global();
+    if (!b->valid && !b->busy) {
+        enqueue(b, BLOCK_READ);
+    }
+    release_global();
+    if (ra) {
+        read_ahead(dev, blkno, dev->ra_size);
+    }
+    unplug(dev);
+
+    if (!b->valid) {
+        wait_buffer(b);
+    }
+    if (!b->valid) {
+        brelse(b);
+        return NULL;
+    }
+    return b;
+}
+
+struct buffer *bget(struct block_dev *dev, size_t blkno) {
+    if (blkno >= dev->nblocks) {
+        return NULL;
+    }
+
+    struct buffer *b = getblk(dev, blkno, true);
+    if (b != NULL) {
+        // a read landing later would clobber the new data
+        wait_buffer(b);
+    }
+    return b;
+}
+
+void bdirty(struct buffer *b) {
+    acquire_global();
+    b->valid = true;
+    b->dirty = true;
+    release_global();
+}
+
+void brelse(struct buffer *b) {
+    acquire_lock(&cache_lock);
+    kassert(b->refcnt > 0);
+    b->refcnt--;
+    release_lock(&cache_lock);
+}
+
+int block_sync(struct block_dev *dev) {
+    struct buffer **batch = kmalloc_sync(NBUF * sizeof(struct buffer *));
+    if (batch == NULL) {
+        return -ENOMEM;
+    }
+    size_t n = 0;
+
+    acquire_lock(&cache_lock);
+    for (size_t i = 0; i < ndevs; ++i) {
+        plug(devs[i]);
+    }
+    for (size_t i = 0; i < NBUF; ++i) {
+        struct buffer *b = &bufs[i];
+        if (b->dirty && !b->busy && (dev == NULL || b->dev == dev)) {
+            b->refcnt++;
+            submit(b, BLOCK_WRITE);
+            batch[n++] = b;
+        }
+    }
+    for (size_t i = 0; i < ndevs; ++i) {
+        unplug(devs[i]);
+    }
+    release_lock(&cache_lock);
+
+    for (size_t i = 0; i < n; ++i) {
+        wait_buffer(batch[i]);
+        brelse(batch[i]);
+    }
+    kfree_sync(batch);
+
+    // this batch's failures, and any from write backs since the last sync
+    int err = 0;
+    acquire_global();
+    for (size_t i = 0; i < ndevs; ++i) {
+        if ((dev == NULL || devs[i] == dev) && devs[i]->wb_err != 0) {
+            err = devs[i]->wb_err;
+            devs[i]->wb_err = 0;
+        }
+    }
+    release_global();
+    return err;
+}
+
+
+// block device files read and write through the cache
+
+static int blk_open(struct inode *in, struct file *f, int flags) {
+    struct block_dev *dev = block_lookup(in->dev);
+    if (dev == NULL) {
+        return -ENXIO;
+    }
+
+    f->private_data = dev->minor;
+    f->size = (off_t) dev->nblocks * BLOCK_SIZE;
+    return 0;
+}
+
+static ssize_t blk_read(struct file *f, char *buf, size_t n) {
+    struct block_dev *dev = devs[f->private_data];
+
+    size_t done = 0;
+    while (done < n && f->offset < f->size) {
+        size_t off = f->offset % BLOCK_SIZE;
+        size_t len = MIN(MIN(BLOCK_SIZE - off, n - done),
+                         f->size - f->offset);
+
+        struct buffer *b = bread(dev, f->offset / BLOCK_SIZE);
+        if (b == NULL) {
+            return (done > 0)? (ssize_t) done : -EIO;
+        }
+        memcpy(buf + done, b->data + off, len);
+        brelse(b);
+
+        done += len;
+        f->offset += len;
+    }
+    return done;
+}
+
+static ssize_t blk_write(struct file *f, const char *buf, size_t n) {
+    struct block_dev *dev = devs[f->private_data];
+
+    if (n > 0 && f->offset >= f->size) {
+        return -ENOSPC;
+    }
+
+    size_t done = 0;
+    while (done < n && f->offset < f->size) {
+        size_t off = f->offset % BLOCK_SIZE;
+        size_t len = MIN(MIN(BLOCK_SIZE - off, n - done),
+                         f->size - f->offset);
+
+        size_t blkno = f->offset / BLOCK_SIZE;
+        struct buffer *b = (len == BLOCK_SIZE)?
+                           bget(dev, blkno) : bread(dev, blkno);
+        if (b == NULL) {
+            return (done > 0)? (ssize_t) done : -EIO;
+        }
+        memcpy(b->data + off, buf + done, len);
+        bdirty(b);
+        brelse(b);
+
+        done += len;
+        f->offset += len;
+    }
+    return done;
+}
+
+static struct file_ops fops;
+
+int block_register(struct block_dev *dev) {
+    acquire_global();
+    if (ndevs == MAX_BLOCK_DEVS) {
+        release_global();
+        return -ENOSPC;
+    }
+
+    dev->minor = ndevs;
+    dev->queue = NULL;
+    dev->inflight = 0;
+    if (dev->depth == 0) {
+        dev->depth = 1;
+    }
+    dev->head = 0;
+    dev->plugged = 0;
+    dev->dispatching = false;
+    dev->ra_next = 0;
+    dev->ra_size = 0;
+    dev->wb_err = 0;
+    devs[ndevs++] = dev;
+    release_global();
+
+    register_device(dev->major, &fops);
+    int err = devfs_add(dev->name, MKDEV(dev->major, dev->minor));
+    if (err < 0) {
+        return err;
+    }
+    return dev->minor;
+}
+
+struct block_dev *block_lookup(dev_t dev) {
+    size_t minor = MINOR(dev);
+    if (minor >= ndevs || devs[minor]->major != MAJOR(dev)) {
+        return NULL;
+    }
+    return devs[minor];
+}
+
+void block_init(void) {
+    memset(bufs, 0, sizeof(bufs));
+    lru_head = lru_tail = NULL;
+    for (size_t i = 0; i < NBUF; ++i) {
+        struct buffer *b = &bufs[i];
+        b->next = lru_head;
+        if (lru_head != NULL) {
+            lru_head->prev = b;
+        } else {
+            lru_tail = b;
+        }
+        lru_head = b;
+    }
+
+    free_reqs = NULL;
+    for (size_t i = 0; i < NREQ; ++i) {
+        reqs[i].next = free_reqs;
+        free_reqs = &reqs[i];
+    }
+
+    memset(&fops, 0, sizeof(fops));
+    fops = (struct file_ops) {
+        .open = blk_open,
+        .lseek = fs_default_lseek,
+        .read = blk_read,
+        .write = blk_write,
+    };
+}
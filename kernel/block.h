@@ -0,0 +1,112 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+// the block layer. filesystems and block device files go through the
+// buffer cache, which batches its misses and write backs into requests
+// for the driver. adjacent requests are merged, and the queue is kept
+// sorted by block.
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "sync.h"
+#include "mem.h"
+
+#define SECTOR_SIZE 512
+// buffers are a page each
+#define BLOCK_SIZE PAGE_SIZE
+#define BLOCK_SECTORS (BLOCK_SIZE / SECTOR_SIZE)
+
+#define MAX_BLOCK_DEVS 16
+// the most buffers merged into one request
+#define REQ_MAX_BUFS 32
+
+struct block_dev;
+
+struct buffer {
+    struct block_dev *dev;
+    size_t blkno;
+    char *data;
+    bool valid; // data is the disk's, or newer
+    bool dirty;
+    bool busy;  // in a request
+    int err;    // of the last request
+    size_t refcnt;
+    petix_sem_t wait;
+
+    struct buffer *hnext;
+    struct buffer *prev, *next; // lru order, most recent first
+};
+
+enum block_op {
+    BLOCK_READ,
+    BLOCK_WRITE,
+};
+
+// a run of adjacent blocks
+struct block_request {
+    enum block_op op;
+    size_t blkno;
+    size_t nbufs;
+    struct buffer *bufs[REQ_MAX_BUFS];
+    struct block_request *next;
+};
+
+struct block_ops {
+    // starts req. the driver calls block_complete when it is done, which may
+    // be from an irq, or before start returns
+    void (*start)(struct block_dev *, struct block_request *);
+    // optional. called after a batch of starts, for drivers that tell the
+    // device about new requests once per batch
+    void (*kick)(struct block_dev *);
+    // completes whatever has finished without waiting for an irq. needed for
+    // drivers that complete from irqs, as nothing can sleep before the
+    // scheduler runs. called with the global lock held
+    void (*poll)(struct block_dev *);
+};
+
+struct block_dev {
+    const char *name; // the /dev node
+    int major;        // its major. minors are given out by block_register
+    size_t nblocks;
+    size_t depth;     // how many requests the driver takes at once. 0 is 1
+    const struct block_ops *ops;
+    void *private_data; // for the driver
+
+    // the rest belongs to the block layer
+    int minor;
+    struct block_request *queue;
+    size_t inflight;
+    size_t head;    // the block after the last request, for the elevator
+    size_t plugged; // requests are held back while this is nonzero
+    bool dispatching;
+    size_t ra_next; // where a sequential reader goes next
+    size_t ra_size;
+    int wb_err;     // a failed write that no sync has reported yet
+};
+
+// adds dev and its /dev node. returns the minor, or -errno
+int block_register(struct block_dev *dev);
+// the block device behind a device number, or NULL
+struct block_dev *block_lookup(dev_t dev);
+
+// returns blkno with its data read, or NULL on an io error. the buffer is
+// held until brelse
+struct buffer *bread(struct block_dev *dev, size_t blkno);
+// like bread, without the read. for blocks that get overwritten whole
+struct buffer *bget(struct block_dev *dev, size_t blkno);
+// marks b's data changed. it is written back when b is evicted, or synced
+void bdirty(struct buffer *b);
+void brelse(struct buffer *b);
+
+// writes back dev's dirty buffers, or every device's if dev is NULL.
+// returns an error if any write failed since the last sync, including
+// write backs on eviction. those buffers are dropped, not retried
+int block_sync(struct block_dev *dev);
+
+// called by drivers when req is done
+void block_complete(struct block_request *req, int err);
+
+void block_init(void);
+
+#endif
@@ -0,0 +1,350 @@
+#include "dcache.h"
+#include "kmalloc.h"
+#include "sync.h"
+#include "kdebug.h"
+#include <string.h>
+#include <errno.h>
+
+#define DCACHE_SIZE 256
+#define DCACHE_BUCKETS 512
+#define ICACHE_BUCKETS 128
+
+struct icache_ent {
+    struct inode in;
+    long refcnt;
+    struct icache_ent *next;
+};
+
+struct dcache_ent {
+    char *path; // normalized
+    size_t len;
+    uint32_t hash;
+    int err;
+    struct icache_ent *inode; // NULL for failed lookups
+    bool referenced; // hit since it last came up for eviction
+    struct dcache_ent *next;  // hash chain
+    struct dcache_ent *lru_prev, *lru_next;
+};
+
+// hits only take this shared, so concurrent lookups don't contend
+static petix_rwlock_t dcache_lock;
+
+static struct dcache_ent *buckets[DCACHE_BUCKETS];
+static struct icache_ent *ibuckets[ICACHE_BUCKETS];
+
+// newest first. evicted second chance style, since hits can't reorder the
+// list under a shared lock
+static struct dcache_ent *lru_head, *lru_tail;
+static size_t nents = 0;
+
+// paths are keyed as if repeated and trailing slashes were removed, without
+// copying them. returns the next character of that form, or '\0' at the end
+static char norm_next(const char **p) {
+    const char *s = *p;
+    if (*s == '/') {
+        while (*s == '/') {
+            ++s;
+        }
+        *p = s;
+        return (*s == '\0')? '\0' : '/';
+    }
+
+    if (*s == '\0') {
+        return '\0';
+    }
+    *p = s + 1;
+    return *s;
+}
+
+static size_t norm_len(const char *p) {
+    size_t len = 0;
+    while (norm_next(&p) != '\0') {
+        ++len;
+    }
+    return len;
+}
+
+// fnv-1a
+static uint32_t norm_hash(const char *p) {
+    uint32_t h = 2166136261u;
+    char ch;
+    while ((ch = norm_next(&p)) != '\0') {
+        h ^= (uint8_t) ch;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool norm_eq(const char *p, const struct dcache_ent *ent) {
+    size_t i = 0;
+    char ch;
+    while ((ch = norm_next(&p)) != '\0') {
+        if (i >= ent->len || ent->path[i] != ch) {
+            return false;
+        }
+        ++i;
+    }
+    return i == ent->len;
+}
+
+static void norm_copy(const char *p, char *out) {
+    char ch;
+    while ((ch = norm_next(&p)) != '\0') {
+        *(out++) = ch;
+    }
+    *out = '\0';
+}
+
+static bool is_dots(const char *comp, size_t len) {
+    return (len == 1 && comp[0] == '.')
+           || (len == 2 && comp[0] == '.' && comp[1] == '.');
+}
+
+char *dcache_resolve(const char *path) {
+    const char *s = path;
+    bool dots = false;
+    while (*s != '\0' && !dots) {
+        for (; *s == '/'; ++s) {}
+        const char *comp = s;
+        for (; *s != '/' && *s != '\0'; ++s) {}
+        dots = is_dots(comp, s - comp);
+    }
+    if (!dots) {
+        return NULL;
+    }
+
+    // no symlinks, so .. can just drop the component before it. .. of the
+    // root is the root
+    bool abs = path[0] == '/';
+    char *out = kmalloc_sync(strlen(path) + 2);
+    size_t o = 0;
+    for (s = path; *s != '\0';) {
+        for (; *s == '/'; ++s) {}
+        const char *comp = s;
+        for (; *s != '/' && *s != '\0'; ++s) {}
+        size_t len = s - comp;
+
+        if (len == 0 || (len == 1 && comp[0] == '.')) {
+            continue;
+        } else if (is_dots(comp, len)) {
+            for (; o > 0 && out[o-1] != '/'; --o) {}
+            if (o > 0) {
+                --o;
+            }
+        } else {
+            if (o > 0 || abs) {
+                out[o++] = '/';
+            }
+            memcpy(out + o, comp, len);
+            o += len;
+        }
+    }
+    if (o == 0 && abs) {
+        out[o++] = '/';
+    }
+    out[o] = '\0';
+    return out;
+}
+
+static struct icache_ent *iget(const struct inode *in) {
+    size_t b = (in->inode_id ^ (uintptr_t) in->fs) % ICACHE_BUCKETS;
+    for (struct icache_ent *ie = ibuckets[b]; ie != NULL; ie = ie->next) {
+        if (ie->in.fs == in->fs && ie->in.inode_id == in->inode_id) {
+            ie->refcnt++;
+            return ie;
+        }
+    }
+
+    struct icache_ent *ie = kmalloc_sync(sizeof(struct icache_ent));
+    ie->in = *in;
+    ie->refcnt = 1;
+    ie->next = ibuckets[b];
+    ibuckets[b] = ie;
+    return ie;
+}
+
+static void iput(struct icache_ent *ie) {
+    if (--ie->refcnt > 0) {
+        return;
+    }
+
+    size_t b = (ie->in.inode_id ^ (uintptr_t) ie->in.fs) % ICACHE_BUCKETS;
+    for (struct icache_ent **i = &(ibuckets[b]); *i != NULL;
+         i = &((*i)->next)) {
+        if (*i == ie) {
+            *i = ie->next;
+            break;
+        }
+    }
+    kfree_sync(ie);
+}
+
+static void lru_unlink(struct dcache_ent *ent) {
+    if (ent->lru_prev != NULL) {
+        ent->lru_prev->lru_next = ent->lru_next;
+    } else {
+        lru_head = ent->lru_next;
+    }
+    if (ent->lru_next != NULL) {
+        ent->lru_next->lru_prev = ent->lru_prev;
+    } else {
+        lru_tail = ent->lru_prev;
+    }
+}
+
+static void lru_push(struct dcache_ent *ent) {
+    ent->lru_prev = NULL;
+    ent->lru_next = lru_head;
+    if (lru_head != NULL) {
+        lru_head->lru_prev = ent;
+    } else {
+        lru_tail = ent;
+    }
+    lru_head = ent;
+}
+
+static void remove_ent(struct dcache_ent *ent) {
+    for (struct dcache_ent **i = &(buckets[ent->hash % DCACHE_BUCKETS]);
+         *i != NULL; i = &((*i)->next)) {
+        if (*i == ent) {
+            *i = ent->next;
+            break;
+        }
+    }
+    lru_unlink(ent);
+
+    if (ent->inode != NULL) {
+        iput(ent->inode);
+    }
+    kfree_sync(ent->path);
+    kfree_sync(ent);
+    nents--;
+}
+
+static void evict(void) {
+    while (lru_tail->referenced) {
+        struct dcache_ent *ent = lru_tail;
+        ent->referenced = false;
+        lru_unlink(ent);
+        lru_push(ent);
+    }
+    remove_ent(lru_tail);
+}
+
+static struct dcache_ent *find(const char *path, uint32_t hash) {
+    for (struct dcache_ent *ent = buckets[hash % DCACHE_BUCKETS];
+         ent != NULL; ent = ent->next) {
+        if (ent->hash == hash && norm_eq(path, ent)) {
+            return ent;
+        }
+    }
+    return NULL;
+}
+
+bool dcache_lookup(const char *path, struct inode *inode, int *err) {
+    uint32_t hash = norm_hash(path);
+
+    read_lock(&dcache_lock);
+    struct dcache_ent *ent = find(path, hash);
+    if (ent == NULL) {
+        read_unlock(&dcache_lock);
+        return false;
+    }
+
+    ent->referenced = true;
+
+    *err = ent->err;
+    if (ent->err == 0) {
+        *inode = ent->inode->in;
+    }
+    read_unlock(&dcache_lock);
+    return true;
+}
+
+void dcache_insert(const char *path, const struct inode *inode, int err) {
+    uint32_t hash = norm_hash(path);
+
+    write_lock(&dcache_lock);
+    if (find(path, hash) != NULL) {
+        // someone else got here first
+        write_unlock(&dcache_lock);
+        return;
+    }
+
+    if (nents == DCACHE_SIZE) {
+        evict();
+    }
+
+    struct dcache_ent *ent = kmalloc_sync(sizeof(struct dcache_ent));
+    ent->len = norm_len(path);
+    ent->path = kmalloc_sync(ent->len + 1);
+    norm_copy(path, ent->path);
+    ent->hash = hash;
+    ent->err = err;
+    ent->inode = (err == 0)? iget(inode) : NULL;
+    ent->referenced = false;
+
+    ent->next = buckets[hash % DCACHE_BUCKETS];
+    buckets[hash % DCACHE_BUCKETS] = ent;
+    lru_push(ent);
+    nents++;
+
+    write_unlock(&dcache_lock);
+}
+
+// is ent path itself, or somewhere below it? norm is normalized
+static bool at_or_below(const struct dcache_ent *ent, const char *norm,
+                        size_t len) {
+    return ent->len >= len && memcmp(ent->path, norm, len) == 0
+           && (ent->len == len || ent->path[len] == '/');
+}
+
+void dcache_invalidate(const char *path) {
+    char *resolved = dcache_resolve(path);
+    if (resolved != NULL) {
+        path = resolved;
+    }
+    size_t len = norm_len(path);
+    char *norm = kmalloc_sync(len + 1);
+    norm_copy(path, norm);
+
+    // the entry for path may be an ENOENT, a file that creat just
+    // truncated, or a directory that just grew. the ones below it can only
+    // be failures (ENOENT or ENOTDIR), which something new could fix
+    write_lock(&dcache_lock);
+    struct dcache_ent *next;
+    for (struct dcache_ent *ent = lru_head; ent != NULL; ent = next) {
+        next = ent->lru_next;
+        if (at_or_below(ent, norm, len)
+            && (ent->err != 0 || ent->len == len)) {
+            remove_ent(ent);
+        }
+    }
+    write_unlock(&dcache_lock);
+
+    kfree_sync(norm);
+    if (resolved != NULL) {
+        kfree_sync(resolved);
+    }
+}
+
+void dcache_update(const struct inode *in) {
+    size_t b = (in->inode_id ^ (uintptr_t) in->fs) % ICACHE_BUCKETS;
+
+    write_lock(&dcache_lock);
+    for (struct icache_ent *ie = ibuckets[b]; ie != NULL; ie = ie->next) {
+        if (ie->in.fs == in->fs && ie->in.inode_id == in->inode_id) {
+            ie->in = *in;
+            break;
+        }
+    }
+    write_unlock(&dcache_lock);
+}
+
+void dcache_flush(void) {
+    write_lock(&dcache_lock);
+    while (lru_head != NULL) {
+        remove_ent(lru_head);
+    }
+    write_unlock(&dcache_lock);
+}
@@ -0,0 +1,32 @@
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include <stdbool.h>
+#include "fs.h"
+
+// caches the results of fs_lookup by path, including failures. the
+// inodes are shared between the paths that reach them and refcounted.
+
+// returns true on a hit, setting *err (0 or -errno) and, if it is 0, *inode
+bool dcache_lookup(const char *path, struct inode *inode, int *err);
+
+// records the result of a lookup. inode is ignored if err is not 0
+void dcache_insert(const char *path, const struct inode *inode, int err);
+
+// path with its . and .. components resolved, the form lookups are cached
+// under, in a new buffer for the caller to free. NULL if there are none, so
+// path can be used as it is
+char *dcache_resolve(const char *path);
+
+// something was created at path, or path itself changed (a file was
+// truncated, a directory grew). drops its entry, and the failed lookups
+// below it that the change may fix
+void dcache_invalidate(const char *path);
+
+// an inode changed, eg. its size. the cached copy, if any, is replaced
+void dcache_update(const struct inode *in);
+
+// drops everything, for mount changes
+void dcache_flush(void);
+
+#endif
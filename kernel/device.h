@@ -10,6 +10,12 @@ enum device_majors {
     DEV_COMTTY = 3,
     DEV_FB     = 4,
     DEV_FBTTY  = 5,
+    DEV_BLOCK  = 6, // block devices' minors come from block_register
+    DEV_ATA    = 7,
+    DEV_VIRTIO = 8,
+    DEV_PCI    = 9,
+    DEV_IRQSTAT = 10,
+    DEV_IRQSOFF = 11,
 };
 
 #endif
@@ -0,0 +1,337 @@
+// ide disks, with pci bus master dma. the controller has to be in legacy
+// mode (ports 0x1f0 and 0x170, irqs 14 and 15), which is what qemu and
+// most bioses give us.
+
+#include "ata.h"
+#include "pci.h"
+#include "../block.h"
+#include "../device.h"
+#include "../mem.h"
+#include "../kdebug.h"
+#include "../arch/i686/io.h"
+#include "../arch/i686/interrupts.h"
+#include <errno.h>
+#include <string.h>
+
+// task file, from the io base
+#define REG_DATA    0
+#define REG_ERROR   1
+#define REG_COUNT   2
+#define REG_LBA0    3
+#define REG_LBA1    4
+#define REG_LBA2    5
+#define REG_DRIVE   6
+#define REG_STATUS  7
+#define REG_COMMAND 7
+
+#define ST_ERR  (1 << 0)
+#define ST_DRQ  (1 << 3)
+#define ST_DF   (1 << 5)
+#define ST_BSY  (1 << 7)
+
+#define CMD_READ_DMA      0xc8
+#define CMD_READ_DMA_EXT  0x25
+#define CMD_WRITE_DMA     0xca
+#define CMD_WRITE_DMA_EXT 0x35
+#define CMD_IDENTIFY      0xec
+
+// bus master, from bar 4. the secondary channel's are 8 up
+#define BM_COMMAND 0
+#define BM_STATUS  2
+#define BM_PRDT    4
+
+#define BM_CMD_START (1 << 0)
+#define BM_CMD_READ  (1 << 3) // the device writes memory
+
+#define BM_ST_ACTIVE (1 << 0)
+#define BM_ST_ERR    (1 << 1)
+#define BM_ST_IRQ    (1 << 2)
+
+// physical region descriptor. a region can't cross 64k, which a page
+// never does
+struct prd {
+    uint32_t addr;
+    uint16_t len;
+    uint16_t flags;
+} __attribute__((packed));
+
+#define PRD_EOT 0x8000
+
+#define LBA28_MAX (1 << 28)
+
+struct ata_drive;
+
+struct ata_channel {
+    uint16_t io;
+    uint16_t ctrl;
+    uint16_t bm;
+    int irq;
+
+    struct prd *prdt;
+
+    // the two drives share the channel, so one waits for the other
+    struct ata_drive *active;
+    struct block_request *req;
+    struct ata_drive *waiting;
+    struct block_request *wreq;
+};
+
+struct ata_drive {
+    struct ata_channel *chan;
+    bool slave;
+    bool lba48;
+    struct block_dev dev;
+};
+
+static struct ata_channel channels[2] = {
+    { .io = 0x1f0, .ctrl = 0x3f6, .irq = 14 },
+    { .io = 0x170, .ctrl = 0x376, .irq = 15 },
+};
+
+static struct ata_drive drives[4];
+static const char *const names[4] = { "hda", "hdb", "hdc", "hdd" };
+
+// the global lock must be held
+static void issue(struct ata_drive *d, struct block_request *req) {
+    struct ata_channel *c = d->chan;
+    c->active = d;
+    c->req = req;
+
+    for (size_t i = 0; i < req->nbufs; ++i) {
+        // kernel memory is identity mapped
+        c->prdt[i].addr = (uintptr_t) req->bufs[i]->data;
+        c->prdt[i].len = BLOCK_SIZE;
+        c->prdt[i].flags = (i == req->nbufs - 1)? PRD_EOT : 0;
+    }
+
+    uint8_t dir = (req->op == BLOCK_READ)? BM_CMD_READ : 0;
+    outl(c->bm + BM_PRDT, (uintptr_t) c->prdt);
+    outb(c->bm + BM_COMMAND, dir);
+    outb(c->bm + BM_STATUS, BM_ST_ERR | BM_ST_IRQ);
+
+    uint64_t lba = (uint64_t) req->blkno * BLOCK_SECTORS;
+    size_t count = req->nbufs * BLOCK_SECTORS;
+
+    if (d->lba48) {
+        outb(c->io + REG_DRIVE, 0x40 | (d->slave << 4));
+        outb(c->io + REG_COUNT, count >> 8);
+        outb(c->io + REG_LBA0, lba >> 24);
+        outb(c->io + REG_LBA1, lba >> 32);
+        outb(c->io + REG_LBA2, lba >> 40);
+        outb(c->io + REG_COUNT, count);
+        outb(c->io + REG_LBA0, lba);
+        outb(c->io + REG_LBA1, lba >> 8);
+        outb(c->io + REG_LBA2, lba >> 16);
+        outb(c->io + REG_COMMAND, (req->op == BLOCK_READ)?
+                                  CMD_READ_DMA_EXT : CMD_WRITE_DMA_EXT);
+    } else {
+        // a count of 0 is 256 sectors
+        outb(c->io + REG_DRIVE, 0xe0 | (d->slave << 4) | ((lba >> 24) & 0xf));
+        outb(c->io + REG_COUNT, count);
+        outb(c->io + REG_LBA0, lba);
+        outb(c->io + REG_LBA1, lba >> 8);
+        outb(c->io + REG_LBA2, lba >> 16);
+        outb(c->io + REG_COMMAND, (req->op == BLOCK_READ)?
+                                  CMD_READ_DMA : CMD_WRITE_DMA);
+    }
+
+    outb(c->bm + BM_COMMAND, dir | BM_CMD_START);
+}
+
+static void ata_start(struct block_dev *dev, struct block_request *req) {
+    struct ata_drive *d = dev->private_data;
+    struct ata_channel *c = d->chan;
+
+    if (c->req != NULL) {
+        // each drive has one request out at a time, so this is the other
+        kassert(c->waiting == NULL);
+        c->waiting = d;
+        c->wreq = req;
+        return;
+    }
+    issue(d, req);
+}
+
+// finishes the channel's request if the transfer is done. the global lock
+// must be held
+static void service(struct ata_channel *c) {
+    uint8_t bm = inb(c->bm + BM_STATUS);
+    if (c->req == NULL || !(bm & BM_ST_IRQ)) {
+        return;
+    }
+
+    outb(c->bm + BM_COMMAND, 0);
+    // reading the status acks the drive's irq
+    uint8_t st = inb(c->io + REG_STATUS);
+    outb(c->bm + BM_STATUS, BM_ST_ERR | BM_ST_IRQ);
+
+    int err = ((bm & BM_ST_ERR) || (st & (ST_ERR | ST_DF)))? -EIO : 0;
+    struct block_request *req = c->req;
+    c->req = NULL;
+    c->active = NULL;
+
+    if (c->waiting != NULL) {
+        struct ata_drive *d = c->waiting;
+        c->waiting = NULL;
+        issue(d, c->wreq);
+    }
+
+    block_complete(req, err);
+}
+
+static void ata_poll(struct block_dev *dev) {
+    struct ata_drive *d = dev->private_data;
+    service(d->chan);
+}
+
+static void ata_interrupt_handler(struct pushed_regs *regs) {
+    acquire_global();
+    service(&channels[regs->irq - 14]);
+    send_eoi(regs->irq);
+    release_global();
+}
+
+static const struct block_ops ops = {
+    .start = ata_start,
+    .poll = ata_poll,
+};
+
+// status polls before a drive counts as hung. each read is a bus cycle of
+// a microsecond or so, so this is around a second
+#define POLL_TRIES 1000000
+
+// waits for the status to have none of the bits in clear, and one of the
+// bits in set if it is nonzero. false if that never happens
+static bool poll_status(struct ata_channel *c, uint8_t clear, uint8_t set,
+                        uint8_t *st) {
+    for (size_t i = 0; i < POLL_TRIES; ++i) {
+        *st = inb(c->io + REG_STATUS);
+        if (!(*st & clear) && (set == 0 || (*st & set))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// returns -ENODEV if there is no ata disk there, and -EIO if the drive
+// doesn't answer. cdroms are skipped
+static int identify(struct ata_drive *d) {
+    struct ata_channel *c = d->chan;
+
+    outb(c->io + REG_DRIVE, 0xa0 | (d->slave << 4));
+    io_wait();
+    outb(c->io + REG_COUNT, 0);
+    outb(c->io + REG_LBA0, 0);
+    outb(c->io + REG_LBA1, 0);
+    outb(c->io + REG_LBA2, 0);
+    outb(c->io + REG_COMMAND, CMD_IDENTIFY);
+
+    uint8_t st = inb(c->io + REG_STATUS);
+    if (st == 0 || st == 0xff) {
+        return -ENODEV;
+    }
+    if (!poll_status(c, ST_BSY, 0, &st)) {
+        return -EIO;
+    }
+    if (inb(c->io + REG_LBA1) != 0 || inb(c->io + REG_LBA2) != 0) {
+        return -ENODEV;
+    }
+    if (!poll_status(c, 0, ST_DRQ | ST_ERR, &st)) {
+        return -EIO;
+    }
+    if (st & ST_ERR) {
+        return -ENODEV;
+    }
+
+    uint16_t id[256];
+    for (size_t i = 0; i < 256; ++i) {
+        id[i] = inw(c->io + REG_DATA);
+    }
+
+    uint64_t sectors = id[60] | ((uint32_t) id[61] << 16);
+    d->lba48 = (id[83] & (1 << 10)) != 0;
+    if (d->lba48) {
+        sectors = id[100] | ((uint32_t) id[101] << 16)
+                  | ((uint64_t) id[102] << 32) | ((uint64_t) id[103] << 48);
+    }
+    // lba48 commands are only needed past lba28's reach
+    d->lba48 = d->lba48 && sectors > LBA28_MAX;
+
+    d->dev.nblocks = sectors / BLOCK_SECTORS;
+    return (d->dev.nblocks > 0)? 0 : -ENODEV;
+}
+
+static int ata_probe(struct pci_dev *pci) {
+    // the legacy ports can only belong to one controller
+    if (channels[0].prdt != NULL) {
+        return -EBUSY;
+    }
+
+    // prog if bits 0 and 2: the channels are in native mode
+    if (pci->progif & 0x05) {
+        kprintf("ata: controller isn't in legacy mode\n");
+        return -ENOTSUP;
+    }
+    if (!(pci->progif & 0x80) || !pci->bars[4].io) {
+        kprintf("ata: controller can't do dma\n");
+        return -ENOTSUP;
+    }
+
+    uint16_t bm = pci->bars[4].base;
+    pci_enable_bus_master(pci);
+
+    for (size_t i = 0; i < 2; ++i) {
+        struct ata_channel *c = &channels[i];
+        c->bm = bm + 8*i;
+        c->prdt = alloc_page_ptr();
+        if (c->prdt == NULL) {
+            kprintf("ata: no memory\n");
+            return -ENOMEM;
+        }
+
+        // irqs on
+        outb(c->ctrl, 0);
+        register_interrupt_handler(32 + c->irq, ata_interrupt_handler);
+        IRQ_clear_mask(c->irq);
+    }
+
+    for (size_t i = 0; i < 4; ++i) {
+        struct ata_drive *d = &drives[i];
+        d->chan = &channels[i / 2];
+        d->slave = i % 2;
+        int err = identify(d);
+        if (err == -EIO) {
+            kprintf("ata: %s isn't answering\n", names[i]);
+        }
+        if (err < 0) {
+            continue;
+        }
+
+        d->dev.name = names[i];
+        d->dev.major = DEV_ATA;
+        d->dev.ops = &ops;
+        d->dev.private_data = d;
+
+        int minor = block_register(&d->dev);
+        if (minor < 0) {
+            kprintf("ata: %s\n", strerror(-minor));
+            continue;
+        }
+        kprintf("ata: /dev/%s, %lu MB%s\n", names[i],
+                (unsigned long) (d->dev.nblocks / (1024*1024 / BLOCK_SIZE)),
+                d->lba48? ", lba48" : "");
+    }
+    return 0;
+}
+
+static const struct pci_driver driver = {
+    .name = "ata",
+    .vendor = PCI_ANY,
+    .device = PCI_ANY,
+    .class = 0x0101,
+    .probe = ata_probe,
+};
+
+void ata_init(void) {
+    pci_register_driver(&driver);
+}
@@ -0,0 +1,7 @@
+#ifndef DEVICE_ATA_H
+#define DEVICE_ATA_H
+
+// finds the ide controller, and registers a block device for each disk
+void ata_init(void);
+
+#endif
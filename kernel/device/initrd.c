@@ -12,12 +12,26 @@ static int open(struct inode *in, struct file *file, int flags) {
 #define MIN(a, b) (((a)<(b))? (a):(b))
 
 static ssize_t read(struct file *f, char *buf, size_t n) {
+    if (f->offset >= f->size) {
+        return 0;
+    }
+
     size_t len = MIN(f->size - f->offset, n);
     memcpy(buf, start+f->offset, len);
     f->offset += len;
     return len;
 }
 
+static const char *peek(struct file *f, off_t off, size_t *len) {
+    if (off < 0 || off >= f->size) {
+        *len = 0;
+        return NULL;
+    }
+
+    *len = f->size - off;
+    return (const char *) start + off;
+}
+
 static struct file_ops fops;
 
 void initrd_init(void *s, void *e) {
@@ -29,6 +43,7 @@ void initrd_init(void *s, void *e) {
         .open = open,
         .lseek = fs_default_lseek,
         .read = read,
+        .peek = peek,
     };
 
     register_device(DEV_INITRD, &fops);
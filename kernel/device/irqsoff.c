@@ -0,0 +1,69 @@
+#include "irqsoff.h"
+#include "../device.h"
+#include "../fs/devfs.h"
+#include "../sync.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+// /dev/irqsoff, a line per window, longest first: its cycles, the cycle
+// count it began at, and where the global lock was taken and let go. for
+// a lock, semaphore or kmalloc_sync that took it, that is their caller:
+//
+//   183342 at 987654321 0x00104a1c 0x00104b80
+//
+// addr2line on the kernel turns those into lines. any write starts over
+
+// two 20 digit numbers, two addresses
+#define ENTRY_MAX 80
+
+static int irqsoff_open(struct inode *in, struct file *f, int flags) {
+    return 0;
+}
+
+static ssize_t irqsoff_read(struct file *f, char *buf, size_t count) {
+    // the lock is held for the copy only, the formatting happens after
+    struct irqsoff_window w[IRQSOFF_TOP];
+    acquire_global();
+    memcpy(w, irqsoff_windows, sizeof(w));
+    release_global();
+
+    char entry[ENTRY_MAX];
+    off_t pos = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < IRQSOFF_TOP && w[i].cycles != 0 && n < count;
+         ++i) {
+        size_t len = sprintf(entry, "%llu at %llu 0x%08lx 0x%08lx\n",
+                             w[i].cycles, w[i].start,
+                             (unsigned long) w[i].acquired_by,
+                             (unsigned long) w[i].released_by);
+        if (f->offset < pos + (off_t) len) {
+            size_t skip = f->offset - pos;
+            size_t take = len - skip;
+            if (take > count - n) {
+                take = count - n;
+            }
+            memcpy(buf + n, entry + skip, take);
+            n += take;
+            f->offset += take;
+        }
+        pos += len;
+    }
+    return n;
+}
+
+static ssize_t irqsoff_write(struct file *f, const char *buf, size_t count) {
+    irqsoff_reset();
+    return count;
+}
+
+static const struct file_ops fops = {
+    .open = irqsoff_open,
+    .read = irqsoff_read,
+    .write = irqsoff_write,
+};
+
+void irqsoff_init(void) {
+    register_device(DEV_IRQSOFF, &fops);
+    devfs_add("irqsoff", MKDEV(DEV_IRQSOFF, 0));
+}
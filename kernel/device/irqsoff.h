@@ -0,0 +1,7 @@
+#ifndef DEVICE_IRQSOFF_H
+#define DEVICE_IRQSOFF_H
+
+// adds /dev/irqsoff, the longest windows with interrupts off
+void irqsoff_init(void);
+
+#endif
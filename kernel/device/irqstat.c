@@ -0,0 +1,128 @@
+#include "irqstat.h"
+#include "../device.h"
+#include "../fs/devfs.h"
+#include "../kmalloc.h"
+#include "../sync.h"
+#include "../arch/i686/interrupts.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+// /dev/irqstat, a line per counter that isn't 0, as name, count and
+// handler cycles:
+//
+//   irq1 52 183342
+//   syscall 9120 40213377
+//   sys_read 1404 0
+//   pf_zero 388 0
+//
+// vectors are exc<n> for exceptions, irq<n> for the isa irqs and vec<n>
+// for the rest. only vectors have cycles, the others are counted inside
+// one and show 0
+
+static const char *const syscall_names[256] = {
+#define SYSCALL0(NAME, name, nr) [nr] = "sys_" #name,
+#define SYSCALL1(NAME, name, nr, ...) [nr] = "sys_" #name,
+#define SYSCALL2(NAME, name, nr, ...) [nr] = "sys_" #name,
+#define SYSCALL3(NAME, name, nr, ...) [nr] = "sys_" #name,
+#define SYSCALL4(NAME, name, nr, ...) [nr] = "sys_" #name,
+#define SYSCALL5(NAME, name, nr, ...) [nr] = "sys_" #name,
+#include <bits/syscall.def>
+#undef SYSCALL0
+#undef SYSCALL1
+#undef SYSCALL2
+#undef SYSCALL3
+#undef SYSCALL4
+#undef SYSCALL5
+};
+
+static const char *const pf_names[PF_NCOUNTS] = {
+    [PF_TABLE] = "pf_table",
+    [PF_ZERO]  = "pf_zero",
+    [PF_STALE] = "pf_stale",
+    [PF_USER]  = "pf_user",
+    [PF_WRITE] = "pf_write",
+};
+
+// a name and two 20 digit numbers
+#define ENTRY_MAX 64
+#define NLINES (256 + 256 + PF_NCOUNTS + 1)
+
+static char *put_line(char *p, const char *name, uint64_t count,
+                      uint64_t cycles) {
+    if (count == 0) {
+        return p;
+    }
+    return p + sprintf(p, "%s %llu %llu\n", name, count, cycles);
+}
+
+// returns the length of the listing
+static size_t list(char *buf) {
+    // a snapshot, so a line's count and cycles go together. the handlers
+    // don't take any lock to bump them
+    static struct irq_stats s;
+    acquire_global();
+    memcpy(&s, &irq_stats, sizeof(s));
+    release_global();
+
+    char *p = buf;
+    char name[16];
+    for (int v = 0; v < 256; ++v) {
+        const char *label = name;
+        if (v < 32) {
+            sprintf(name, "exc%i", v);
+        } else if (v < 48) {
+            sprintf(name, "irq%i", v - 32);
+        } else if (v == 0x80) {
+            label = "syscall";
+        } else {
+            sprintf(name, "vec%i", v);
+        }
+        p = put_line(p, label, s.count[v], s.cycles[v]);
+    }
+    p = put_line(p, "spurious", s.spurious, 0);
+
+    for (int i = 0; i < 256; ++i) {
+        // only the ones in the table get past the handler's check
+        if (syscall_names[i] != NULL) {
+            p = put_line(p, syscall_names[i], s.syscalls[i], 0);
+        }
+    }
+    for (int i = 0; i < PF_NCOUNTS; ++i) {
+        p = put_line(p, pf_names[i], s.page_faults[i], 0);
+    }
+    return p - buf;
+}
+
+static int irqstat_open(struct inode *in, struct file *f, int flags) {
+    return 0;
+}
+
+static ssize_t irqstat_read(struct file *f, char *buf, size_t count) {
+    // a reader wants them as they are now, so there's nothing to keep
+    char *text = kmalloc_sync(NLINES * ENTRY_MAX);
+    if (text == NULL) {
+        return -ENOMEM;
+    }
+    size_t len = list(text);
+
+    ssize_t n = 0;
+    if (f->offset < (off_t) len) {
+        n = (count < len - f->offset)? count : len - f->offset;
+        memcpy(buf, text + f->offset, n);
+        f->offset += n;
+    }
+
+    kfree_sync(text);
+    return n;
+}
+
+static const struct file_ops fops = {
+    .open = irqstat_open,
+    .read = irqstat_read,
+};
+
+void irqstat_init(void) {
+    register_device(DEV_IRQSTAT, &fops);
+    devfs_add("irqstat", MKDEV(DEV_IRQSTAT, 0));
+}
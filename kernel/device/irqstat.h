@@ -0,0 +1,7 @@
+#ifndef DEVICE_IRQSTAT_H
+#define DEVICE_IRQSTAT_H
+
+// adds /dev/irqstat, the interrupt counters as text
+void irqstat_init(void);
+
+#endif
@@ -0,0 +1,253 @@
+#include "pci.h"
+#include "../device.h"
+#include "../fs/devfs.h"
+#include "../kdebug.h"
+#include "../arch/paging.h"
+#include "../arch/i686/io.h"
+#include <stdio.h>
+#include <string.h>
+
+// the functions are found once at boot and kept in a table. drivers
+// register with the ids they handle, and are offered the matching ones.
+
+#define CONFIG_ADDRESS 0xcf8
+#define CONFIG_DATA    0xcfc
+
+#define PCI_ID        0x00
+#define PCI_COMMAND   0x04
+#define PCI_CLASS     0x08
+#define PCI_HEADER    0x0c
+#define PCI_BAR0      0x10
+#define PCI_IRQ       0x3c
+
+#define CMD_IO         (1 << 0)
+#define CMD_MEM        (1 << 1)
+#define CMD_BUS_MASTER (1 << 2)
+
+#define BAR_IO       (1 << 0)
+#define BAR_64       (1 << 2)
+#define BAR_PREFETCH (1 << 3)
+
+#define MAX_PCI_DEVS 64
+
+static struct pci_dev devs[MAX_PCI_DEVS];
+static size_t ndevs = 0;
+
+static uint32_t config_address(struct pci_addr addr, uint8_t off) {
+    return (1u << 31) | (addr.bus << 16) | (addr.slot << 11)
+           | (addr.func << 8) | (off & 0xfc);
+}
+
+uint32_t pci_read32(struct pci_addr addr, uint8_t off) {
+    outl(CONFIG_ADDRESS, config_address(addr, off));
+    return inl(CONFIG_DATA);
+}
+
+void pci_write32(struct pci_addr addr, uint8_t off, uint32_t val) {
+    outl(CONFIG_ADDRESS, config_address(addr, off));
+    outl(CONFIG_DATA, val);
+}
+
+// the size of a bar is found by writing all ones and seeing which bits
+// stick. decoding is off meanwhile, so the device doesn't answer at the
+// wrong address
+static void size_bars(struct pci_dev *d) {
+    uint32_t cmd = pci_read32(d->addr, PCI_COMMAND) & 0xffff;
+    pci_write32(d->addr, PCI_COMMAND, cmd & ~(CMD_IO | CMD_MEM));
+
+    for (int i = 0; i < 6; ++i) {
+        uint8_t off = PCI_BAR0 + 4*i;
+        uint32_t bar = pci_read32(d->addr, off);
+        pci_write32(d->addr, off, 0xffffffff);
+        uint32_t mask = pci_read32(d->addr, off);
+        pci_write32(d->addr, off, bar);
+
+        struct pci_bar *b = &d->bars[i];
+        b->io = (bar & BAR_IO) != 0;
+        if (b->io) {
+            b->base = bar & ~0x3;
+            b->size = ~(mask & ~0x3) + 1;
+            // io space is only 16 bits
+            b->size &= 0xffff;
+        } else {
+            b->base = bar & ~0xf;
+            b->size = ~(mask & ~0xf) + 1;
+            b->prefetch = (bar & BAR_PREFETCH) != 0;
+        }
+        if (mask == 0 || b->base == 0) {
+            memset(b, 0, sizeof(struct pci_bar));
+        }
+
+        if (!b->io && (bar & BAR_64)) {
+            // the next bar is the upper half. we can't reach past 4G
+            ++i;
+            if (pci_read32(d->addr, PCI_BAR0 + 4*i) != 0) {
+                memset(b, 0, sizeof(struct pci_bar));
+            }
+        }
+    }
+
+    pci_write32(d->addr, PCI_COMMAND, cmd);
+}
+
+static void add_function(struct pci_addr a, uint32_t id) {
+    if (ndevs == MAX_PCI_DEVS) {
+        return;
+    }
+    struct pci_dev *d = &devs[ndevs++];
+    memset(d, 0, sizeof(struct pci_dev));
+
+    uint32_t class = pci_read32(a, PCI_CLASS);
+    d->addr = a;
+    d->vendor = id & 0xffff;
+    d->device = id >> 16;
+    d->class = class >> 24;
+    d->subclass = class >> 16;
+    d->progif = class >> 8;
+
+    uint32_t irq = pci_read32(a, PCI_IRQ);
+    // no interrupt pin, no irq
+    d->irq = ((irq >> 8) & 0xff)? irq & 0xff : 0xff;
+
+    // only normal functions have six bars
+    if (((pci_read32(a, PCI_HEADER) >> 16) & 0x7f) == 0) {
+        size_bars(d);
+    }
+}
+
+static void scan(void) {
+    for (int bus = 0; bus < 256; ++bus) {
+        for (int slot = 0; slot < 32; ++slot) {
+            for (int func = 0; func < 8; ++func) {
+                struct pci_addr a = { bus, slot, func };
+                uint32_t id = pci_read32(a, PCI_ID);
+                if ((id & 0xffff) == 0xffff) {
+                    // no function 0 means no device
+                    if (func == 0) {
+                        break;
+                    }
+                    continue;
+                }
+
+                add_function(a, id);
+
+                // only multifunction devices have functions past 0
+                if (func == 0 && !(pci_read32(a, PCI_HEADER) & (0x80 << 16))) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static bool matches(const struct pci_driver *drv, const struct pci_dev *d) {
+    uint16_t class = (d->class << 8) | d->subclass;
+    return (drv->vendor == PCI_ANY || drv->vendor == d->vendor)
+           && (drv->device == PCI_ANY || drv->device == d->device)
+           && (drv->class == PCI_ANY || drv->class == class);
+}
+
+void pci_register_driver(const struct pci_driver *drv) {
+    for (size_t i = 0; i < ndevs; ++i) {
+        struct pci_dev *d = &devs[i];
+        if (d->driver == NULL && matches(drv, d) && drv->probe(d) == 0) {
+            d->driver = drv->name;
+        }
+    }
+}
+
+void *pci_map_bar(struct pci_dev *dev, int bar) {
+    struct pci_bar *b = &dev->bars[bar];
+    if (b->io || b->size == 0) {
+        return NULL;
+    }
+
+    uint32_t cmd = pci_read32(dev->addr, PCI_COMMAND);
+    pci_write32(dev->addr, PCI_COMMAND, (cmd & 0xffff) | CMD_MEM);
+
+    return map_mmio(b->base, b->size, b->prefetch);
+}
+
+void pci_enable_bus_master(struct pci_dev *dev) {
+    uint32_t cmd = pci_read32(dev->addr, PCI_COMMAND);
+    // the upper half is the status register, which is write 1 to clear
+    pci_write32(dev->addr, PCI_COMMAND, (cmd & 0xffff) | CMD_BUS_MASTER);
+}
+
+
+// /dev/pci, a line per function and one per bar in use:
+//
+//   00:01.1 8086:7010 class 01.01.80 irq - ata
+//     bar4 io 0xc040 size 0x10
+
+// the longest a function's lines can be
+#define ENTRY_MAX 384
+
+// formats d's lines into buf, returns their length
+static size_t list_entry(char *buf, const struct pci_dev *d) {
+    char *p = buf;
+    p += sprintf(p, "%02x:%02x.%x %04x:%04x class %02x.%02x.%02x irq ",
+                 d->addr.bus, d->addr.slot, d->addr.func, d->vendor,
+                 d->device, d->class, d->subclass, d->progif);
+    if (d->irq == 0xff) {
+        p += sprintf(p, "-");
+    } else {
+        p += sprintf(p, "%u", d->irq);
+    }
+    p += sprintf(p, " %s\n", (d->driver != NULL)? d->driver : "-");
+
+    for (int b = 0; b < 6; ++b) {
+        const struct pci_bar *bar = &d->bars[b];
+        if (bar->size == 0) {
+            continue;
+        }
+        if (bar->io) {
+            p += sprintf(p, "  bar%d io 0x%04x", b, bar->base);
+        } else {
+            p += sprintf(p, "  bar%d mem 0x%08x", b, bar->base);
+        }
+        p += sprintf(p, " size 0x%08x%s\n", bar->size,
+                     bar->prefetch? " prefetch" : "");
+    }
+    return p - buf;
+}
+
+static int pci_open(struct inode *in, struct file *f, int flags) {
+    return 0;
+}
+
+static ssize_t pci_read(struct file *f, char *buf, size_t count) {
+    // a function at a time, skipping the ones before the offset, so a
+    // read only formats what it hands back
+    char entry[ENTRY_MAX];
+    off_t pos = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < ndevs && n < count; ++i) {
+        size_t len = list_entry(entry, &devs[i]);
+        if (f->offset < pos + (off_t) len) {
+            size_t skip = f->offset - pos;
+            size_t take = len - skip;
+            if (take > count - n) {
+                take = count - n;
+            }
+            memcpy(buf + n, entry + skip, take);
+            n += take;
+            f->offset += take;
+        }
+        pos += len;
+    }
+    return n;
+}
+
+static const struct file_ops fops = {
+    .open = pci_open,
+    .read = pci_read,
+};
+
+void pci_init(void) {
+    scan();
+    kprintf("pci: %lu functions\n", (unsigned long) ndevs);
+
+    register_device(DEV_PCI, &fops);
+    devfs_add("pci", MKDEV(DEV_PCI, 0));
+}
@@ -0,0 +1,62 @@
+#ifndef DEVICE_PCI_H
+#define DEVICE_PCI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct pci_addr {
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+};
+
+struct pci_bar {
+    uint32_t base; // 0 if the bar is unused
+    uint32_t size;
+    bool io;
+    bool prefetch;
+};
+
+struct pci_dev {
+    struct pci_addr addr;
+    uint16_t vendor;
+    uint16_t device;
+    uint8_t class;
+    uint8_t subclass;
+    uint8_t progif;
+    uint8_t irq; // the legacy irq line the bios routed it to, or 0xff
+    struct pci_bar bars[6];
+    const char *driver; // whoever claimed it, or NULL
+};
+
+#define PCI_ANY 0xffff
+
+struct pci_driver {
+    const char *name;
+    // PCI_ANY matches anything. class is class << 8 | subclass
+    uint16_t vendor;
+    uint16_t device;
+    uint16_t class;
+    // returns 0 if it took the device
+    int (*probe)(struct pci_dev *dev);
+};
+
+// config space, through the legacy io ports. off is dword aligned
+uint32_t pci_read32(struct pci_addr addr, uint8_t off);
+void pci_write32(struct pci_addr addr, uint8_t off, uint32_t val);
+
+// finds every function and sizes its bars, and adds /dev/pci, which
+// lists them
+void pci_init(void);
+
+// probes every unclaimed function that matches
+void pci_register_driver(const struct pci_driver *drv);
+
+// maps a memory bar into the kernel. prefetchable bars are write through,
+// the rest uncached. returns NULL for io bars, or if it doesn't fit
+void *pci_map_bar(struct pci_dev *dev, int bar);
+
+// lets the function do dma
+void pci_enable_bus_master(struct pci_dev *dev);
+
+#endif
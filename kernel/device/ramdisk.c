@@ -0,0 +1,52 @@
+#include "ramdisk.h"
+#include "../block.h"
+#include "../device.h"
+#include "../kdebug.h"
+#include <string.h>
+
+static char *start;
+static size_t len;
+
+#define MIN(a, b) (((a)<(b))? (a):(b))
+
+static void rd_start(struct block_dev *dev, struct block_request *req) {
+    for (size_t i = 0; i < req->nbufs; ++i) {
+        size_t off = (req->blkno + i) * BLOCK_SIZE;
+        // the last block may be short
+        size_t n = MIN(len - off, BLOCK_SIZE);
+        char *data = req->bufs[i]->data;
+
+        if (req->op == BLOCK_READ) {
+            memcpy(data, start + off, n);
+            memset(data + n, 0, BLOCK_SIZE - n);
+        } else {
+            memcpy(start + off, data, n);
+        }
+    }
+
+    block_complete(req, 0);
+}
+
+static const struct block_ops ops = {
+    .start = rd_start,
+};
+
+static struct block_dev dev = {
+    .name = "ram0",
+    .major = DEV_BLOCK,
+    .ops = &ops,
+};
+
+void ramdisk_init(void *s, void *e) {
+    start = s;
+    len = (char *) e - start;
+    dev.nblocks = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    int minor = block_register(&dev);
+    if (minor < 0) {
+        kprintf("ramdisk: %s\n", strerror(-minor));
+        return;
+    }
+    kprintf("ramdisk: /dev/%s, %lu blocks\n", dev.name,
+            (unsigned long) dev.nblocks);
+}
@@ -0,0 +1,7 @@
+#ifndef DEVICE_RAMDISK_H
+#define DEVICE_RAMDISK_H
+
+// a block device over memory, eg. a multiboot module
+void ramdisk_init(void *start, void *end);
+
+#endif
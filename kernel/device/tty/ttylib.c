@@ -2,6 +2,8 @@
 #include <string.h>
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
 
 #define SEND_CHAR -1
 
@@ -15,7 +17,8 @@ void petix_tty_init(struct petix_tty *tty, struct tty_backend *out) {
 
 #define MIN(a, b) ((a < b)? a:b)
 
-ssize_t petix_tty_read(struct petix_tty *tty, char *buf, size_t count) {
+ssize_t petix_tty_read(struct petix_tty *tty, char *buf, size_t count,
+                       int flags) {
     acquire_lock(&tty->read_lock);
 
     ssize_t c = count;
@@ -49,12 +52,22 @@ ssize_t petix_tty_read(struct petix_tty *tty, char *buf, size_t count) {
         }
         release_global();
 
+        if ((size_t) c == count && (flags & O_NONBLOCK)) {
+            release_lock(&tty->read_lock);
+            return -EAGAIN;
+        }
+
         //eot
         if (buf[-1] == SEND_CHAR) {
             release_lock(&tty->read_lock);
             return (c-count) - 1;
         }
 
+        if (count > 0 && (flags & O_NONBLOCK)) {
+            release_lock(&tty->read_lock);
+            return c-count;
+        }
+
         if (count > 0) {
             cond_wait(&tty->read_sem);
         }
@@ -134,10 +147,24 @@ void petix_tty_input_seq(struct petix_tty *tty, const char *seq, size_t n) {
 
             tty->lbase = tty->loff;
             cond_wake(&tty->read_sem);
+            waitq_wake(&tty->read_waitq);
         }
     }
 }
 
+int petix_tty_poll(struct petix_tty *tty, struct poll_table *pt) {
+    acquire_global();
+    poll_wait(pt, &tty->read_waitq);
+    // writes never block
+    int mask = POLLOUT;
+    if (tty->lbase != tty->fbase) {
+        mask |= POLLIN;
+    }
+    release_global();
+
+    return mask;
+}
+
 ssize_t petix_tty_ioctl(struct petix_tty *tty, size_t req, va_list ap) {
     if (req == TCGETS) {
         struct termios *termios_p = va_arg(ap, void *);
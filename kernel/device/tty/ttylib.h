@@ -4,6 +4,7 @@
 #include <termios.h>
 #include <stddef.h>
 #include "../../sync.h"
+#include "../../fs.h"
 #include "ansiseq.h"
 #include <stdarg.h>
 
@@ -22,15 +23,20 @@ struct petix_tty {
     size_t fbase, lbase, loff;
     petix_lock_t read_lock, write_lock;
     petix_sem_t read_sem;
+    petix_waitq_t read_waitq;
 };
 
 void petix_tty_init(struct petix_tty *tty, struct tty_backend *out);
 
-ssize_t petix_tty_read(struct petix_tty *tty, char *buf, size_t count);
+// flags are the file's, for O_NONBLOCK
+ssize_t petix_tty_read(struct petix_tty *tty, char *buf, size_t count,
+                       int flags);
 ssize_t petix_tty_write(struct petix_tty *tty, const char *buf, size_t count);
 
 void petix_tty_input_seq(struct petix_tty *tty, const char *seq, size_t n);
 
+int petix_tty_poll(struct petix_tty *tty, struct poll_table *pt);
+
 ssize_t petix_tty_ioctl(struct petix_tty *tty, size_t req, va_list ap);
 
 #endif
@@ -3,6 +3,7 @@
 #include "../../../device.h"
 #include "../../../kdebug.h"
 #include "../../../kmalloc.h"
+#include "../../../sync.h"
 #include "../ansiseq.h"
 #include "../ttylib.h"
 #include "../kbd.h"
@@ -200,15 +201,35 @@ static struct ansi_term ansi_term = {
     .tty     = &tty
 };
 
+// the font and the first clear wait for the first open, so they don't
+// hold up boot. output can come from interrupts (keyboard echo, kprintf),
+// which mustn't read files, so it is dropped until then. the boot log is
+// on the vga and serial consoles anyway
+static petix_lock_t setup_lock;
+static volatile bool drawn = false;
+
+static void f_output(void *data, char ch) {
+    if (drawn) {
+        ansi_putch(data, ch);
+    }
+}
+
 static struct tty_backend tty_backend = {
     .row_n = 0,
     .col_n = 0,
     .backend_data = &ansi_term,
-    .putch = (void (*)(void *, char))ansi_putch
+    .putch = f_output,
 };
 
 
 static int dev_open(struct inode *in, struct file *file, int flags) {
+    acquire_lock(&setup_lock);
+    if (!drawn) {
+        load_psf_file("/share/fonts/default8x16.psfu");
+        ansi_init(&ansi_term);
+        drawn = true;
+    }
+    release_lock(&setup_lock);
     return 0;
 }
 
@@ -222,31 +243,32 @@ static ssize_t dev_write(struct file *f, const char *buf, size_t count) {
 }
 
 static ssize_t dev_read(struct file *f, char *buf, size_t count) {
-    return petix_tty_read(&tty, buf, count);
+    return petix_tty_read(&tty, buf, count, f->flags);
 }
 
 static int dev_ioctl(struct file *f, unsigned long req, va_list ap) {
     return petix_tty_ioctl(&tty, req, ap);
 }
 
+static int dev_poll(struct file *f, struct poll_table *pt) {
+    return petix_tty_poll(&tty, pt);
+}
+
 static struct file_ops fops = {
     .open  = dev_open,
     .write = dev_write,
     .read  = dev_read,
     .ioctl = dev_ioctl,
+    .poll  = dev_poll,
 };
 
 
 void fbtty_init(void) {
-
-    load_psf_file("/share/fonts/default8x16.psfu");
-
     ansi_backend.col_n = fb_width / CH_WIDTH;
     ansi_backend.row_n = fb_height / CH_HEIGHT;
     tty_backend.col_n = fb_width / CH_WIDTH;
     tty_backend.row_n = fb_height / CH_HEIGHT;
 
-    ansi_init(&ansi_term);
     petix_tty_init(&tty, &tty_backend);
 
     register_kbd_tty(&tty);
@@ -167,18 +167,23 @@ static ssize_t dev_write(struct file *f, const char *buf, size_t count) {
 }
 
 static ssize_t dev_read(struct file *f, char *buf, size_t count) {
-    return petix_tty_read(&tty, buf, count);
+    return petix_tty_read(&tty, buf, count, f->flags);
 }
 
 static int dev_ioctl(struct file *f, unsigned long req, va_list ap) {
     return petix_tty_ioctl(&tty, req, ap);
 }
 
+static int dev_poll(struct file *f, struct poll_table *pt) {
+    return petix_tty_poll(&tty, pt);
+}
+
 static struct file_ops fops = {
     .open  = dev_open,
     .write = dev_write,
     .read  = dev_read,
     .ioctl = dev_ioctl,
+    .poll  = dev_poll,
 };
 
 
@@ -0,0 +1,293 @@
+// virtio block devices, through the legacy pci interface (virtio 0.9.5).
+// every request is one indirect descriptor, so the ring never runs out of
+// descriptors, and several requests are out at once.
+
+#include "virtio_blk.h"
+#include "pci.h"
+#include "../block.h"
+#include "../device.h"
+#include "../mem.h"
+#include "../kdebug.h"
+#include "../arch/i686/io.h"
+#include "../arch/i686/interrupts.h"
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+
+#define VIRTIO_VENDOR 0x1af4
+#define VIRTIO_BLK_ID 0x1001
+
+// legacy registers, from bar 0
+#define REG_HOST_FEATURES  0x00
+#define REG_GUEST_FEATURES 0x04
+#define REG_QUEUE_PFN      0x08
+#define REG_QUEUE_SIZE     0x0c
+#define REG_QUEUE_SELECT   0x0e
+#define REG_QUEUE_NOTIFY   0x10
+#define REG_STATUS         0x12
+#define REG_ISR            0x13
+#define REG_CAPACITY       0x14 // blk config, in sectors
+
+#define STATUS_ACK       1
+#define STATUS_DRIVER    2
+#define STATUS_DRIVER_OK 4
+#define STATUS_FAILED    128
+
+#define F_INDIRECT_DESC (1 << 28)
+
+#define DESC_NEXT     1
+#define DESC_WRITE    2 // the device writes it
+#define DESC_INDIRECT 4
+
+#define AVAIL_NO_INTERRUPT 1
+#define USED_NO_NOTIFY     1
+
+#define BLK_IN  0
+#define BLK_OUT 1
+
+// requests out at once
+#define DEPTH 16
+
+struct vring_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed));
+
+struct vring_avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed));
+
+struct vring_used_elem {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed));
+
+struct vring_used {
+    uint16_t flags;
+    uint16_t idx;
+    struct vring_used_elem ring[];
+} __attribute__((packed));
+
+struct blk_hdr {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed));
+
+// what a request in flight needs. slot i always uses descriptor i
+struct slot {
+    struct vring_desc table[REQ_MAX_BUFS + 2];
+    struct blk_hdr hdr;
+    struct block_request *req;
+    volatile uint8_t status;
+};
+
+static uint16_t io;
+static uint16_t qsize;
+static volatile struct vring_desc *desc;
+static volatile struct vring_avail *avail;
+static volatile struct vring_used *used;
+static uint16_t last_used;
+
+static struct slot *slots;
+static uint32_t free_slots; // a bit per slot
+
+#define barrier() asm volatile ("" ::: "memory")
+#define ALIGN(x, a) (((x) + (a) - 1) / (a) * (a))
+
+static void vblk_start(struct block_dev *dev, struct block_request *req) {
+    // the block layer keeps at most DEPTH out
+    kassert(free_slots != 0);
+    int i = __builtin_ctz(free_slots);
+    free_slots &= ~(1u << i);
+
+    struct slot *s = &slots[i];
+    s->req = req;
+    s->status = 0xff;
+    s->hdr.type = (req->op == BLOCK_READ)? BLK_IN : BLK_OUT;
+    s->hdr.reserved = 0;
+    s->hdr.sector = (uint64_t) req->blkno * BLOCK_SECTORS;
+
+    // kernel memory is identity mapped
+    size_t n = 0;
+    s->table[n++] = (struct vring_desc) {
+        .addr = (uintptr_t) &s->hdr,
+        .len = sizeof(s->hdr),
+        .flags = DESC_NEXT,
+        .next = 1,
+    };
+    for (size_t b = 0; b < req->nbufs; ++b, ++n) {
+        s->table[n] = (struct vring_desc) {
+            .addr = (uintptr_t) req->bufs[b]->data,
+            .len = BLOCK_SIZE,
+            .flags = DESC_NEXT | ((req->op == BLOCK_READ)? DESC_WRITE : 0),
+            .next = n + 1,
+        };
+    }
+    s->table[n++] = (struct vring_desc) {
+        .addr = (uintptr_t) &s->status,
+        .len = 1,
+        .flags = DESC_WRITE,
+    };
+
+    desc[i].addr = (uintptr_t) s->table;
+    desc[i].len = n * sizeof(struct vring_desc);
+    desc[i].flags = DESC_INDIRECT;
+    desc[i].next = 0;
+
+    avail->ring[avail->idx % qsize] = i;
+    barrier();
+    avail->idx++;
+}
+
+// one notify per batch. the device says when it is already busy with the
+// ring, and will see the new entries without one
+static void vblk_kick(struct block_dev *dev) {
+    barrier();
+    if (!(used->flags & USED_NO_NOTIFY)) {
+        outw(io + REG_QUEUE_NOTIFY, 0);
+    }
+}
+
+// completes every finished request. the global lock must be held
+static void drain(void) {
+    while (last_used != used->idx) {
+        barrier();
+        uint32_t i = used->ring[last_used % qsize].id;
+        last_used++;
+
+        struct slot *s = &slots[i];
+        struct block_request *req = s->req;
+        int err = (s->status == 0)? 0 : -EIO;
+        s->req = NULL;
+        free_slots |= 1u << i;
+
+        block_complete(req, err);
+    }
+}
+
+static void vblk_poll(struct block_dev *dev) {
+    drain();
+}
+
+static void vblk_interrupt_handler(struct pushed_regs *regs) {
+    acquire_global();
+
+    // reading the isr acks it
+    if (inb(io + REG_ISR) & 1) {
+        // no more interrupts while we are draining. whatever finishes in the
+        // meantime is picked up by the second look
+        avail->flags |= AVAIL_NO_INTERRUPT;
+        drain();
+        avail->flags &= ~AVAIL_NO_INTERRUPT;
+        barrier();
+        drain();
+    }
+
+    send_eoi(regs->irq);
+    release_global();
+}
+
+static const struct block_ops ops = {
+    .start = vblk_start,
+    .kick = vblk_kick,
+    .poll = vblk_poll,
+};
+
+static struct block_dev dev = {
+    .name = "vda",
+    .major = DEV_VIRTIO,
+    .depth = DEPTH,
+    .ops = &ops,
+};
+
+static int vblk_probe(struct pci_dev *pci) {
+    // one device for now
+    if (slots != NULL) {
+        return -EBUSY;
+    }
+    if (!pci->bars[0].io || pci->irq == 0xff) {
+        return -ENOTSUP;
+    }
+
+    io = pci->bars[0].base;
+    pci_enable_bus_master(pci);
+
+    outb(io + REG_STATUS, 0);
+    outb(io + REG_STATUS, STATUS_ACK | STATUS_DRIVER);
+
+    uint32_t features = inl(io + REG_HOST_FEATURES);
+    if (!(features & F_INDIRECT_DESC)) {
+        kprintf("virtio-blk: no indirect descriptors\n");
+        outb(io + REG_STATUS, STATUS_FAILED);
+        return -ENOTSUP;
+    }
+    outl(io + REG_GUEST_FEATURES, F_INDIRECT_DESC);
+
+    outw(io + REG_QUEUE_SELECT, 0);
+    qsize = inw(io + REG_QUEUE_SIZE);
+    if (qsize < DEPTH) {
+        kprintf("virtio-blk: queue too small\n");
+        outb(io + REG_STATUS, STATUS_FAILED);
+        return -ENOTSUP;
+    }
+
+    // the legacy layout: descriptors and the available ring, then the used
+    // ring on the next page
+    size_t used_off = ALIGN(16*qsize + 6 + 2*qsize, PAGE_SIZE);
+    size_t len = used_off + ALIGN(6 + 8*qsize, PAGE_SIZE);
+    char *ring = alloc_pages_ptr(len / PAGE_SIZE);
+    size_t slots_len = ALIGN(DEPTH * sizeof(struct slot), PAGE_SIZE);
+    slots = alloc_pages_ptr(slots_len / PAGE_SIZE);
+    if (ring == NULL || slots == NULL) {
+        kprintf("virtio-blk: no memory\n");
+        outb(io + REG_STATUS, STATUS_FAILED);
+        return -ENOMEM;
+    }
+    memset(ring, 0, len);
+    memset(slots, 0, slots_len);
+
+    desc = (void *) ring;
+    avail = (void *) (ring + 16*qsize);
+    used = (void *) (ring + used_off);
+    last_used = 0;
+    free_slots = (DEPTH == 32)? 0xffffffff : (1u << DEPTH) - 1;
+
+    outl(io + REG_QUEUE_PFN, (uintptr_t) ring / PAGE_SIZE);
+
+    uint8_t irq = pci->irq;
+    register_interrupt_handler(32 + irq, vblk_interrupt_handler);
+    IRQ_clear_mask(irq);
+
+    outb(io + REG_STATUS, STATUS_ACK | STATUS_DRIVER | STATUS_DRIVER_OK);
+
+    uint64_t sectors = inl(io + REG_CAPACITY)
+                       | ((uint64_t) inl(io + REG_CAPACITY + 4) << 32);
+    dev.nblocks = sectors / BLOCK_SECTORS;
+
+    int minor = block_register(&dev);
+    if (minor < 0) {
+        kprintf("virtio-blk: %s\n", strerror(-minor));
+        return minor;
+    }
+    kprintf("virtio-blk: /dev/%s, %lu MB, irq %u\n", dev.name,
+            (unsigned long) (dev.nblocks / (1024*1024 / BLOCK_SIZE)),
+            (unsigned) irq);
+    return 0;
+}
+
+static const struct pci_driver driver = {
+    .name = "virtio-blk",
+    .vendor = VIRTIO_VENDOR,
+    .device = VIRTIO_BLK_ID,
+    .class = PCI_ANY,
+    .probe = vblk_probe,
+};
+
+void virtio_blk_init(void) {
+    pci_register_driver(&driver);
+}
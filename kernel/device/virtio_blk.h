@@ -0,0 +1,7 @@
+#ifndef DEVICE_VIRTIO_BLK_H
+#define DEVICE_VIRTIO_BLK_H
+
+// registers the first virtio disk as a block device, if there is one
+void virtio_blk_init(void);
+
+#endif
@@ -1,5 +1,8 @@
 #include "elf.h"
 #include "kdebug.h"
+#include "proc.h"
+#include "mem.h"
+#include "arch/paging.h"
 #include <string.h>
 
 uint8_t correct_e_ident[ELF_NIDENT] = {
@@ -15,7 +18,7 @@ bool check_elf_header(const Elf32_Ehdr *hdr) {
     return memcmp(hdr->e_ident, correct_e_ident, ELF_NIDENT) == 0;
 }
 
-uintptr_t load_elf_file(const void *file) {
+uintptr_t load_elf_file(const void *file, bool in_place) {
     const Elf32_Ehdr *hdr = file;
 
     //TODO this shouldn't be a kassert
@@ -23,16 +26,46 @@ uintptr_t load_elf_file(const void *file) {
     kassert(hdr->e_type == ET_EXEC);
 
     const Elf32_Phdr *phdrs = (file + hdr->e_phoff);
+    addr_space_t as = get_pcb(get_pid())->addr_space;
 
+    // the old image may have mapped pages here (mmap, or its own read-only
+    // segments). drop them so nothing below writes through them.
     for (size_t i = 0; i < hdr->e_phnum; ++i) {
         if (phdrs[i].p_type == PT_LOAD) {
             kassert(phdrs[i].p_vaddr >= 0xc0000000);
 
-            memcpy((void *) phdrs[i].p_vaddr,
-                   file + phdrs[i].p_offset,
-                   phdrs[i].p_filesz);
+            uintptr_t start = phdrs[i].p_vaddr & ~(uintptr_t)(PAGE_SIZE-1);
+            uintptr_t end = phdrs[i].p_vaddr + phdrs[i].p_memsz;
+            for (uintptr_t va = start; va < end; va += PAGE_SIZE) {
+                unmap_page_user(as, (void *) va);
+            }
         }
     }
+    flush_tlb();
+
+    for (size_t i = 0; i < hdr->e_phnum; ++i) {
+        if (phdrs[i].p_type == PT_LOAD) {
+            uintptr_t va = phdrs[i].p_vaddr;
+            const char *src = file + phdrs[i].p_offset;
+            size_t n = phdrs[i].p_filesz;
+
+            if (in_place && !(phdrs[i].p_flags & PF_W)) {
+                while (n >= PAGE_SIZE && (va & (PAGE_SIZE-1)) == 0
+                       && ((uintptr_t) src & (PAGE_SIZE-1)) == 0) {
+                    remap_page_user_ro(as, (void *) va, (void *) src);
+                    va += PAGE_SIZE;
+                    src += PAGE_SIZE;
+                    n -= PAGE_SIZE;
+                }
+            }
+
+            memcpy((void *) va, src, n);
+            memset((void *) (phdrs[i].p_vaddr + phdrs[i].p_filesz), 0,
+                   phdrs[i].p_memsz - phdrs[i].p_filesz);
+        }
+    }
+
+    flush_tlb();
 
     return hdr->e_entry;
 }
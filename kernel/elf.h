@@ -120,9 +120,17 @@ enum Ph_Types {
 
 };
 
+enum Ph_Flags {
+    PF_X = 0x1,
+    PF_W = 0x2,
+    PF_R = 0x4,
+};
+
 bool check_elf_header(const Elf32_Ehdr *hdr);
 
-// loads an executable elf file, and returns the entry point
-uintptr_t load_elf_file(const void *file);
+// loads an executable elf file into the current process, and returns the
+// entry point. if in_place, file is permanent memory (see peek), and
+// page aligned parts of read-only segments are mapped instead of copied.
+uintptr_t load_elf_file(const void *file, bool in_place);
 
 #endif
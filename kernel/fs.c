@@ -4,8 +4,14 @@
 #include <unistd.h>
 #include "sync.h"
 #include "kmalloc.h"
+#include "dcache.h"
 #include <string.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include "proc.h"
+#include "mem.h"
+#include "arch/paging.h"
 
 
 static struct file_ops const * devices[256];
@@ -52,6 +58,74 @@ int fs_open(struct inode *in, struct file *f, int flags) {
     return -EINVAL;
 }
 
+static mode_t inode_mode(const struct inode *in) {
+    mode_t perm = in->exec? 0755 : 0644;
+
+    if (in->ftype == FT_DIR) {
+        return S_IFDIR | 0755;
+    } else if (in->ftype == FT_LINK) {
+        return S_IFLNK | 0777;
+    } else if (in->ftype == FT_SPECIAL) {
+        return S_IFCHR | perm;
+    } else if (in->ftype == FT_FIFO) {
+        return S_IFIFO | 0600;
+    } else {
+        return S_IFREG | perm;
+    }
+}
+
+void fs_stat(const struct inode *in, struct stat *st) {
+    st->st_dev = 0;
+    st->st_ino = in->inode_id;
+    st->st_mode = inode_mode(in);
+    st->st_rdev = (in->ftype == FT_SPECIAL)? in->dev : 0;
+    st->st_size = (in->ftype == FT_REGULAR)? in->size : 0;
+    st->st_blksize = 4096;
+
+    if ((in->ftype == FT_REGULAR || in->ftype == FT_DIR)
+        && in->fs->iops->stat != NULL) {
+        in->fs->iops->stat(in, st);
+    }
+}
+
+static const uint8_t dirent_types[] = {
+    [FT_DIR]     = DT_DIR,
+    [FT_LINK]    = DT_LNK,
+    [FT_SPECIAL] = DT_CHR,
+    [FT_REGULAR] = DT_REG,
+    [FT_FIFO]    = DT_FIFO,
+};
+
+size_t fs_put_dirent(char *buf, size_t len, const char *name,
+                     const struct inode *in) {
+    size_t namelen = strnlen(name, FILE_NAME_LEN - 1);
+
+    // keep every record aligned for its off_t
+    size_t reclen = sizeof(struct petix_dirent_stat) + namelen + 1;
+    reclen = (reclen + sizeof(off_t) - 1) & ~(sizeof(off_t) - 1);
+    if (reclen > len) {
+        return 0;
+    }
+
+    struct petix_dirent_stat *d = (void *) buf;
+    d->reclen = reclen;
+    if (in == NULL) {
+        d->type = DT_UNKNOWN;
+        d->exec = false;
+        d->inode_id = 0;
+        d->size = 0;
+    } else {
+        d->type = dirent_types[in->ftype];
+        d->exec = in->exec;
+        d->inode_id = in->inode_id;
+        d->size = (in->ftype == FT_REGULAR)? in->size : 0;
+    }
+    memcpy(d->name, name, namelen);
+    d->name[namelen] = '\0';
+
+    return reclen;
+}
+
 int register_device(int major, const struct file_ops *ops) {
     kassert(major < 256 && major >= 0);
     devices[major] = ops;
@@ -73,7 +147,9 @@ off_t fs_default_lseek(struct file *f, off_t off, int whence) {
 }
 
 
-petix_lock_t mount_lock;
+// lookups only read the mount tree, so they take this shared. fs_mount and
+// fs_umount are the only writers.
+static petix_rwlock_t mount_lock;
 
 struct mount_tree {
     char name[FILE_NAME_LEN];
@@ -85,61 +161,79 @@ struct mount_tree {
 
 struct mount_tree mount_root;
 
-// the path buffers in this file comprised most of the stack allocations in the
-// petix kernel, so now they all share this buffer.
-static char path[PATH_MAX];
+// returns the next component of *p and its length, and moves *p past it.
+// returns NULL at the end of the path. nothing is copied, so lookups need no
+// shared scratch buffer.
+static const char *next_component(const char **p, size_t *len) {
+    const char *s = *p;
+    while (*s == '/') {
+        ++s;
+    }
+    if (*s == '\0') {
+        *p = s;
+        return NULL;
+    }
 
-static int fs_getfs(const char *p, struct fs_inst **fs, const char **relpath) {
+    const char *start = s;
+    while (*s != '/' && *s != '\0') {
+        ++s;
+    }
+    *len = s - start;
+    *p = s;
+    return start;
+}
 
-    strncpy(path, p, sizeof(path));
-    char *save;
+static struct mount_tree *find_child(struct mount_tree *node,
+                                     const char *name, size_t len) {
+    for (struct mount_tree *j = node->child; j != NULL; j = j->sibling) {
+        if (len < FILE_NAME_LEN && strncmp(j->name, name, len) == 0
+            && j->name[len] == '\0') {
+            return j;
+        }
+    }
+    return NULL;
+}
 
+// mount_lock must be held
+static int fs_getfs(const char *p, struct fs_inst **fs, const char **relpath) {
     struct mount_tree *node = &mount_root;
 
-    ssize_t reloff = -1;
-
+    const char *rel = NULL;
     if (node->mountpoint) {
         *fs = &(node->fs);
-        reloff = 0;
+        rel = p;
     }
 
-    for (char *i = strtok_r(path, "/", &save); i != NULL;
-         i = strtok_r(NULL, "/", &save)) {
-
-        bool found = false;
-        for (struct mount_tree *j = node->child; j != NULL; j = j->sibling) {
-            if (strncmp(j->name, i, FILE_NAME_LEN) == 0) {
-                found = true;
-                node = j;
-                break;
-            }
-        }
-
-        if (!found) {
+    const char *rest = p;
+    const char *comp;
+    size_t len;
+    while ((comp = next_component(&rest, &len)) != NULL) {
+        node = find_child(node, comp, len);
+        if (node == NULL) {
             break;
         }
 
         if (node->mountpoint) {
             *fs = &(node->fs);
-            reloff = save - path;
+            rel = rest;
         }
     }
 
-    if (reloff == -1) {
+    if (rel == NULL) {
         return -ENOENT;
     }
-    *relpath = p + reloff;
+    *relpath = rel;
     return 0;
 }
 
-int fs_lookup(const char *p, struct inode *inode) {
-    acquire_lock(&mount_lock);
+static int fs_lookup_uncached(const char *p, struct inode *inode) {
+    read_lock(&mount_lock);
 
     const char *p2;
     struct fs_inst *fs;
     int ret = fs_getfs(p, &fs, &p2);
     if (ret < 0) {
-        release_lock(&mount_lock);
+        read_unlock(&mount_lock);
         return ret;
     }
 
@@ -152,32 +246,62 @@ int fs_lookup(const char *p, struct inode *inode) {
             ret = fs->iops->lookup_all(fs, p2, inode);
         }
         if (ret < 0) {
-            release_lock(&mount_lock);
+            read_unlock(&mount_lock);
             return ret;
         }
     } else {
         kassert(fs->iops->getroot != NULL);
 
-        strncpy(path, p2, sizeof(path));
-
         fs->iops->getroot(fs, inode);
 
-        char *save;
-        for (char *i = strtok_r(path, "/", &save); i != NULL;
-            i = strtok_r(NULL, "/", &save)) {
+        const char *comp;
+        size_t len;
+        while ((comp = next_component(&p2, &len)) != NULL) {
+            char name[FILE_NAME_LEN];
+            if (len >= sizeof(name)) {
+                read_unlock(&mount_lock);
+                return -ENOENT;
+            }
+            memcpy(name, comp, len);
+            name[len] = '\0';
 
-            int ret = fs->iops->lookup(inode, i, inode);
+            int ret = fs->iops->lookup(inode, name, inode);
             if (ret < 0) {
-                release_lock(&mount_lock);
+                read_unlock(&mount_lock);
                 return ret;
             }
         }
     }
 
-    release_lock(&mount_lock);
+    read_unlock(&mount_lock);
     return 0;
 }
 
+int fs_lookup(const char *p, struct inode *inode) {
+    // the filesystems and the cache both see the path with . and ..
+    // resolved, so each spelling of a path has one entry to invalidate
+    char *resolved = dcache_resolve(p);
+    if (resolved != NULL) {
+        p = resolved;
+    }
+
+    int err;
+    if (!dcache_lookup(p, inode, &err)) {
+        err = fs_lookup_uncached(p, inode);
+
+        // only remember answers that can't change without a creat, mkdir,
+        // new device or mount
+        if (err == 0 || err == -ENOENT || err == -ENOTDIR) {
+            dcache_insert(p, inode, err);
+        }
+    }
+
+    if (resolved != NULL) {
+        kfree_sync(resolved);
+    }
+    return err;
+}
+
 static void unmount_child(struct mount_tree *node) {
     if (node == NULL) {
         return;
@@ -189,50 +313,120 @@ static void unmount_child(struct mount_tree *node) {
 }
 
 int fs_mount(const char *targ, struct inode *src, const struct inode_ops *fs) {
-    acquire_lock(&mount_lock);
-
-    strncpy(path, targ, sizeof(path));
-
-    char *save;
+    write_lock(&mount_lock);
 
     struct mount_tree *node = &mount_root;
-    for (char *i = strtok_r(path, "/", &save); i != NULL;
-         i = strtok_r(NULL, "/", &save)) {
 
-
-        bool insert = true;
-        for (struct mount_tree *j = node->child; j != NULL; j = j->sibling) {
-            if (strncmp(j->name, i, FILE_NAME_LEN) == 0) {
-                node = j;
-                insert = false;
-            }
+    const char *rest = targ;
+    const char *comp;
+    size_t len;
+    while ((comp = next_component(&rest, &len)) != NULL) {
+        if (len >= FILE_NAME_LEN) {
+            write_unlock(&mount_lock);
+            return -EINVAL;
         }
 
-        if (insert) {
+        struct mount_tree *nn = find_child(node, comp, len);
+
+        if (nn == NULL) {
             // allocate node
-            struct mount_tree *nn = kmalloc_sync(sizeof(struct mount_tree));
-            strncpy(nn->name, i, FILE_NAME_LEN);
+            nn = kmalloc_sync(sizeof(struct mount_tree));
+            memcpy(nn->name, comp, len);
+            nn->name[len] = '\0';
             nn->mountpoint = false;
             nn->child = NULL;
             nn->sibling = node->child;
 
             node->child = nn;
-            node = nn;
         }
+        node = nn;
     }
 
     unmount_child(node->child);
     node->mountpoint = true;
+    dcache_flush();
     fs_open(src, &(node->fs.file), 0);
     node->fs.iops = fs;
+    node->fs.private_data = NULL;
+    memset(&(node->fs.lock), 0, sizeof(petix_lock_t));
+    if (fs->mount != NULL) {
+        int err = fs->mount(&(node->fs));
+        if (err < 0) {
+            node->mountpoint = false;
+            write_unlock(&mount_lock);
+            return err;
+        }
+    }
 
-    release_lock(&mount_lock);
+    write_unlock(&mount_lock);
     return 0;
 }
 
 int fs_umount(const char *targ) {
-    acquire_lock(&mount_lock);
+    write_lock(&mount_lock);
+    dcache_flush();
 
-    release_lock(&mount_lock);
+    write_unlock(&mount_lock);
     return 0;
 }
+
+void *fs_mmap_image(struct file *f, const char *data, void *addr, size_t len,
+                    int prot, int flags, off_t off, int *errno) {
+    if (f->inode.ftype != FT_REGULAR) {
+        *errno = EACCES;
+        return MAP_FAILED;
+    }
+
+    char *caddr = addr;
+    if (caddr < (char *) PROC_REGION
+        || len > (size_t) (USER_STACK_TOP - caddr)) {
+        *errno = EINVAL;
+        return MAP_FAILED;
+    }
+
+    if (off < 0 || (off & (PAGE_SIZE-1))) {
+        *errno = EINVAL;
+        return MAP_FAILED;
+    }
+
+    bool private = (flags & MAP_PRIVATE) != 0;
+    if ((prot & PROT_WRITE) && !private) {
+        *errno = EACCES;
+        return MAP_FAILED;
+    }
+    bool copy = private && (prot & PROT_WRITE);
+
+    struct pcb *pcb = get_pcb(get_pid());
+
+    // drop earlier mappings first, so copies don't land in them
+    for (size_t i = 0; i < len; i += PAGE_SIZE) {
+        unmap_page_user(pcb->addr_space, caddr+i);
+    }
+    flush_tlb();
+
+    for (size_t i = 0; i < len; i += PAGE_SIZE) {
+        off_t foff = off + i;
+        const char *src = data + foff;
+
+        if (!copy && foff + PAGE_SIZE <= f->size
+            && ((uintptr_t) src & (PAGE_SIZE-1)) == 0) {
+            if (remap_page_user_ro(pcb->addr_space, caddr+i,
+                                   (void *) src) == -1) {
+                *errno = EFAULT;
+                return MAP_FAILED;
+            }
+            continue;
+        }
+
+        size_t n = 0;
+        if (foff < f->size) {
+            n = (f->size - foff < PAGE_SIZE)? f->size - foff : PAGE_SIZE;
+        }
+        memcpy(caddr+i, src, n);
+        memset(caddr+i+n, 0, PAGE_SIZE - n);
+    }
+
+    flush_tlb();
+
+    return addr;
+}
@@ -6,12 +6,14 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include "sync.h"
+#include <sys/stat.h>
 
 #define PATH_MAX 4096
 
 struct inode;
 struct file;
 struct fs_inst;
+struct poll_table;
 
 struct file_ops {
     int (*open)(struct inode *, struct file *, int);
@@ -20,8 +22,22 @@ struct file_ops {
     ssize_t (*read)(struct file *, char *, size_t);
     ssize_t (*write)(struct file *, const char *, size_t);
     int (*getdent)(struct file *, struct petix_dirent *);
+    // optional. fills buf with petix_dirent_stat records using
+    // fs_put_dirent, and returns the bytes used
+    ssize_t (*getdents)(struct file *, char *buf, size_t len);
     int (*ioctl)(struct file *, unsigned long, va_list);
     void *(*mmap)(struct file *, void *, size_t, int, int, off_t, int *);
+    // returns the ready POLL* events, after poll_wait on whatever queues
+    // would be woken when that changes
+    int (*poll)(struct file *, struct poll_table *);
+
+    // zero-copy hooks, used by splice and sendfile.
+    // peek returns the file's data at off and sets the contiguous length
+    // available. the memory must stay valid forever (eg. the initrd).
+    const char *(*peek)(struct file *, off_t off, size_t *len);
+    // like write, but may keep a reference to buf instead of copying it.
+    // buf must come from peek.
+    ssize_t (*write_ref)(struct file *, const char *buf, size_t);
 
     int (*close)(struct file *);
 };
@@ -29,6 +45,9 @@ struct file_ops {
 struct inode_ops {
     struct file_ops reg_ops;
 
+    // optional. called once fs->file is open, by fs_mount
+    int (*mount)(struct fs_inst *);
+
     int (*getroot)(struct fs_inst *, struct inode *);
 
     int (*lookup)(struct inode *, const char *fname, struct inode *);
@@ -36,6 +55,10 @@ struct inode_ops {
 
     int (*creat)(struct inode *, const char *name);
     int (*mkdir)(struct inode *, const char *name);
+
+    // optional. for writable filesystems, where lookups (and the dcache)
+    // only give a snapshot. fills in what may have changed since
+    void (*stat)(const struct inode *, struct stat *);
 };
 
 struct inode {
@@ -45,6 +68,7 @@ struct inode {
         FT_LINK,
         FT_SPECIAL,
         FT_REGULAR,
+        FT_FIFO,
     } ftype;
     size_t size; // optional. for use by file systems
     size_t inode_id;
@@ -61,11 +85,13 @@ struct file {
     off_t private_data;
     const struct file_ops *fops;
     long refcnt; // used only for file descriptor files
+    int flags; // O_NONBLOCK. shared by dups, set by open and fcntl
 };
 
 struct fs_inst {
     struct file file;
     petix_lock_t lock; //for use by the fs
+    void *private_data; //for use by the fs
     const struct inode_ops *iops;
 };
 
@@ -81,4 +107,21 @@ int register_device(int major, const struct file_ops *ops);
 
 off_t fs_default_lseek(struct file *f, off_t off, int whence);
 
+void fs_stat(const struct inode *in, struct stat *st);
+
+// appends a getdents record for the entry. returns its length, or 0 if it
+// does not fit in len. in may be NULL if the type is unknown
+size_t fs_put_dirent(char *buf, size_t len, const char *name,
+                     const struct inode *in);
+
+// mmap for files whose data sits in permanent memory (see peek). pages
+// that are page aligned in memory are mapped read-only in place. the rest,
+// and private writable mappings, get a copy with anything past the end of
+// the file zeroed.
+void *fs_mmap_image(struct file *f, const char *data, void *addr, size_t len,
+                    int prot, int flags, off_t off, int *errno);
+
+// registers the polling process on q. pt is NULL if it will not sleep
+void poll_wait(struct poll_table *pt, petix_waitq_t *q);
+
 #endif
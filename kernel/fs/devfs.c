@@ -2,6 +2,7 @@
 #include <errno.h>
 #include <string.h>
 #include "../device.h"
+#include "../dcache.h"
 
 enum inode_ids {
     ID_ROOT,
@@ -24,23 +25,45 @@ static int getroot(struct fs_inst *fs, struct inode *in) {
     return 0;
 }
 
+// the device nodes, in the order getdent lists them
+#define MAX_NODES 32
+
+struct devfs_node {
+    const char *name;
+    dev_t dev;
+};
+
+static struct devfs_node nodes[MAX_NODES] = {
+    {"vgatty", MKDEV(DEV_VGATTY, 0)},
+    {"comtty", MKDEV(DEV_COMTTY, 0)},
+    {"fb",     MKDEV(DEV_FB, 0)},
+    {"fbtty",  MKDEV(DEV_FBTTY, 0)},
+};
+static size_t nnodes = 4;
+
+int devfs_add(const char *name, dev_t dev) {
+    acquire_global();
+    if (nnodes == MAX_NODES) {
+        release_global();
+        return -ENOSPC;
+    }
+    nodes[nnodes].name = name;
+    nodes[nnodes].dev = dev;
+    nnodes++;
+    release_global();
+
+    // an earlier lookup may have cached it as missing
+    char path[sizeof(DEVFS_MOUNT) + FILE_NAME_LEN] = DEVFS_MOUNT "/";
+    strncat(path, name, FILE_NAME_LEN - 1);
+    dcache_invalidate(path);
+    return 0;
+}
+
 static int getdent(struct file *f, struct petix_dirent *d) {
-    if (f->offset == 0) {
-        d->inode_id = 0;
-        d->present = true;
-        strncpy(d->name, "vgatty", sizeof(d->name));
-    } else if (f->offset == 1) {
-        d->inode_id = 1;
-        d->present = true;
-        strncpy(d->name, "comtty", sizeof(d->name));
-    } else if (f->offset == 2) {
-        d->inode_id = 2;
+    if (f->offset >= 0 && f->offset < nnodes) {
+        d->inode_id = f->offset;
         d->present = true;
-        strncpy(d->name, "fb", sizeof(d->name));
-    } else if (f->offset == 3) {
-        d->inode_id = 3;
-        d->present = true;
-        strncpy(d->name, "fbtty", sizeof(d->name));
+        strncpy(d->name, nodes[f->offset].name, sizeof(d->name));
     } else {
         d->present = false;
     }
@@ -54,18 +77,13 @@ static int lookup_all(struct fs_inst *fs, const char *path, struct inode *in) {
     in->fs = fs;
     in->inode_id = ID_OTHER;
 
-    if (strcmp(path, "vgatty") == 0) {
-        in->dev = MKDEV(DEV_VGATTY, 0);
-    } else if (strcmp(path, "comtty") == 0) {
-        in->dev = MKDEV(DEV_COMTTY, 0);
-    } else if (strcmp(path, "fb") == 0) {
-        in->dev = MKDEV(DEV_FB, 0);
-    } else if (strcmp(path, "fbtty") == 0) {
-        in->dev = MKDEV(DEV_FBTTY, 0);
-    } else {
-        return -ENOENT;
+    for (size_t i = 0; i < nnodes; ++i) {
+        if (strcmp(path, nodes[i].name) == 0) {
+            in->dev = nodes[i].dev;
+            return 0;
+        }
     }
-    return 0;
+    return -ENOENT;
 }
 
 const struct inode_ops *get_devfs(void) {
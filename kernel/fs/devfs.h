@@ -3,6 +3,12 @@
 
 #include "../fs.h"
 
+// where kmain mounts it
+#define DEVFS_MOUNT "/dev"
+
 const struct inode_ops *get_devfs(void);
 
+// adds a node for dev. name must stay valid
+int devfs_add(const char *name, dev_t dev);
+
 #endif
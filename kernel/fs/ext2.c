@@ -0,0 +1,1509 @@
+#include "ext2.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../block.h"
+#include "../kmalloc.h"
+#include "../dcache.h"
+#include "../mem.h"
+#include "../proc.h"
+#include "../arch/paging.h"
+
+// ext2 on a block device, read-write. all disk access goes through the
+// buffer cache. ext2 blocks can be smaller than cache blocks, so they are
+// found by byte offset.
+//
+// on top of that the fs keeps its own caches:
+// - the superblock and the group descriptors, read at mount and written
+//   through on every change
+// - the block and inode bitmaps, loaded per group on first use, with a
+//   hint of where the next free block may be
+// - recently used inodes, in a direct mapped table
+// - the entries of recently used directories, hashed by name on the first
+//   lookup in them
+//
+// inode ids are inode numbers. fs->lock covers everything in the fs.
+// there is no unlink, so blocks are only freed by truncating in creat.
+
+#define EXT2_MAGIC 0xef53
+#define SUPER_OFF 1024
+#define ROOT_INO 2
+
+#define INCOMPAT_FILETYPE 0x0002
+#define RO_COMPAT_SPARSE_SUPER 0x0001
+#define RO_COMPAT_LARGE_FILE   0x0002
+
+// a directory with an htree index, which we don't keep up to date
+#define INDEX_FL 0x1000
+
+#define NDIRECT 12
+#define IND  12
+#define DIND 13
+#define TIND 14
+#define NBLOCKS 15
+
+#define FT_EXT2_REG 1
+#define FT_EXT2_DIR 2
+
+struct ext2_super {
+    uint32_t inodes_count;
+    uint32_t blocks_count;
+    uint32_t r_blocks_count;
+    uint32_t free_blocks_count;
+    uint32_t free_inodes_count;
+    uint32_t first_data_block;
+    uint32_t log_block_size;
+    uint32_t log_frag_size;
+    uint32_t blocks_per_group;
+    uint32_t frags_per_group;
+    uint32_t inodes_per_group;
+    uint32_t mtime;
+    uint32_t wtime;
+    uint16_t mnt_count;
+    uint16_t max_mnt_count;
+    uint16_t magic;
+    uint16_t state;
+    uint16_t errors;
+    uint16_t minor_rev_level;
+    uint32_t lastcheck;
+    uint32_t checkinterval;
+    uint32_t creator_os;
+    uint32_t rev_level;
+    uint16_t def_resuid;
+    uint16_t def_resgid;
+    // rev 1
+    uint32_t first_ino;
+    uint16_t inode_size;
+    uint16_t block_group_nr;
+    uint32_t feature_compat;
+    uint32_t feature_incompat;
+    uint32_t feature_ro_compat;
+} __attribute__((packed));
+
+struct ext2_group {
+    uint32_t block_bitmap;
+    uint32_t inode_bitmap;
+    uint32_t inode_table;
+    uint16_t free_blocks_count;
+    uint16_t free_inodes_count;
+    uint16_t used_dirs_count;
+    uint16_t pad;
+    uint8_t reserved[12];
+} __attribute__((packed));
+
+struct ext2_inode {
+    uint16_t mode;
+    uint16_t uid;
+    uint32_t size;
+    uint32_t atime;
+    uint32_t ctime;
+    uint32_t mtime;
+    uint32_t dtime;
+    uint16_t gid;
+    uint16_t links_count;
+    uint32_t blocks; // in 512 byte sectors
+    uint32_t flags;
+    uint32_t osd1;
+    uint32_t block[NBLOCKS];
+    uint32_t generation;
+    uint32_t file_acl;
+    uint32_t dir_acl;
+    uint32_t faddr;
+    uint8_t osd2[12];
+}; // naturally aligned, 128 bytes
+
+struct ext2_dirent {
+    uint32_t inode;
+    uint16_t rec_len;
+    uint8_t name_len;
+    uint8_t file_type;
+    char name[];
+} __attribute__((packed));
+
+#define DIRENT_LEN(namelen) ((8 + (namelen) + 3) & ~3u)
+
+#define ICACHE_SIZE 256
+#define DIR_CACHE_SIZE 32
+
+struct icache_ent {
+    uint32_t ino; // 0 if empty
+    struct ext2_inode raw;
+};
+
+struct dir_ent {
+    struct dir_ent *hnext;
+    uint32_t hash;
+    uint32_t ino;
+    char name[];
+};
+
+struct dir_cache {
+    uint32_t ino; // 0 if empty
+    uint32_t used; // for lru
+    size_t nentries;
+    size_t nbuckets; // a power of 2
+    struct dir_ent **buckets;
+};
+
+struct ext2_fs {
+    struct block_dev *dev;
+    struct ext2_super sb;
+    size_t block_size;
+    size_t inode_size;
+    size_t ngroups;
+    uint64_t gdt_off;
+    struct ext2_group *groups;
+    bool filetype;
+
+    uint8_t **block_bitmaps;
+    uint8_t **inode_bitmaps;
+    uint32_t *block_hint;
+
+    struct icache_ent icache[ICACHE_SIZE];
+
+    struct dir_cache dirs[DIR_CACHE_SIZE];
+    uint32_t dir_clock;
+};
+
+#define MIN(a, b) (((a)<(b))? (a):(b))
+
+static struct ext2_fs *ext2_of(const struct inode *in) {
+    return in->fs->private_data;
+}
+
+
+// raw access, at byte offsets. writes are left in the buffer cache
+static int rw_bytes(struct ext2_fs *e, uint64_t off, void *buf, size_t len,
+                    bool write) {
+    char *p = buf;
+    while (len > 0) {
+        size_t boff = off % BLOCK_SIZE;
+        size_t n = MIN(BLOCK_SIZE - boff, len);
+
+        struct buffer *b = bread(e->dev, off / BLOCK_SIZE);
+        if (b == NULL) {
+            return -EIO;
+        }
+        if (write) {
+            memcpy(b->data + boff, p, n);
+            bdirty(b);
+        } else {
+            memcpy(p, b->data + boff, n);
+        }
+        brelse(b);
+
+        off += n;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// returns ext2 block blk, in a held buffer
+static char *get_block(struct ext2_fs *e, uint32_t blk, struct buffer **bp) {
+    uint64_t off = (uint64_t) blk * e->block_size;
+    struct buffer *b = bread(e->dev, off / BLOCK_SIZE);
+    if (b == NULL) {
+        return NULL;
+    }
+    *bp = b;
+    return b->data + off % BLOCK_SIZE;
+}
+
+static int put_super(struct ext2_fs *e) {
+    return rw_bytes(e, SUPER_OFF, &e->sb, sizeof(e->sb), true);
+}
+
+static int put_group(struct ext2_fs *e, uint32_t g) {
+    return rw_bytes(e, e->gdt_off + g * sizeof(struct ext2_group),
+                    &e->groups[g], sizeof(struct ext2_group), true);
+}
+
+
+static int read_inode(struct ext2_fs *e, uint32_t ino,
+                      struct ext2_inode *raw) {
+    if (ino == 0 || ino > e->sb.inodes_count) {
+        return -EIO;
+    }
+
+    struct icache_ent *c = &e->icache[ino % ICACHE_SIZE];
+    if (c->ino == ino) {
+        *raw = c->raw;
+        return 0;
+    }
+
+    uint32_t g = (ino - 1) / e->sb.inodes_per_group;
+    uint32_t idx = (ino - 1) % e->sb.inodes_per_group;
+    uint64_t off = (uint64_t) e->groups[g].inode_table * e->block_size
+                   + (uint64_t) idx * e->inode_size;
+    int err = rw_bytes(e, off, raw, sizeof(struct ext2_inode), false);
+    if (err < 0) {
+        return err;
+    }
+
+    c->ino = ino;
+    c->raw = *raw;
+    return 0;
+}
+
+// with clear, the rest of the on-disk inode is zeroed too
+static int write_inode(struct ext2_fs *e, uint32_t ino,
+                       const struct ext2_inode *raw, bool clear) {
+    uint32_t g = (ino - 1) / e->sb.inodes_per_group;
+    uint32_t idx = (ino - 1) % e->sb.inodes_per_group;
+    uint64_t off = (uint64_t) e->groups[g].inode_table * e->block_size
+                   + (uint64_t) idx * e->inode_size;
+
+    struct icache_ent *c = &e->icache[ino % ICACHE_SIZE];
+    c->ino = ino;
+    c->raw = *raw;
+
+    if (clear && e->inode_size > sizeof(struct ext2_inode)) {
+        char zero[64];
+        memset(zero, 0, sizeof(zero));
+        for (size_t i = sizeof(struct ext2_inode); i < e->inode_size;
+             i += sizeof(zero)) {
+            int err = rw_bytes(e, off + i, zero,
+                               MIN(sizeof(zero), e->inode_size - i), true);
+            if (err < 0) {
+                return err;
+            }
+        }
+    }
+    return rw_bytes(e, off, (void *) raw, sizeof(struct ext2_inode), true);
+}
+
+
+// the cached bitmap of group g, loaded on first use
+static uint8_t *get_bitmap(struct ext2_fs *e, uint32_t g, bool inodes) {
+    uint8_t **cache = inodes? e->inode_bitmaps : e->block_bitmaps;
+    if (cache[g] != NULL) {
+        return cache[g];
+    }
+
+    uint8_t *map = kmalloc_sync(e->block_size);
+    if (map == NULL) {
+        return NULL;
+    }
+    uint32_t blk = inodes? e->groups[g].inode_bitmap : e->groups[g].block_bitmap;
+    if (rw_bytes(e, (uint64_t) blk * e->block_size, map, e->block_size,
+                 false) < 0) {
+        kfree_sync(map);
+        return NULL;
+    }
+    cache[g] = map;
+    return map;
+}
+
+// flips a bit in the cache and on disk
+static int set_bit(struct ext2_fs *e, uint32_t g, bool inodes, uint32_t bit,
+                   bool val) {
+    uint8_t *map = get_bitmap(e, g, inodes);
+    if (map == NULL) {
+        return -EIO;
+    }
+    if (val) {
+        map[bit / 8] |= 1 << (bit % 8);
+    } else {
+        map[bit / 8] &= ~(1 << (bit % 8));
+    }
+
+    uint32_t blk = inodes? e->groups[g].inode_bitmap : e->groups[g].block_bitmap;
+    return rw_bytes(e, (uint64_t) blk * e->block_size + bit / 8,
+                    &map[bit / 8], 1, true);
+}
+
+// returns the first clear bit at or after from, or n if there is none
+static uint32_t find_clear(const uint8_t *map, uint32_t from, uint32_t n) {
+    for (uint32_t bit = from; bit < n;) {
+        if (bit % 8 == 0 && map[bit / 8] == 0xff) {
+            bit += 8;
+            continue;
+        }
+        if (!(map[bit / 8] & (1 << (bit % 8)))) {
+            return bit;
+        }
+        ++bit;
+    }
+    return n;
+}
+
+static uint32_t group_blocks(struct ext2_fs *e, uint32_t g) {
+    uint32_t start = e->sb.first_data_block + g * e->sb.blocks_per_group;
+    return MIN(e->sb.blocks_per_group, e->sb.blocks_count - start);
+}
+
+// returns a new block, zeroed, or 0 if the disk is full. it is taken from
+// the goal group if it can be
+static uint32_t alloc_block(struct ext2_fs *e, uint32_t goal) {
+    if (e->sb.free_blocks_count == 0) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < e->ngroups; ++i) {
+        uint32_t g = (goal + i) % e->ngroups;
+        if (e->groups[g].free_blocks_count == 0) {
+            continue;
+        }
+
+        uint8_t *map = get_bitmap(e, g, false);
+        if (map == NULL) {
+            return 0;
+        }
+        uint32_t n = group_blocks(e, g);
+        uint32_t bit = find_clear(map, e->block_hint[g], n);
+        if (bit == n) {
+            e->block_hint[g] = n;
+            continue;
+        }
+        e->block_hint[g] = bit + 1;
+
+        if (set_bit(e, g, false, bit, true) < 0) {
+            return 0;
+        }
+        e->groups[g].free_blocks_count--;
+        e->sb.free_blocks_count--;
+        put_group(e, g);
+        put_super(e);
+
+        uint32_t blk = e->sb.first_data_block + g * e->sb.blocks_per_group
+                       + bit;
+
+        struct buffer *b;
+        char *data = get_block(e, blk, &b);
+        if (data != NULL) {
+            memset(data, 0, e->block_size);
+            bdirty(b);
+            brelse(b);
+        }
+        return blk;
+    }
+    return 0;
+}
+
+static void free_block(struct ext2_fs *e, uint32_t blk) {
+    uint32_t g = (blk - e->sb.first_data_block) / e->sb.blocks_per_group;
+    uint32_t bit = (blk - e->sb.first_data_block) % e->sb.blocks_per_group;
+
+    if (set_bit(e, g, false, bit, false) < 0) {
+        return;
+    }
+    e->groups[g].free_blocks_count++;
+    e->sb.free_blocks_count++;
+    put_group(e, g);
+    put_super(e);
+
+    if (bit < e->block_hint[g]) {
+        e->block_hint[g] = bit;
+    }
+}
+
+// returns a new inode number near goal, or 0 if there are none left
+static uint32_t alloc_inode(struct ext2_fs *e, uint32_t goal, bool dir) {
+    if (e->sb.free_inodes_count == 0) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < e->ngroups; ++i) {
+        uint32_t g = (goal + i) % e->ngroups;
+        if (e->groups[g].free_inodes_count == 0) {
+            continue;
+        }
+
+        uint8_t *map = get_bitmap(e, g, true);
+        if (map == NULL) {
+            return 0;
+        }
+
+        uint32_t bit = 0;
+        for (;; ++bit) {
+            bit = find_clear(map, bit, e->sb.inodes_per_group);
+            // the reserved inodes are normally marked used anyway
+            if (bit == e->sb.inodes_per_group
+                || g * e->sb.inodes_per_group + bit + 1 >= e->sb.first_ino) {
+                break;
+            }
+        }
+        if (bit == e->sb.inodes_per_group) {
+            continue;
+        }
+
+        if (set_bit(e, g, true, bit, true) < 0) {
+            return 0;
+        }
+        e->groups[g].free_inodes_count--;
+        if (dir) {
+            e->groups[g].used_dirs_count++;
+        }
+        e->sb.free_inodes_count--;
+        put_group(e, g);
+        put_super(e);
+
+        return g * e->sb.inodes_per_group + bit + 1;
+    }
+    return 0;
+}
+
+// undoes alloc_inode, for when what was meant to use it can't be made
+static void free_inode(struct ext2_fs *e, uint32_t ino, bool dir) {
+    uint32_t g = (ino - 1) / e->sb.inodes_per_group;
+    uint32_t bit = (ino - 1) % e->sb.inodes_per_group;
+
+    if (set_bit(e, g, true, bit, false) < 0) {
+        return;
+    }
+    e->groups[g].free_inodes_count++;
+    if (dir) {
+        e->groups[g].used_dirs_count--;
+    }
+    e->sb.free_inodes_count++;
+    put_group(e, g);
+    put_super(e);
+}
+
+
+// returns the disk block of the file's block n, or 0 for a hole. with
+// alloc, holes are filled, and raw is changed for the caller to write
+// back. 0 then means the disk is full or n is out of reach.
+static uint32_t bmap(struct ext2_fs *e, uint32_t ino, struct ext2_inode *raw,
+                     uint32_t n, bool alloc) {
+    uint32_t ptrs = e->block_size / 4;
+    uint32_t goal = (ino - 1) / e->sb.inodes_per_group;
+
+    uint32_t *slot;
+    int levels;
+    if (n < NDIRECT) {
+        slot = &raw->block[n];
+        levels = 0;
+    } else if ((n -= NDIRECT) < ptrs) {
+        slot = &raw->block[IND];
+        levels = 1;
+    } else if ((n -= ptrs) < ptrs * ptrs) {
+        slot = &raw->block[DIND];
+        levels = 2;
+    } else if ((n -= ptrs * ptrs) / ptrs / ptrs < ptrs) {
+        slot = &raw->block[TIND];
+        levels = 3;
+    } else {
+        return 0;
+    }
+
+    if (*slot == 0) {
+        if (!alloc || (*slot = alloc_block(e, goal)) == 0) {
+            return 0;
+        }
+        raw->blocks += e->block_size / 512;
+    }
+    uint32_t blk = *slot;
+
+    for (int level = levels; level > 0; --level) {
+        uint32_t span = 1;
+        for (int i = 1; i < level; ++i) {
+            span *= ptrs;
+        }
+        uint32_t idx = (n / span) % ptrs;
+
+        struct buffer *b;
+        uint32_t *table = (uint32_t *) get_block(e, blk, &b);
+        if (table == NULL) {
+            return 0;
+        }
+
+        if (table[idx] == 0) {
+            uint32_t nb = alloc ? alloc_block(e, goal) : 0;
+            if (nb == 0) {
+                brelse(b);
+                return 0;
+            }
+            table[idx] = nb;
+            bdirty(b);
+            raw->blocks += e->block_size / 512;
+        }
+        blk = table[idx];
+        brelse(b);
+    }
+    return blk;
+}
+
+// takes block n back out of the map and frees it, when bmap allocated it
+// but it couldn't be used. map blocks on the way stay for truncate
+static void bunmap(struct ext2_fs *e, struct ext2_inode *raw, uint32_t n) {
+    uint32_t ptrs = e->block_size / 4;
+
+    uint32_t *slot;
+    int levels;
+    if (n < NDIRECT) {
+        slot = &raw->block[n];
+        levels = 0;
+    } else if ((n -= NDIRECT) < ptrs) {
+        slot = &raw->block[IND];
+        levels = 1;
+    } else if ((n -= ptrs) < ptrs * ptrs) {
+        slot = &raw->block[DIND];
+        levels = 2;
+    } else {
+        n -= ptrs * ptrs;
+        slot = &raw->block[TIND];
+        levels = 3;
+    }
+
+    struct buffer *b = NULL;
+    for (int level = levels; level > 0 && *slot != 0; --level) {
+        uint32_t span = 1;
+        for (int i = 1; i < level; ++i) {
+            span *= ptrs;
+        }
+
+        struct buffer *tb;
+        uint32_t *table = (uint32_t *) get_block(e, *slot, &tb);
+        if (b != NULL) {
+            brelse(b);
+            b = NULL;
+        }
+        if (table == NULL) {
+            return;
+        }
+        b = tb;
+        slot = &table[(n / span) % ptrs];
+    }
+
+    if (*slot != 0) {
+        free_block(e, *slot);
+        *slot = 0;
+        raw->blocks -= e->block_size / 512;
+        if (b != NULL) {
+            bdirty(b);
+        }
+    }
+    if (b != NULL) {
+        brelse(b);
+    }
+}
+
+// frees blk, and with levels > 0 everything it points to
+static void free_tree(struct ext2_fs *e, uint32_t blk, int levels) {
+    if (levels > 0) {
+        struct buffer *b;
+        uint32_t *table = (uint32_t *) get_block(e, blk, &b);
+        if (table != NULL) {
+            for (size_t i = 0; i < e->block_size / 4; ++i) {
+                if (table[i] != 0) {
+                    free_tree(e, table[i], levels - 1);
+                }
+            }
+            brelse(b);
+        }
+    }
+    free_block(e, blk);
+}
+
+static void truncate(struct ext2_fs *e, uint32_t ino, struct ext2_inode *raw) {
+    for (int i = 0; i < NBLOCKS; ++i) {
+        if (raw->block[i] != 0) {
+            free_tree(e, raw->block[i], (i < NDIRECT)? 0 : i - NDIRECT + 1);
+            raw->block[i] = 0;
+        }
+    }
+    raw->size = 0;
+    raw->blocks = 0;
+    write_inode(e, ino, raw, false);
+}
+
+// copies len bytes at off out of the file. holes read as zeros
+static ssize_t read_data(struct ext2_fs *e, uint32_t ino,
+                         struct ext2_inode *raw, off_t off, char *buf,
+                         size_t len) {
+    size_t done = 0;
+    while (done < len && off < raw->size) {
+        size_t boff = off % e->block_size;
+        size_t chunk = MIN(e->block_size - boff, len - done);
+        chunk = MIN(chunk, raw->size - off);
+
+        uint32_t blk = bmap(e, ino, raw, off / e->block_size, false);
+        if (blk == 0) {
+            memset(buf + done, 0, chunk);
+        } else {
+            struct buffer *b;
+            const char *data = get_block(e, blk, &b);
+            if (data == NULL) {
+                return (done > 0)? (ssize_t) done : -EIO;
+            }
+            memcpy(buf + done, data + boff, chunk);
+            brelse(b);
+        }
+
+        done += chunk;
+        off += chunk;
+    }
+    return done;
+}
+
+
+static uint32_t name_hash(const char *name, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t) name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void dc_add(struct dir_cache *dc, const char *name, size_t len,
+                   uint32_t ino) {
+    // keep the load factor under 1
+    if (dc->nentries == dc->nbuckets) {
+        size_t nb = (dc->nbuckets == 0)? 16 : dc->nbuckets * 2;
+        struct dir_ent **buckets = kmalloc_sync(nb * sizeof(struct dir_ent *));
+        memset(buckets, 0, nb * sizeof(struct dir_ent *));
+
+        for (size_t i = 0; i < dc->nbuckets; ++i) {
+            struct dir_ent *next;
+            for (struct dir_ent *d = dc->buckets[i]; d != NULL; d = next) {
+                next = d->hnext;
+                d->hnext = buckets[d->hash & (nb - 1)];
+                buckets[d->hash & (nb - 1)] = d;
+            }
+        }
+        kfree_sync(dc->buckets);
+        dc->buckets = buckets;
+        dc->nbuckets = nb;
+    }
+
+    struct dir_ent *d = kmalloc_sync(sizeof(struct dir_ent) + len + 1);
+    d->hash = name_hash(name, len);
+    d->ino = ino;
+    memcpy(d->name, name, len);
+    d->name[len] = '\0';
+
+    d->hnext = dc->buckets[d->hash & (dc->nbuckets - 1)];
+    dc->buckets[d->hash & (dc->nbuckets - 1)] = d;
+    dc->nentries++;
+}
+
+static void dc_clear(struct dir_cache *dc) {
+    for (size_t i = 0; i < dc->nbuckets; ++i) {
+        struct dir_ent *next;
+        for (struct dir_ent *d = dc->buckets[i]; d != NULL; d = next) {
+            next = d->hnext;
+            kfree_sync(d);
+        }
+    }
+    kfree_sync(dc->buckets);
+    memset(dc, 0, sizeof(struct dir_cache));
+}
+
+// calls fn on every entry of the directory, until it returns nonzero.
+// returns that, or 0, or -errno
+static int dir_walk(struct ext2_fs *e, uint32_t ino, struct ext2_inode *raw,
+                    int (*fn)(struct ext2_dirent *, void *), void *arg) {
+    for (uint32_t n = 0; n < raw->size / e->block_size; ++n) {
+        uint32_t blk = bmap(e, ino, raw, n, false);
+        if (blk == 0) {
+            continue;
+        }
+
+        struct buffer *b;
+        char *data = get_block(e, blk, &b);
+        if (data == NULL) {
+            return -EIO;
+        }
+        for (size_t off = 0; off + 8 <= e->block_size;) {
+            struct ext2_dirent *d = (void *) (data + off);
+            if (d->rec_len < 8 || off + d->rec_len > e->block_size) {
+                break;
+            }
+            int ret = (d->inode != 0)? fn(d, arg) : 0;
+            if (ret != 0) {
+                brelse(b);
+                return ret;
+            }
+            off += d->rec_len;
+        }
+        brelse(b);
+    }
+    return 0;
+}
+
+static int dc_fill(struct ext2_dirent *d, void *arg) {
+    dc_add(arg, d->name, d->name_len, d->inode);
+    return 0;
+}
+
+// the directory's hashed entries, read in if they aren't cached
+static struct dir_cache *dir_cache(struct ext2_fs *e, uint32_t ino,
+                                   struct ext2_inode *raw) {
+    struct dir_cache *victim = &e->dirs[0];
+    for (size_t i = 0; i < DIR_CACHE_SIZE; ++i) {
+        struct dir_cache *dc = &e->dirs[i];
+        if (dc->ino == ino) {
+            dc->used = ++e->dir_clock;
+            return dc;
+        }
+        if (dc->used < victim->used) {
+            victim = dc;
+        }
+    }
+
+    dc_clear(victim);
+    if (dir_walk(e, ino, raw, dc_fill, victim) < 0) {
+        dc_clear(victim);
+        return NULL;
+    }
+    victim->ino = ino;
+    victim->used = ++e->dir_clock;
+    return victim;
+}
+
+static struct dir_cache *dir_cached(struct ext2_fs *e, uint32_t ino) {
+    for (size_t i = 0; i < DIR_CACHE_SIZE; ++i) {
+        if (e->dirs[i].ino == ino) {
+            return &e->dirs[i];
+        }
+    }
+    return NULL;
+}
+
+// returns the inode number of name in the directory, or 0
+static uint32_t dir_find(struct ext2_fs *e, uint32_t ino,
+                         struct ext2_inode *raw, const char *name) {
+    struct dir_cache *dc = dir_cache(e, ino, raw);
+    if (dc == NULL || dc->nbuckets == 0) {
+        return 0;
+    }
+
+    size_t len = strlen(name);
+    uint32_t h = name_hash(name, len);
+    for (struct dir_ent *d = dc->buckets[h & (dc->nbuckets - 1)]; d != NULL;
+         d = d->hnext) {
+        if (d->hash == h && strcmp(d->name, name) == 0) {
+            return d->ino;
+        }
+    }
+    return 0;
+}
+
+// adds an entry to the directory, in the slack of an existing one if there
+// is room, or else in a new block at the end
+static int dir_add(struct ext2_fs *e, uint32_t dino, struct ext2_inode *draw,
+                   const char *name, uint32_t ino, uint8_t type) {
+    size_t len = strlen(name);
+    size_t need = DIRENT_LEN(len);
+
+    struct ext2_dirent *slot = NULL;
+    struct buffer *b = NULL;
+    for (uint32_t n = 0; n < draw->size / e->block_size && slot == NULL;
+         ++n) {
+        uint32_t blk = bmap(e, dino, draw, n, false);
+        if (blk == 0) {
+            continue;
+        }
+        char *data = get_block(e, blk, &b);
+        if (data == NULL) {
+            return -EIO;
+        }
+
+        for (size_t off = 0; off + 8 <= e->block_size;) {
+            struct ext2_dirent *d = (void *) (data + off);
+            if (d->rec_len < 8 || off + d->rec_len > e->block_size) {
+                break;
+            }
+
+            size_t used = (d->inode == 0)? 0 : DIRENT_LEN(d->name_len);
+            if (d->rec_len - used >= need) {
+                if (used > 0) {
+                    // split the slack off into its own entry
+                    struct ext2_dirent *nd = (void *) (data + off + used);
+                    nd->rec_len = d->rec_len - used;
+                    d->rec_len = used;
+                    d = nd;
+                }
+                slot = d;
+                break;
+            }
+            off += d->rec_len;
+        }
+        if (slot == NULL) {
+            brelse(b);
+        }
+    }
+
+    if (slot == NULL) {
+        uint32_t n = draw->size / e->block_size;
+        uint32_t blk = bmap(e, dino, draw, n, true);
+        if (blk == 0) {
+            return -ENOSPC;
+        }
+
+        char *data = get_block(e, blk, &b);
+        if (data == NULL) {
+            // keeps any map blocks bmap added on the way
+            bunmap(e, draw, n);
+            write_inode(e, dino, draw, false);
+            return -EIO;
+        }
+        slot = (void *) data;
+        slot->rec_len = e->block_size;
+        draw->size += e->block_size;
+    }
+
+    slot->inode = ino;
+    slot->name_len = len;
+    slot->file_type = e->filetype? type : 0;
+    memcpy(slot->name, name, len);
+    bdirty(b);
+    brelse(b);
+
+    struct dir_cache *dc = dir_cached(e, dino);
+    if (dc != NULL) {
+        dc_add(dc, name, len, ino);
+    }
+    // the index no longer has every entry, so linux falls back to a scan
+    draw->flags &= ~INDEX_FL;
+    return write_inode(e, dino, draw, false);
+}
+
+
+static void ext2_to_inode(struct fs_inst *fs, uint32_t ino,
+                          const struct ext2_inode *raw, struct inode *in) {
+    memset(in, 0, sizeof(struct inode));
+    in->fs = fs;
+    in->inode_id = ino;
+    in->size = raw->size;
+    in->exec = (raw->mode & 0111) != 0;
+
+    uint16_t fmt = raw->mode & S_IFMT;
+    if (fmt == S_IFDIR) {
+        in->ftype = FT_DIR;
+    } else if (fmt == S_IFREG) {
+        in->ftype = FT_REGULAR;
+    } else if (fmt == S_IFCHR || fmt == S_IFBLK) {
+        in->ftype = FT_SPECIAL;
+        // the old encoding
+        in->dev = MKDEV((raw->block[0] >> 8) & 0xff, raw->block[0] & 0xff);
+    } else if (fmt == S_IFLNK) {
+        in->ftype = FT_LINK;
+    } else {
+        in->ftype = FT_FIFO;
+    }
+}
+
+static int eopen(struct inode *in, struct file *f, int flags) {
+    struct ext2_inode raw;
+
+    acquire_lock(&(in->fs->lock));
+    int err = read_inode(ext2_of(in), in->inode_id, &raw);
+    release_lock(&(in->fs->lock));
+
+    if (err == 0) {
+        f->size = raw.size;
+    }
+    return err;
+}
+
+static off_t elseek(struct file *f, off_t off, int whence) {
+    // for SEEK_END
+    struct ext2_inode raw;
+    acquire_lock(&(f->inode.fs->lock));
+    if (read_inode(ext2_of(&(f->inode)), f->inode.inode_id, &raw) == 0) {
+        f->size = raw.size;
+    }
+    release_lock(&(f->inode.fs->lock));
+    return fs_default_lseek(f, off, whence);
+}
+
+static ssize_t eread(struct file *f, char *buf, size_t len) {
+    if (f->inode.ftype != FT_REGULAR) {
+        return -EISDIR;
+    }
+    struct ext2_fs *e = ext2_of(&(f->inode));
+    uint32_t ino = f->inode.inode_id;
+
+    acquire_lock(&(f->inode.fs->lock));
+
+    struct ext2_inode raw;
+    ssize_t ret = read_inode(e, ino, &raw);
+    if (ret == 0) {
+        ret = read_data(e, ino, &raw, f->offset, buf, len);
+    }
+    if (ret > 0) {
+        f->offset += ret;
+    }
+    f->size = raw.size;
+
+    release_lock(&(f->inode.fs->lock));
+    return ret;
+}
+
+static ssize_t ewrite(struct file *f, const char *buf, size_t len) {
+    if (f->inode.ftype != FT_REGULAR) {
+        return -EISDIR;
+    }
+    struct ext2_fs *e = ext2_of(&(f->inode));
+    uint32_t ino = f->inode.inode_id;
+
+    acquire_lock(&(f->inode.fs->lock));
+
+    struct ext2_inode raw;
+    int err = read_inode(e, ino, &raw);
+    if (err < 0) {
+        release_lock(&(f->inode.fs->lock));
+        return err;
+    }
+
+    // sizes are 32 bits
+    size_t done = 0;
+    while (done < len && f->offset < 0xffffffff) {
+        size_t boff = f->offset % e->block_size;
+        size_t chunk = MIN(e->block_size - boff, len - done);
+        chunk = MIN(chunk, 0xffffffff - f->offset);
+
+        uint32_t blk = bmap(e, ino, &raw, f->offset / e->block_size, true);
+        if (blk == 0) {
+            err = -ENOSPC;
+            break;
+        }
+        struct buffer *b;
+        char *data = get_block(e, blk, &b);
+        if (data == NULL) {
+            err = -EIO;
+            break;
+        }
+        memcpy(data + boff, buf + done, chunk);
+        bdirty(b);
+        brelse(b);
+
+        done += chunk;
+        f->offset += chunk;
+        if (raw.size < f->offset) {
+            raw.size = f->offset;
+        }
+    }
+
+    write_inode(e, ino, &raw, false);
+    bool resized = f->size != (off_t) raw.size;
+    f->size = raw.size;
+    struct inode in;
+    ext2_to_inode(f->inode.fs, ino, &raw, &in);
+    release_lock(&(f->inode.fs->lock));
+
+    if (resized) {
+        dcache_update(&in);
+    }
+
+    if (done == 0 && len > 0) {
+        return (err < 0)? err : -EFBIG;
+    }
+    return done;
+}
+
+// the data is copied in, so shared mappings can only be read
+static void *emmap(struct file *f, void *addr, size_t len, int prot,
+                   int flags, off_t off, int *errno) {
+    if (f->inode.ftype != FT_REGULAR) {
+        *errno = EACCES;
+        return MAP_FAILED;
+    }
+
+    char *caddr = addr;
+    if (caddr < (char *) PROC_REGION
+        || len > (size_t) (USER_STACK_TOP - caddr)) {
+        *errno = EINVAL;
+        return MAP_FAILED;
+    }
+    if (off < 0 || (off & (PAGE_SIZE-1))) {
+        *errno = EINVAL;
+        return MAP_FAILED;
+    }
+    if ((prot & PROT_WRITE) && !(flags & MAP_PRIVATE)) {
+        *errno = EACCES;
+        return MAP_FAILED;
+    }
+
+    struct pcb *pcb = get_pcb(get_pid());
+
+    // drop earlier mappings first, so copies don't land in them
+    for (size_t i = 0; i < len; i += PAGE_SIZE) {
+        unmap_page_user(pcb->addr_space, caddr+i);
+    }
+    flush_tlb();
+
+    struct ext2_fs *e = ext2_of(&(f->inode));
+    uint32_t ino = f->inode.inode_id;
+    acquire_lock(&(f->inode.fs->lock));
+
+    struct ext2_inode raw;
+    ssize_t n = read_inode(e, ino, &raw);
+    if (n == 0) {
+        n = read_data(e, ino, &raw, off, caddr, len);
+    }
+
+    release_lock(&(f->inode.fs->lock));
+
+    if (n < 0) {
+        *errno = -n;
+        return MAP_FAILED;
+    }
+    memset(caddr + n, 0, len - n);
+    return addr;
+}
+
+// reads the directory entry at or after f->offset, skipping . and ..
+// returns 1, 0 at the end, or -errno
+static int next_dirent(struct file *f, struct ext2_fs *e,
+                       struct ext2_inode *raw, char *name, uint32_t *ino) {
+    while (f->offset < raw->size) {
+        uint32_t n = f->offset / e->block_size;
+        size_t off = f->offset % e->block_size;
+
+        uint32_t blk = bmap(e, f->inode.inode_id, raw, n, false);
+        if (blk == 0) {
+            f->offset = (off_t) (n + 1) * e->block_size;
+            continue;
+        }
+
+        struct buffer *b;
+        char *data = get_block(e, blk, &b);
+        if (data == NULL) {
+            return -EIO;
+        }
+        struct ext2_dirent *d = (void *) (data + off);
+        if (d->rec_len < 8 || off + d->rec_len > e->block_size) {
+            // corrupt, skip the rest of the block
+            brelse(b);
+            f->offset = (off_t) (n + 1) * e->block_size;
+            continue;
+        }
+        f->offset += d->rec_len;
+
+        bool dot = (d->name_len == 1 && d->name[0] == '.')
+                   || (d->name_len == 2 && d->name[0] == '.'
+                       && d->name[1] == '.');
+        if (d->inode != 0 && !dot) {
+            memcpy(name, d->name, d->name_len);
+            name[d->name_len] = '\0';
+            *ino = d->inode;
+            brelse(b);
+            return true;
+        }
+        brelse(b);
+    }
+    return false;
+}
+
+static int egetdent(struct file *f, struct petix_dirent *d) {
+    if (f->inode.ftype != FT_DIR) {
+        return -ENOTDIR;
+    }
+    struct ext2_fs *e = ext2_of(&(f->inode));
+
+    acquire_lock(&(f->inode.fs->lock));
+
+    struct ext2_inode raw;
+    int ret = read_inode(e, f->inode.inode_id, &raw);
+    uint32_t ino;
+    if (ret == 0) {
+        ret = next_dirent(f, e, &raw, d->name, &ino);
+    }
+    if (ret >= 0) {
+        d->present = ret;
+        d->inode_id = ret? ino : 0;
+        ret = 0;
+    }
+
+    release_lock(&(f->inode.fs->lock));
+    return ret;
+}
+
+static ssize_t egetdents(struct file *f, char *buf, size_t len) {
+    if (f->inode.ftype != FT_DIR) {
+        return -ENOTDIR;
+    }
+    struct ext2_fs *e = ext2_of(&(f->inode));
+
+    acquire_lock(&(f->inode.fs->lock));
+
+    struct ext2_inode raw;
+    int ret = read_inode(e, f->inode.inode_id, &raw);
+    if (ret < 0) {
+        release_lock(&(f->inode.fs->lock));
+        return ret;
+    }
+
+    size_t used = 0;
+    char name[FILE_NAME_LEN];
+    uint32_t ino;
+    for (;;) {
+        off_t prev = f->offset;
+        ret = next_dirent(f, e, &raw, name, &ino);
+        if (ret <= 0) {
+            break;
+        }
+
+        struct ext2_inode child;
+        struct inode in;
+        bool known = read_inode(e, ino, &child) == 0;
+        if (known) {
+            ext2_to_inode(f->inode.fs, ino, &child, &in);
+        }
+
+        size_t reclen = fs_put_dirent(buf + used, len - used, name,
+                                      known? &in : NULL);
+        if (reclen == 0) {
+            // it goes in the next call
+            f->offset = prev;
+            break;
+        }
+        used += reclen;
+    }
+
+    release_lock(&(f->inode.fs->lock));
+
+    if (ret < 0 && used == 0) {
+        return ret;
+    }
+    // not even one entry fits
+    if (used == 0 && ret > 0) {
+        return -EINVAL;
+    }
+    return used;
+}
+
+static int load_super(struct ext2_fs *e) {
+    int err = rw_bytes(e, SUPER_OFF, &e->sb, sizeof(e->sb), false);
+    if (err < 0) {
+        return err;
+    }
+    if (e->sb.magic != EXT2_MAGIC) {
+        return -EINVAL;
+    }
+
+    if (e->sb.rev_level == 0) {
+        e->sb.first_ino = 11;
+        e->sb.inode_size = 128;
+        e->sb.feature_incompat = 0;
+    }
+    // only the directory entry file types are understood. the read-only
+    // compatible features change nothing we write
+    if ((e->sb.feature_incompat & ~INCOMPAT_FILETYPE)
+        || (e->sb.feature_ro_compat
+            & ~(RO_COMPAT_SPARSE_SUPER | RO_COMPAT_LARGE_FILE))) {
+        return -ENOTSUP;
+    }
+    e->filetype = (e->sb.feature_incompat & INCOMPAT_FILETYPE) != 0;
+
+    if (e->sb.log_block_size > 2 || e->sb.blocks_per_group == 0
+        || e->sb.inodes_per_group == 0
+        || e->sb.inode_size < sizeof(struct ext2_inode)) {
+        return -EINVAL;
+    }
+    e->block_size = 1024 << e->sb.log_block_size;
+    e->inode_size = e->sb.inode_size;
+    e->ngroups = (e->sb.blocks_count - e->sb.first_data_block
+                  + e->sb.blocks_per_group - 1) / e->sb.blocks_per_group;
+    e->gdt_off = (uint64_t) (e->sb.first_data_block + 1) * e->block_size;
+
+    if ((uint64_t) e->sb.blocks_count * e->block_size
+        > (uint64_t) e->dev->nblocks * BLOCK_SIZE) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static void free_fs(struct ext2_fs *e) {
+    kfree_sync(e->groups);
+    kfree_sync(e->block_bitmaps);
+    kfree_sync(e->inode_bitmaps);
+    kfree_sync(e->block_hint);
+    kfree_sync(e);
+}
+
+static int emount(struct fs_inst *fs) {
+    struct block_dev *dev = block_lookup(fs->file.inode.dev);
+    if (fs->file.inode.ftype != FT_SPECIAL || dev == NULL) {
+        return -ENODEV;
+    }
+
+    struct ext2_fs *e = kmalloc_sync(sizeof(struct ext2_fs));
+    if (e == NULL) {
+        return -ENOMEM;
+    }
+    memset(e, 0, sizeof(struct ext2_fs));
+    e->dev = dev;
+
+    int err = load_super(e);
+    if (err < 0) {
+        free_fs(e);
+        return err;
+    }
+
+    size_t glen = e->ngroups * sizeof(struct ext2_group);
+    e->groups = kmalloc_sync(glen);
+    e->block_bitmaps = kmalloc_sync(e->ngroups * sizeof(uint8_t *));
+    e->inode_bitmaps = kmalloc_sync(e->ngroups * sizeof(uint8_t *));
+    e->block_hint = kmalloc_sync(e->ngroups * sizeof(uint32_t));
+    if (e->groups == NULL || e->block_bitmaps == NULL
+        || e->inode_bitmaps == NULL || e->block_hint == NULL) {
+        free_fs(e);
+        return -ENOMEM;
+    }
+    memset(e->block_bitmaps, 0, e->ngroups * sizeof(uint8_t *));
+    memset(e->inode_bitmaps, 0, e->ngroups * sizeof(uint8_t *));
+    memset(e->block_hint, 0, e->ngroups * sizeof(uint32_t));
+
+    err = rw_bytes(e, e->gdt_off, e->groups, glen, false);
+    if (err < 0) {
+        free_fs(e);
+        return err;
+    }
+
+    fs->private_data = e;
+    return 0;
+}
+
+static int getroot(struct fs_inst *fs, struct inode *in) {
+    struct ext2_fs *e = fs->private_data;
+    struct ext2_inode raw;
+
+    acquire_lock(&(fs->lock));
+    int err = read_inode(e, ROOT_INO, &raw);
+    release_lock(&(fs->lock));
+    if (err < 0) {
+        return err;
+    }
+
+    ext2_to_inode(fs, ROOT_INO, &raw, in);
+    return 0;
+}
+
+static int lookup(struct inode *dir, const char *name, struct inode *in) {
+    if (dir->ftype != FT_DIR) {
+        return -ENOTDIR;
+    }
+    struct fs_inst *fs = dir->fs;
+    struct ext2_fs *e = fs->private_data;
+
+    acquire_lock(&(fs->lock));
+
+    struct ext2_inode raw;
+    int err = read_inode(e, dir->inode_id, &raw);
+    uint32_t ino = 0;
+    if (err == 0) {
+        ino = dir_find(e, dir->inode_id, &raw, name);
+        err = (ino == 0)? -ENOENT : read_inode(e, ino, &raw);
+    }
+
+    release_lock(&(fs->lock));
+    if (err < 0) {
+        return err;
+    }
+
+    ext2_to_inode(fs, ino, &raw, in);
+    // symlinks, fifos and sockets can't be opened yet
+    if (in->ftype == FT_LINK || in->ftype == FT_FIFO) {
+        return -ENOTSUP;
+    }
+    return 0;
+}
+
+static int check_name(const char *name) {
+    size_t len = strnlen(name, FILE_NAME_LEN);
+    if (len == 0 || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        return -EINVAL;
+    }
+    if (len > 255) {
+        return -ENAMETOOLONG;
+    }
+    return 0;
+}
+
+// creat truncates existing files, like open(O_CREAT|O_TRUNC)
+static int ecreat(struct inode *dir, const char *name) {
+    int err = check_name(name);
+    if (err < 0) {
+        return err;
+    }
+    struct fs_inst *fs = dir->fs;
+    struct ext2_fs *e = fs->private_data;
+    uint32_t dino = dir->inode_id;
+
+    acquire_lock(&(fs->lock));
+
+    struct ext2_inode draw, raw;
+    err = read_inode(e, dino, &draw);
+    if (err < 0) {
+        release_lock(&(fs->lock));
+        return err;
+    }
+
+    uint32_t ino = dir_find(e, dino, &draw, name);
+    if (ino != 0) {
+        err = read_inode(e, ino, &raw);
+        if (err == 0 && (raw.mode & S_IFMT) == S_IFDIR) {
+            err = -EISDIR;
+        } else if (err == 0) {
+            truncate(e, ino, &raw);
+        }
+    } else {
+        ino = alloc_inode(e, (dino - 1) / e->sb.inodes_per_group, false);
+        if (ino == 0) {
+            err = -ENOSPC;
+        } else {
+            memset(&raw, 0, sizeof(raw));
+            raw.mode = S_IFREG | 0644;
+            raw.links_count = 1;
+            err = write_inode(e, ino, &raw, true);
+            if (err < 0) {
+                free_inode(e, ino, false);
+            } else {
+                err = dir_add(e, dino, &draw, name, ino, FT_EXT2_REG);
+                if (err == -ENOSPC) {
+                    // dir_add found no room, so nothing points at it
+                    free_inode(e, ino, false);
+                }
+            }
+        }
+    }
+
+    release_lock(&(fs->lock));
+    return err;
+}
+
+static int emkdir(struct inode *dir, const char *name) {
+    int err = check_name(name);
+    if (err < 0) {
+        return err;
+    }
+    struct fs_inst *fs = dir->fs;
+    struct ext2_fs *e = fs->private_data;
+    uint32_t dino = dir->inode_id;
+
+    acquire_lock(&(fs->lock));
+
+    struct ext2_inode draw;
+    err = read_inode(e, dino, &draw);
+    if (err < 0) {
+        release_lock(&(fs->lock));
+        return err;
+    }
+    if (dir_find(e, dino, &draw, name) != 0) {
+        release_lock(&(fs->lock));
+        return -EEXIST;
+    }
+
+    // spread directories over the groups, the way mke2fs's lost+found and
+    // the linux driver do, so their files have room to stay close
+    uint32_t goal = (dino - 1) / e->sb.inodes_per_group + 1;
+    uint32_t ino = alloc_inode(e, goal, true);
+    uint32_t blk = (ino != 0)?
+                   alloc_block(e, (ino - 1) / e->sb.inodes_per_group) : 0;
+    if (blk == 0) {
+        if (ino != 0) {
+            free_inode(e, ino, true);
+        }
+        release_lock(&(fs->lock));
+        return -ENOSPC;
+    }
+
+    struct buffer *b;
+    char *data = get_block(e, blk, &b);
+    if (data == NULL) {
+        free_block(e, blk);
+        free_inode(e, ino, true);
+        release_lock(&(fs->lock));
+        return -EIO;
+    }
+    struct ext2_dirent *dot = (void *) data;
+    dot->inode = ino;
+    dot->rec_len = DIRENT_LEN(1);
+    dot->name_len = 1;
+    dot->file_type = e->filetype? FT_EXT2_DIR : 0;
+    dot->name[0] = '.';
+    struct ext2_dirent *dotdot = (void *) (data + dot->rec_len);
+    dotdot->inode = dino;
+    dotdot->rec_len = e->block_size - dot->rec_len;
+    dotdot->name_len = 2;
+    dotdot->file_type = e->filetype? FT_EXT2_DIR : 0;
+    dotdot->name[0] = '.';
+    dotdot->name[1] = '.';
+    bdirty(b);
+    brelse(b);
+
+    struct ext2_inode raw;
+    memset(&raw, 0, sizeof(raw));
+    raw.mode = S_IFDIR | 0755;
+    raw.links_count = 2;
+    raw.size = e->block_size;
+    raw.blocks = e->block_size / 512;
+    raw.block[0] = blk;
+    err = write_inode(e, ino, &raw, true);
+    if (err < 0) {
+        free_block(e, blk);
+        free_inode(e, ino, true);
+    } else {
+        // for the new ..
+        draw.links_count++;
+        err = dir_add(e, dino, &draw, name, ino, FT_EXT2_DIR);
+        if (err == -ENOSPC) {
+            // dir_add found no room, so nothing points at them
+            free_block(e, blk);
+            free_inode(e, ino, true);
+        }
+    }
+
+    release_lock(&(fs->lock));
+    return err;
+}
+
+static void estat(const struct inode *in, struct stat *st) {
+    struct ext2_inode raw;
+    struct ext2_fs *e = ext2_of(in);
+
+    acquire_lock(&(in->fs->lock));
+    if (read_inode(e, in->inode_id, &raw) == 0) {
+        st->st_size = (in->ftype == FT_REGULAR)? raw.size : 0;
+    }
+    release_lock(&(in->fs->lock));
+    st->st_blksize = e->block_size;
+}
+
+bool ext2_probe(struct inode *disk) {
+    if (disk->ftype != FT_SPECIAL) {
+        return false;
+    }
+    struct block_dev *dev = block_lookup(disk->dev);
+    if (dev == NULL) {
+        return false;
+    }
+
+    struct buffer *b = bread(dev, SUPER_OFF / BLOCK_SIZE);
+    if (b == NULL) {
+        return false;
+    }
+    const struct ext2_super *sb = (void *) (b->data + SUPER_OFF % BLOCK_SIZE);
+    bool ret = sb->magic == EXT2_MAGIC;
+    brelse(b);
+    return ret;
+}
+
+const struct inode_ops *get_ext2(void) {
+    static struct inode_ops iops;
+    iops = (struct inode_ops) {
+        .reg_ops = {
+            .open = eopen,
+            .lseek = elseek,
+            .read = eread,
+            .write = ewrite,
+            .getdent = egetdent,
+            .getdents = egetdents,
+            .mmap = emmap,
+        },
+        .mount = emount,
+        .getroot = getroot,
+        .lookup = lookup,
+        .creat = ecreat,
+        .mkdir = emkdir,
+        .stat = estat,
+    };
+    return &iops;
+}
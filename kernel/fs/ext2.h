@@ -0,0 +1,12 @@
+#ifndef FS_EXT2_H
+#define FS_EXT2_H
+
+#include "../fs.h"
+
+// mounted on a block device file
+const struct inode_ops *get_ext2(void);
+
+// whether the block device holds an ext2 filesystem
+bool ext2_probe(struct inode *disk);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef FS_PACKFMT_H
+#define FS_PACKFMT_H
+
+// the packed initrd format. written by initrd/mkpack on the host, and
+// mounted in place by packfs. everything is little endian, and offsets are
+// from the start of the image.
+//
+// the image starts with a pack_header, followed by the node table, the hash
+// buckets, the children array and the names. file contents come after
+// that. files of a page or more start on a page boundary, so they can be
+// mapped straight into a process.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PACK_MAGIC "PETIXPK"
+#define PACK_VERSION 1
+#define PACK_PAGE_SIZE 4096
+
+// end of a hash chain, or no parent
+#define PACK_NONE 0xffffffff
+
+enum pack_type {
+    PACK_DIR,
+    PACK_REGULAR,
+    PACK_SPECIAL,
+};
+
+struct pack_header {
+    char magic[8];         // PACK_MAGIC and a null
+    uint32_t version;
+    uint32_t image_size;
+    uint32_t nnodes;       // node 0 is the root
+    uint32_t nbuckets;     // a power of 2
+    uint32_t nodes_off;    // struct pack_node[nnodes]
+    uint32_t buckets_off;  // uint32_t[nbuckets], node indices
+    uint32_t children_off; // uint32_t[], node indices
+    uint32_t names_off;    // null terminated paths
+};
+
+struct pack_node {
+    uint32_t name;      // path offset in names, no leading or trailing '/'
+    uint32_t namelen;
+    uint32_t base;      // offset of the last component in the path
+    uint32_t hash;      // pack_hash of the path
+    uint32_t next;      // next node in the hash chain
+    uint32_t parent;
+    uint32_t type;      // enum pack_type
+    uint32_t exec;
+    uint32_t major;     // PACK_SPECIAL only
+    uint32_t minor;
+    uint32_t data;      // page aligned if size >= PACK_PAGE_SIZE
+    uint32_t size;
+    uint32_t children;  // index of the first child in the children array
+    uint32_t nchildren;
+};
+
+// fnv-1a
+static inline uint32_t pack_hash(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t) s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+#endif
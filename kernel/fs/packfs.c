@@ -0,0 +1,267 @@
+#include "packfs.h"
+#include "packfmt.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "../kmalloc.h"
+
+// the image is built on the host with its index already in it, and the
+// initrd is never freed, so mounting is just checking the header and the
+// tables. nothing here takes a lock.
+
+struct pack_inst {
+    const char *image;
+    const struct pack_header *hdr;
+    const struct pack_node *nodes;
+    const uint32_t *buckets;
+    const uint32_t *children;
+    const char *names;
+};
+
+#define MIN(a, b) (((a)<(b))? (a):(b))
+
+bool packfs_probe(const void *image, size_t len) {
+    const struct pack_header *hdr = image;
+    return len >= sizeof(struct pack_header)
+        && memcmp(hdr->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0;
+}
+
+// true if the table at off with n entries of size sz fits in the image
+static bool in_image(const struct pack_header *hdr, uint32_t off, uint32_t n,
+                     size_t sz) {
+    return off <= hdr->image_size
+        && n <= (hdr->image_size - off) / sz;
+}
+
+static bool valid_id(const struct pack_header *hdr, uint32_t id) {
+    return id == PACK_NONE || id < hdr->nnodes;
+}
+
+// every offset the lookups follow later, so a truncated or corrupt image
+// fails here rather than being read past
+static bool check_tables(const char *image, const struct pack_header *hdr) {
+    const struct pack_node *nodes = (const void *) (image + hdr->nodes_off);
+    const uint32_t *buckets = (const void *) (image + hdr->buckets_off);
+    const uint32_t *children = (const void *) (image + hdr->children_off);
+
+    for (uint32_t i = 0; i < hdr->nbuckets; ++i) {
+        if (!valid_id(hdr, buckets[i])) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < hdr->nnodes; ++i) {
+        if (children[i] >= hdr->nnodes) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < hdr->nnodes; ++i) {
+        const struct pack_node *n = &nodes[i];
+        // the name, and the null after it
+        if (n->name > hdr->image_size - hdr->names_off
+            || !in_image(hdr, hdr->names_off + n->name, n->namelen, 1)
+            || hdr->names_off + n->name + n->namelen == hdr->image_size
+            || image[hdr->names_off + n->name + n->namelen] != '\0'
+            || n->base > n->namelen) {
+            return false;
+        }
+        if (!valid_id(hdr, n->next) || !valid_id(hdr, n->parent)
+            || n->type > PACK_SPECIAL
+            || !in_image(hdr, n->data, n->size, 1)
+            || n->nchildren > hdr->nnodes
+            || n->children > hdr->nnodes - n->nchildren) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int pmount(struct fs_inst *fs) {
+    if (fs->file.fops->peek == NULL) {
+        return -ENODEV;
+    }
+
+    size_t len;
+    const char *image = fs->file.fops->peek(&(fs->file), 0, &len);
+    if (image == NULL || !packfs_probe(image, len)) {
+        return -EINVAL;
+    }
+
+    const struct pack_header *hdr = (const void *) image;
+    if (hdr->version != PACK_VERSION || hdr->image_size > len
+        || hdr->nnodes == 0 || hdr->nbuckets == 0
+        || (hdr->nbuckets & (hdr->nbuckets - 1)) != 0
+        || !in_image(hdr, hdr->nodes_off, hdr->nnodes,
+                     sizeof(struct pack_node))
+        || !in_image(hdr, hdr->buckets_off, hdr->nbuckets, sizeof(uint32_t))
+        || !in_image(hdr, hdr->children_off, hdr->nnodes, sizeof(uint32_t))
+        || hdr->names_off > hdr->image_size
+        || !check_tables(image, hdr)) {
+        return -EINVAL;
+    }
+
+    struct pack_inst *p = kmalloc_sync(sizeof(struct pack_inst));
+    p->image = image;
+    p->hdr = hdr;
+    p->nodes = (const void *) (image + hdr->nodes_off);
+    p->buckets = (const void *) (image + hdr->buckets_off);
+    p->children = (const void *) (image + hdr->children_off);
+    p->names = image + hdr->names_off;
+
+    fs->private_data = p;
+    return 0;
+}
+
+static void pack_inode(struct fs_inst *fs, uint32_t id, struct inode *in) {
+    struct pack_inst *p = fs->private_data;
+    const struct pack_node *n = &(p->nodes[id]);
+
+    memset(in, 0, sizeof(struct inode));
+    in->exec = n->exec != 0;
+    if (n->type == PACK_DIR) {
+        in->ftype = FT_DIR;
+    } else if (n->type == PACK_SPECIAL) {
+        in->ftype = FT_SPECIAL;
+        in->dev = MKDEV(n->major, n->minor);
+    } else {
+        in->ftype = FT_REGULAR;
+    }
+    in->size = n->size;
+    in->inode_id = id;
+    in->fs = fs;
+}
+
+static const char *pdata(struct file *f) {
+    struct pack_inst *p = f->inode.fs->private_data;
+    return p->image + f->private_data;
+}
+
+static int popen(struct inode *in, struct file *f, int flags) {
+    struct pack_inst *p = in->fs->private_data;
+    f->size = p->nodes[in->inode_id].size;
+    f->private_data = p->nodes[in->inode_id].data;
+    return 0;
+}
+
+static ssize_t pread(struct file *f, char *buf, size_t n) {
+    if (f->offset >= f->size) {
+        return 0;
+    }
+
+    size_t len = MIN(f->size - f->offset, n);
+    memcpy(buf, pdata(f) + f->offset, len);
+    f->offset += len;
+    return len;
+}
+
+static const char *ppeek(struct file *f, off_t off, size_t *len) {
+    if (off < 0 || off >= f->size) {
+        *len = 0;
+        return NULL;
+    }
+
+    *len = f->size - off;
+    return pdata(f) + off;
+}
+
+static void *pmmap(struct file *f, void *addr, size_t len, int prot,
+                   int flags, off_t off, int *errno) {
+    return fs_mmap_image(f, pdata(f), addr, len, prot, flags, off, errno);
+}
+
+static int pgetdent(struct file *f, struct petix_dirent *d) {
+    if (f->inode.ftype != FT_DIR) {
+        return -ENOTDIR;
+    }
+
+    struct pack_inst *p = f->inode.fs->private_data;
+    const struct pack_node *dir = &(p->nodes[f->inode.inode_id]);
+    if (f->offset >= dir->nchildren) {
+        d->present = false;
+        return 0;
+    }
+
+    const struct pack_node *child =
+        &(p->nodes[p->children[dir->children + f->offset]]);
+    d->inode_id = p->children[dir->children + f->offset];
+    d->present = true;
+    strncpy(d->name, p->names + child->name + child->base, sizeof(d->name));
+
+    f->offset++;
+    return 0;
+}
+
+static ssize_t pgetdents(struct file *f, char *buf, size_t len) {
+    if (f->inode.ftype != FT_DIR) {
+        return -ENOTDIR;
+    }
+
+    struct pack_inst *p = f->inode.fs->private_data;
+    const struct pack_node *dir = &(p->nodes[f->inode.inode_id]);
+
+    size_t used = 0;
+    for (; f->offset < dir->nchildren; f->offset++) {
+        uint32_t id = p->children[dir->children + f->offset];
+        const struct pack_node *child = &(p->nodes[id]);
+
+        struct inode in;
+        pack_inode(f->inode.fs, id, &in);
+
+        size_t reclen = fs_put_dirent(buf + used, len - used,
+                                      p->names + child->name + child->base,
+                                      &in);
+        if (reclen == 0) {
+            // not even one entry fits
+            return (used == 0)? -EINVAL : (ssize_t) used;
+        }
+        used += reclen;
+    }
+
+    return used;
+}
+
+static int getroot(struct fs_inst *fs, struct inode *in) {
+    pack_inode(fs, 0, in);
+    return 0;
+}
+
+static int lookup_all(struct fs_inst *fs, const char *path, struct inode *in) {
+    struct pack_inst *p = fs->private_data;
+
+    size_t len = strnlen(path, PATH_MAX);
+    while (len > 0 && path[len - 1] == '/') {
+        --len;
+    }
+
+    uint32_t h = pack_hash(path, len);
+    for (uint32_t id = p->buckets[h & (p->hdr->nbuckets - 1)];
+         id != PACK_NONE; id = p->nodes[id].next) {
+        const struct pack_node *n = &(p->nodes[id]);
+        if (n->hash == h && n->namelen == len
+            && strncmp(p->names + n->name, path, len) == 0) {
+            pack_inode(fs, id, in);
+            return 0;
+        }
+    }
+
+    return -ENOENT;
+}
+
+const struct inode_ops *get_packfs(void) {
+    static struct inode_ops iops;
+    iops = (struct inode_ops) {
+        .reg_ops = {
+            .open = popen,
+            .lseek = fs_default_lseek,
+            .read = pread,
+            .getdent = pgetdent,
+            .getdents = pgetdents,
+            .mmap = pmmap,
+            .peek = ppeek,
+        },
+        .mount = pmount,
+        .getroot = getroot,
+        .lookup_all = lookup_all
+    };
+    return &iops;
+}
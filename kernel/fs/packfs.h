@@ -0,0 +1,12 @@
+#ifndef FS_PACKFS_H
+#define FS_PACKFS_H
+
+#include "../fs.h"
+#include <stdbool.h>
+
+// true if image is a packed initrd (see packfmt.h) rather than a tar
+bool packfs_probe(const void *image, size_t len);
+
+const struct inode_ops *get_packfs(void);
+
+#endif
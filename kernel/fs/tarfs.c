@@ -5,9 +5,13 @@
 #include <string.h>
 #include "../kdebug.h"
 #include "../sync.h"
+#include "../kmalloc.h"
+#include <sys/mman.h>
 
 #define ID_ROOT 0xffffffff
 
+static int getroot(struct fs_inst *fs, struct inode *in);
+
 static int topen(struct inode *in, struct file *f, int flags) {
     f->size = in->size;
     if (in->inode_id == ID_ROOT) {
@@ -18,75 +22,325 @@ static int topen(struct inode *in, struct file *f, int flags) {
     return 0;
 }
 
+// converts a header to an inode. returns -1 for types we don't support
+static int tar_inode(struct fs_inst *fs, const struct tar *tar, size_t blk,
+                     struct inode *in) {
+    in->exec = (tar_field(tar->mode) & 0111) != 0;
+    if (tar->typeflag == REGTYPE || tar->typeflag == AREGTYPE) {
+        in->ftype = FT_REGULAR;
+    } else if (tar->typeflag == DIRTYPE) {
+        in->ftype = FT_DIR;
+    } else if (tar->typeflag == CHRTYPE || tar->typeflag == BLKTYPE) {
+        in->ftype = FT_SPECIAL;
+        in->dev = MKDEV(tar_field(tar->devmajor),
+                        tar_field(tar->devminor));
+    } else {
+        return -1;
+    }
+    in->size = tar_field(tar->size);
+    in->inode_id = blk;
+    in->fs = fs;
+    return 0;
+}
+
+// the archive is parsed once at mount into a hash of paths, and each
+// directory gets an array of its children. after that it is read-only, so
+// lookups don't need fs->lock.
+
+struct tar_node {
+    char *name;     // as in the archive, directories end in '/'
+    size_t namelen; // without the trailing '/'
+    const char *base; // last component of name
+    uint32_t hash;
+    struct inode in;
+    struct tar_node *parent; // NULL if it isn't in the archive
+    struct tar_node *next;   // hash chain
+    struct tar_node **children; // in archive order
+    size_t nchildren;
+};
+
+struct tar_index {
+    // the whole archive, if the device lets us see it. the initrd is never
+    // freed, so file data can be read and mapped straight from here.
+    const char *image;
+    size_t image_len;
+    struct tar_node root;
+    struct tar_node *nodes; // in archive order, so sorted by inode_id
+    size_t nnodes;
+    struct tar_node **buckets;
+    size_t nbuckets; // a power of 2
+};
+
+// fnv-1a
+static uint32_t path_hash(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t) s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static struct tar_node *index_find(struct tar_index *idx, const char *path,
+                                   size_t len) {
+    uint32_t h = path_hash(path, len);
+    for (struct tar_node *n = idx->buckets[h & (idx->nbuckets - 1)];
+         n != NULL; n = n->next) {
+        if (n->hash == h && n->namelen == len
+            && strncmp(n->name, path, len) == 0) {
+            return n;
+        }
+    }
+    return NULL;
+}
+
+static struct tar_node *index_node(struct tar_index *idx, size_t inode_id) {
+    if (inode_id == ID_ROOT) {
+        return &(idx->root);
+    }
+
+    size_t lo = 0, hi = idx->nnodes;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        if (idx->nodes[mid].in.inode_id == inode_id) {
+            return &(idx->nodes[mid]);
+        } else if (idx->nodes[mid].in.inode_id < inode_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+static void index_add_child(struct tar_node *dir, struct tar_node *child) {
+    // counted in advance, see build_index
+    dir->children[dir->nchildren++] = child;
+}
+
+static int build_index(struct fs_inst *fs) {
+    struct tar_index *idx = kmalloc_sync(sizeof(struct tar_index));
+    memset(idx, 0, sizeof(struct tar_index));
+    getroot(fs, &(idx->root.in));
+    idx->root.name = "";
+
+    if (fs->file.fops->peek != NULL) {
+        idx->image = fs->file.fops->peek(&(fs->file), 0, &(idx->image_len));
+    }
+
+    char buf[TAR_BLOCKSIZE];
+    struct tar *const tar = (void *) buf;
+
+    // one pass over the headers
+    size_t cap = 0;
+    for (size_t blk = 0;; blk = tar_next_blk(tar, blk)) {
+        fs->file.fops->lseek(&(fs->file), blk*TAR_BLOCKSIZE, SEEK_SET);
+        ssize_t ret = fs->file.fops->read(&(fs->file), buf, TAR_BLOCKSIZE);
+        if (ret < TAR_BLOCKSIZE || tar->name[0] == '\0') {
+            break;
+        }
+
+        struct inode in;
+        if (tar_inode(fs, tar, blk, &in) < 0) {
+            continue;
+        }
+
+        if (idx->nnodes == cap) {
+            cap = (cap == 0)? 64 : cap*2;
+            idx->nodes = krealloc_sync(idx->nodes,
+                                       cap * sizeof(struct tar_node));
+        }
+
+        struct tar_node *n = &(idx->nodes[idx->nnodes++]);
+        memset(n, 0, sizeof(struct tar_node));
+
+        size_t len = strnlen(tar->name, sizeof(tar->name));
+        n->name = kmalloc_sync(len + 1);
+        memcpy(n->name, tar->name, len);
+        n->name[len] = '\0';
+
+        n->namelen = len;
+        while (n->namelen > 0 && n->name[n->namelen - 1] == '/') {
+            n->namelen--;
+        }
+        n->in = in;
+    }
+
+    idx->nbuckets = 16;
+    while (idx->nbuckets < idx->nnodes * 2) {
+        idx->nbuckets *= 2;
+    }
+    idx->buckets = kmalloc_sync(idx->nbuckets * sizeof(struct tar_node *));
+    memset(idx->buckets, 0, idx->nbuckets * sizeof(struct tar_node *));
+
+    for (size_t i = 0; i < idx->nnodes; ++i) {
+        struct tar_node *n = &(idx->nodes[i]);
+        n->hash = path_hash(n->name, n->namelen);
+
+        size_t b = n->hash & (idx->nbuckets - 1);
+        n->next = idx->buckets[b];
+        idx->buckets[b] = n;
+    }
+
+    // find parents and count children, then fill the child arrays
+    for (size_t i = 0; i < idx->nnodes; ++i) {
+        struct tar_node *n = &(idx->nodes[i]);
+
+        size_t plen = n->namelen;
+        while (plen > 0 && n->name[plen - 1] != '/') {
+            --plen;
+        }
+        n->base = n->name + plen;
+
+        if (plen == 0) {
+            n->parent = &(idx->root);
+        } else {
+            n->parent = index_find(idx, n->name, plen - 1);
+        }
+
+        // orphans can still be looked up, but aren't listed anywhere
+        if (n->parent != NULL && n->parent->in.ftype == FT_DIR) {
+            n->parent->nchildren++;
+        } else {
+            n->parent = NULL;
+        }
+    }
+
+    idx->root.children =
+        kmalloc_sync(idx->root.nchildren * sizeof(struct tar_node *));
+    idx->root.nchildren = 0;
+    for (size_t i = 0; i < idx->nnodes; ++i) {
+        struct tar_node *n = &(idx->nodes[i]);
+        if (n->in.ftype == FT_DIR) {
+            n->children = kmalloc_sync(n->nchildren * sizeof(struct tar_node *));
+            n->nchildren = 0;
+        }
+    }
+    for (size_t i = 0; i < idx->nnodes; ++i) {
+        struct tar_node *n = &(idx->nodes[i]);
+        if (n->parent != NULL) {
+            index_add_child(n->parent, n);
+        }
+    }
+
+    fs->private_data = idx;
+    return 0;
+}
+
+static int tmount(struct fs_inst *fs) {
+    return build_index(fs);
+}
+
 #define MIN(a, b) (((a)<(b))? (a):(b))
 
-static ssize_t tread(struct file *f, char *buf, size_t n) {
-    size_t len = MIN(f->size - f->offset, n);
+// file data in the image, or NULL if there is no image
+static const char *tdata(struct file *f) {
+    struct tar_index *idx = f->inode.fs->private_data;
+    if (idx->image == NULL || f->private_data + f->size > idx->image_len) {
+        return NULL;
+    }
+    return idx->image + f->private_data;
+}
 
+// without an image, reads go through the device's seek state
+static ssize_t tread_locked(struct file *f, char *buf, size_t len) {
     off_t off = f->private_data + f->offset;
 
     acquire_lock(&(f->inode.fs->lock));
     f->inode.fs->file.fops->lseek(&(f->inode.fs->file), off, SEEK_SET);
     int ret = f->inode.fs->file.fops->read(&(f->inode.fs->file), buf, len);
+    release_lock(&(f->inode.fs->lock));
+
     if (ret > 0) {
         f->offset += ret;
     }
-    release_lock(&(f->inode.fs->lock));
-
     return ret;
 }
 
-int getdent(struct file *f, struct petix_dirent *d) {
-    if (f->inode.ftype != FT_DIR) {
-        return -ENOTDIR;
+static ssize_t tread(struct file *f, char *buf, size_t n) {
+    if (f->offset >= f->size) {
+        return 0;
     }
 
-    acquire_lock(&(f->inode.fs->lock));
+    size_t len = MIN(f->size - f->offset, n);
 
-    char name[100];
-    if (f->inode.inode_id == ID_ROOT) {
-        name[0] = 0;
-    } else {
-        off_t off = f->private_data - TAR_BLOCKSIZE;
+    const char *data = tdata(f);
+    if (data == NULL) {
+        return tread_locked(f, buf, len);
+    }
+
+    memcpy(buf, data + f->offset, len);
+    f->offset += len;
+    return len;
+}
 
-        f->inode.fs->file.fops->lseek(&(f->inode.fs->file), off, SEEK_SET);
-        f->inode.fs->file.fops->read(&(f->inode.fs->file), name, sizeof(name));
+static const char *tpeek(struct file *f, off_t off, size_t *len) {
+    const char *data = tdata(f);
+    if (off < 0 || off >= f->size || data == NULL) {
+        *len = 0;
+        return NULL;
     }
 
-    char buf[TAR_BLOCKSIZE];
+    *len = f->size - off;
+    return data + off;
+}
 
-    struct tar *const tar = (void *) buf;
+static void *tmmap(struct file *f, void *addr, size_t len, int prot,
+                   int flags, off_t off, int *errno) {
+    const char *data = tdata(f);
+    if (data == NULL) {
+        *errno = ENODEV;
+        return MAP_FAILED;
+    }
+    return fs_mmap_image(f, data, addr, len, prot, flags, off, errno);
+}
+
+int getdent(struct file *f, struct petix_dirent *d) {
+    if (f->inode.ftype != FT_DIR) {
+        return -ENOTDIR;
+    }
 
-    size_t initblk = (f->private_data + f->offset)/TAR_BLOCKSIZE;
-    for (size_t blk = initblk;; blk = tar_next_blk(tar, blk)) {
-        f->inode.fs->file.fops->lseek(&(f->inode.fs->file),
-                                      blk*TAR_BLOCKSIZE, SEEK_SET);
-        f->inode.fs->file.fops->read(&(f->inode.fs->file), buf, TAR_BLOCKSIZE);
+    struct tar_node *dir = index_node(f->inode.fs->private_data,
+                                      f->inode.inode_id);
+    if (dir == NULL || f->offset >= dir->nchildren) {
+        d->present = false;
+        return 0;
+    }
 
-        f->offset = blk*TAR_BLOCKSIZE;
+    struct tar_node *child = dir->children[f->offset];
+    d->inode_id = child->in.inode_id;
+    d->present = true;
+    strncpy(d->name, child->base, sizeof(d->name));
 
-        size_t prefix_len = strnlen(name, sizeof(name));
+    f->offset++;
+    return 0;
+}
 
-        if (tar->name[0] == '\0' || strncmp(tar->name, name, prefix_len) != 0) {
-            d->present = false;
-            release_lock(&(f->inode.fs->lock));
-            return 0;
-        }
+static ssize_t getdents(struct file *f, char *buf, size_t len) {
+    if (f->inode.ftype != FT_DIR) {
+        return -ENOTDIR;
+    }
 
-        char * s = strchr(tar->name + prefix_len, '/');
-        if (s == NULL || (s[0] == '/' && s[1] == '\0')) {
-            d->inode_id = blk;
-            d->present = true;
-            strncpy(d->name, tar->name + prefix_len, sizeof(name));
+    struct tar_node *dir = index_node(f->inode.fs->private_data,
+                                      f->inode.inode_id);
+    if (dir == NULL) {
+        return 0;
+    }
 
-            blk = tar_next_blk(tar, blk);
-            f->offset = blk*TAR_BLOCKSIZE - f->private_data;
+    size_t used = 0;
+    for (; f->offset < dir->nchildren; f->offset++) {
+        struct tar_node *child = dir->children[f->offset];
 
-            release_lock(&(f->inode.fs->lock));
-            return 0;
+        size_t reclen = fs_put_dirent(buf + used, len - used, child->base,
+                                      &(child->in));
+        if (reclen == 0) {
+            // not even one entry fits
+            return (used == 0)? -EINVAL : (ssize_t) used;
         }
+        used += reclen;
     }
-    panic("unreachable code");
+
+    return used;
 }
 
 
@@ -100,48 +354,17 @@ static int getroot(struct fs_inst *fs, struct inode *in) {
 }
 
 static int lookup_all(struct fs_inst *fs, const char *path, struct inode *in) {
-    char buf[TAR_BLOCKSIZE];
-
-    acquire_lock(&(fs->lock));
-
-    struct tar *const tar = (void *) buf;
-
-    for (size_t blk = 0;; blk = tar_next_blk(tar, blk)) {
-        fs->file.fops->lseek(&(fs->file), blk*TAR_BLOCKSIZE, SEEK_SET);
-        fs->file.fops->read(&(fs->file), buf, TAR_BLOCKSIZE);
-
-        if (tar->name[0] == 0) {
-            release_lock(&(fs->lock));
-            return -ENOENT;
-        }
+    size_t len = strnlen(path, PATH_MAX);
+    while (len > 0 && path[len - 1] == '/') {
+        --len;
+    }
 
-        size_t pathlen = strnlen(path, 100);
-        if (strncmp(tar->name, path, 100) == 0 ||
-            (strncmp(tar->name, path, pathlen) == 0
-             && tar->name[pathlen] == '/'
-             && tar->name[pathlen+1] == '\0')) {
-
-            in->exec = (tar_field(tar->mode) & 0111) != 0;
-            if (tar->typeflag == REGTYPE) {
-                in->ftype = FT_REGULAR;
-            } else if (tar->typeflag == DIRTYPE) {
-                in->ftype = FT_DIR;
-            } else if (tar->typeflag == CHRTYPE || tar->typeflag == BLKTYPE) {
-                in->ftype = FT_SPECIAL;
-                in->dev = MKDEV(tar_field(tar->devmajor),
-                                tar_field(tar->devminor));
-            } else {
-                panic("unsupported tar file type");
-            }
-            in->size = tar_field(tar->size);
-            in->inode_id = blk;
-            in->fs = fs;
-
-            release_lock(&(fs->lock));
-            return 0;
-        }
+    struct tar_node *n = index_find(fs->private_data, path, len);
+    if (n == NULL) {
+        return -ENOENT;
     }
-    panic("unreachable code reached");
+
+    *in = n->in;
     return 0;
 }
 
@@ -152,8 +375,12 @@ const struct inode_ops *get_tarfs(void) {
             .open = topen,
             .lseek = fs_default_lseek,
             .read = tread,
-            .getdent = getdent
+            .getdent = getdent,
+            .getdents = getdents,
+            .mmap = tmmap,
+            .peek = tpeek,
         },
+        .mount = tmount,
         .getroot = getroot,
         .lookup_all = lookup_all
     };
@@ -0,0 +1,509 @@
+#include "tmpfs.h"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../kmalloc.h"
+#include "../dcache.h"
+#include "../mem.h"
+#include "../proc.h"
+#include "../arch/paging.h"
+
+// everything lives in memory. inode ids are node pointers, and nodes are
+// never freed (there is no unlink), so they stay valid for the dcache.
+//
+// file data is a radix tree of pages: each interior node is a page of 1024
+// pointers, so two levels cover 4G. missing pages are holes and read as
+// zeros. directories keep their entries in creation order for readdir,
+// plus a hash of them for lookups.
+//
+// fs->lock covers everything in the fs.
+
+#define RADIX_BITS 10
+#define RADIX_FANOUT (1 << RADIX_BITS)
+#define RADIX_MAX_HEIGHT 2
+#define TMP_MAX_SIZE ((off_t) PAGE_SIZE << (RADIX_BITS * RADIX_MAX_HEIGHT))
+
+struct tmp_node {
+    char *name;
+    uint32_t hash;
+    bool dir;
+    bool exec;
+    bool mapped; // pages may be in an address space, so never free them
+    size_t size;
+
+    // regular files
+    void **pages;
+    int height;
+
+    // directories
+    struct tmp_node **entries;
+    size_t nentries;
+    size_t cap;
+    struct tmp_node **buckets;
+    size_t nbuckets; // a power of 2, or 0
+    struct tmp_node *hnext;
+};
+
+#define MIN(a, b) (((a)<(b))? (a):(b))
+
+static void *zeroed_page(void) {
+    void *page = alloc_page_ptr_sync();
+    memset(page, 0, PAGE_SIZE);
+    return page;
+}
+
+static size_t radix_pages(int height) {
+    return (height == 0)? 0 : (size_t) 1 << (RADIX_BITS * height);
+}
+
+// returns the page holding page number pgno, or NULL for a hole. with
+// alloc, holes are filled and the tree grows as needed. NULL then means
+// the file would be too big.
+static void *radix_page(struct tmp_node *n, size_t pgno, bool alloc) {
+    while (pgno >= radix_pages(n->height)) {
+        if (!alloc || n->height == RADIX_MAX_HEIGHT) {
+            return NULL;
+        }
+
+        void **root = zeroed_page();
+        root[0] = n->pages;
+        n->pages = root;
+        n->height++;
+    }
+
+    void **slots = n->pages;
+    for (int level = n->height; level > 0; --level) {
+        size_t idx = (pgno >> (RADIX_BITS * (level - 1))) & (RADIX_FANOUT-1);
+        if (slots[idx] == NULL) {
+            if (!alloc) {
+                return NULL;
+            }
+            slots[idx] = zeroed_page();
+        }
+        slots = slots[idx];
+    }
+    return slots;
+}
+
+// frees (or with keep, zeroes) every page below slots
+static void radix_clear(void **slots, int level, bool keep) {
+    if (slots == NULL) {
+        return;
+    }
+
+    if (level == 0) {
+        if (keep) {
+            memset(slots, 0, PAGE_SIZE);
+        } else {
+            free_page_ptr_sync(slots);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < RADIX_FANOUT; ++i) {
+        radix_clear(slots[i], level - 1, keep);
+    }
+    if (!keep) {
+        free_page_ptr_sync(slots);
+    }
+}
+
+static void truncate(struct tmp_node *n) {
+    // mapped pages can't go away under the process using them
+    radix_clear(n->pages, n->height, n->mapped);
+    if (!n->mapped) {
+        n->pages = NULL;
+        n->height = 0;
+    }
+    n->size = 0;
+}
+
+// fnv-1a
+static uint32_t name_hash(const char *name, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t) name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static struct tmp_node *new_node(const char *name, size_t len, bool dir) {
+    struct tmp_node *n = kmalloc_sync(sizeof(struct tmp_node));
+    memset(n, 0, sizeof(struct tmp_node));
+
+    n->name = kmalloc_sync(len + 1);
+    memcpy(n->name, name, len);
+    n->name[len] = '\0';
+    n->hash = name_hash(name, len);
+
+    n->dir = dir;
+    n->exec = dir;
+    return n;
+}
+
+static struct tmp_node *dir_find(struct tmp_node *dir, const char *name) {
+    if (dir->nbuckets == 0) {
+        return NULL;
+    }
+
+    uint32_t h = name_hash(name, strlen(name));
+    struct tmp_node *n = dir->buckets[h & (dir->nbuckets - 1)];
+    for (; n != NULL; n = n->hnext) {
+        if (n->hash == h && strcmp(n->name, name) == 0) {
+            break;
+        }
+    }
+    return n;
+}
+
+static void dir_add(struct tmp_node *dir, struct tmp_node *n) {
+    if (dir->nentries == dir->cap) {
+        dir->cap = (dir->cap == 0)? 8 : dir->cap*2;
+        dir->entries = krealloc_sync(dir->entries,
+                                     dir->cap * sizeof(struct tmp_node *));
+    }
+    dir->entries[dir->nentries++] = n;
+
+    // keep the load factor under 1
+    if (dir->nentries > dir->nbuckets) {
+        kfree_sync(dir->buckets);
+        dir->nbuckets = (dir->nbuckets == 0)? 8 : dir->nbuckets*2;
+        dir->buckets = kmalloc_sync(dir->nbuckets * sizeof(struct tmp_node *));
+        memset(dir->buckets, 0, dir->nbuckets * sizeof(struct tmp_node *));
+
+        for (size_t i = 0; i < dir->nentries - 1; ++i) {
+            struct tmp_node *e = dir->entries[i];
+            size_t b = e->hash & (dir->nbuckets - 1);
+            e->hnext = dir->buckets[b];
+            dir->buckets[b] = e;
+        }
+    }
+
+    size_t b = n->hash & (dir->nbuckets - 1);
+    n->hnext = dir->buckets[b];
+    dir->buckets[b] = n;
+}
+
+static struct tmp_node *node_of(const struct inode *in) {
+    return (struct tmp_node *) in->inode_id;
+}
+
+static void tmp_inode(struct fs_inst *fs, struct tmp_node *n,
+                      struct inode *in) {
+    memset(in, 0, sizeof(struct inode));
+    in->exec = n->exec;
+    in->ftype = n->dir? FT_DIR : FT_REGULAR;
+    in->size = n->size;
+    in->inode_id = (size_t) n;
+    in->fs = fs;
+}
+
+static int topen(struct inode *in, struct file *f, int flags) {
+    f->size = node_of(in)->size;
+    return 0;
+}
+
+static off_t tlseek(struct file *f, off_t off, int whence) {
+    // for SEEK_END
+    f->size = node_of(&(f->inode))->size;
+    return fs_default_lseek(f, off, whence);
+}
+
+static ssize_t tread(struct file *f, char *buf, size_t len) {
+    struct tmp_node *n = node_of(&(f->inode));
+    if (n->dir) {
+        return -EISDIR;
+    }
+
+    acquire_lock(&(f->inode.fs->lock));
+
+    size_t done = 0;
+    while (done < len && f->offset < (off_t) n->size) {
+        size_t pgoff = f->offset % PAGE_SIZE;
+        size_t chunk = MIN(PAGE_SIZE - pgoff, len - done);
+        chunk = MIN(chunk, n->size - f->offset);
+
+        const char *page = radix_page(n, f->offset / PAGE_SIZE, false);
+        if (page == NULL) {
+            memset(buf + done, 0, chunk);
+        } else {
+            memcpy(buf + done, page + pgoff, chunk);
+        }
+
+        done += chunk;
+        f->offset += chunk;
+    }
+
+    f->size = n->size;
+    release_lock(&(f->inode.fs->lock));
+    return done;
+}
+
+static ssize_t twrite(struct file *f, const char *buf, size_t len) {
+    struct tmp_node *n = node_of(&(f->inode));
+    if (n->dir) {
+        return -EISDIR;
+    }
+
+    acquire_lock(&(f->inode.fs->lock));
+
+    size_t done = 0;
+    while (done < len && f->offset < TMP_MAX_SIZE - 1) {
+        size_t pgoff = f->offset % PAGE_SIZE;
+        size_t chunk = MIN(PAGE_SIZE - pgoff, len - done);
+        chunk = MIN(chunk, TMP_MAX_SIZE - 1 - f->offset);
+
+        char *page = radix_page(n, f->offset / PAGE_SIZE, true);
+        memcpy(page + pgoff, buf + done, chunk);
+
+        done += chunk;
+        f->offset += chunk;
+        if ((off_t) n->size < f->offset) {
+            n->size = f->offset;
+        }
+    }
+
+    bool resized = f->size != (off_t) n->size;
+    f->size = n->size;
+    struct inode in;
+    tmp_inode(f->inode.fs, n, &in);
+    release_lock(&(f->inode.fs->lock));
+
+    if (resized) {
+        dcache_update(&in);
+    }
+
+    if (done == 0 && len > 0) {
+        return -EFBIG;
+    }
+    return done;
+}
+
+// shared mappings use the file's own pages, filling holes first. private
+// ones get a copy
+static void *tmmap(struct file *f, void *addr, size_t len, int prot,
+                   int flags, off_t off, int *errno) {
+    struct tmp_node *n = node_of(&(f->inode));
+    if (n->dir) {
+        *errno = EACCES;
+        return MAP_FAILED;
+    }
+
+    char *caddr = addr;
+    if (caddr < (char *) PROC_REGION
+        || len > (size_t) (USER_STACK_TOP - caddr)) {
+        *errno = EINVAL;
+        return MAP_FAILED;
+    }
+
+    if (off < 0 || (off & (PAGE_SIZE-1))
+        || off + (off_t) len > TMP_MAX_SIZE) {
+        *errno = EINVAL;
+        return MAP_FAILED;
+    }
+
+    bool private = (flags & MAP_PRIVATE) != 0;
+    struct pcb *pcb = get_pcb(get_pid());
+
+    // drop earlier mappings first, so copies don't land in them
+    for (size_t i = 0; i < len; i += PAGE_SIZE) {
+        unmap_page_user(pcb->addr_space, caddr+i);
+    }
+    flush_tlb();
+
+    acquire_lock(&(f->inode.fs->lock));
+
+    for (size_t i = 0; i < len; i += PAGE_SIZE) {
+        size_t pgno = (off + i) / PAGE_SIZE;
+
+        if (private) {
+            const char *page = radix_page(n, pgno, false);
+            if (page == NULL) {
+                memset(caddr+i, 0, PAGE_SIZE);
+            } else {
+                memcpy(caddr+i, page, PAGE_SIZE);
+            }
+            continue;
+        }
+
+        char *page = radix_page(n, pgno, true);
+        n->mapped = true;
+
+        int err;
+        if (prot & PROT_WRITE) {
+            err = remap_page_user(pcb->addr_space, caddr+i, page);
+        } else {
+            err = remap_page_user_ro(pcb->addr_space, caddr+i, page);
+        }
+        if (err == -1) {
+            release_lock(&(f->inode.fs->lock));
+            *errno = EFAULT;
+            return MAP_FAILED;
+        }
+    }
+
+    release_lock(&(f->inode.fs->lock));
+    flush_tlb();
+
+    return addr;
+}
+
+static int tgetdent(struct file *f, struct petix_dirent *d) {
+    struct tmp_node *dir = node_of(&(f->inode));
+    if (!dir->dir) {
+        return -ENOTDIR;
+    }
+
+    acquire_lock(&(f->inode.fs->lock));
+    if (f->offset >= (off_t) dir->nentries) {
+        d->present = false;
+    } else {
+        struct tmp_node *child = dir->entries[f->offset];
+        d->inode_id = (size_t) child;
+        d->present = true;
+        strncpy(d->name, child->name, sizeof(d->name));
+        f->offset++;
+    }
+    release_lock(&(f->inode.fs->lock));
+    return 0;
+}
+
+static ssize_t tgetdents(struct file *f, char *buf, size_t len) {
+    struct tmp_node *dir = node_of(&(f->inode));
+    if (!dir->dir) {
+        return -ENOTDIR;
+    }
+
+    acquire_lock(&(f->inode.fs->lock));
+
+    size_t used = 0;
+    for (; f->offset < (off_t) dir->nentries; f->offset++) {
+        struct tmp_node *child = dir->entries[f->offset];
+
+        struct inode in;
+        tmp_inode(f->inode.fs, child, &in);
+
+        size_t reclen = fs_put_dirent(buf + used, len - used, child->name,
+                                      &in);
+        if (reclen == 0) {
+            break;
+        }
+        used += reclen;
+    }
+
+    release_lock(&(f->inode.fs->lock));
+
+    // not even one entry fits
+    if (used == 0 && f->offset < (off_t) dir->nentries) {
+        return -EINVAL;
+    }
+    return used;
+}
+
+static int tmount(struct fs_inst *fs) {
+    fs->private_data = new_node("", 0, true);
+    return 0;
+}
+
+static int getroot(struct fs_inst *fs, struct inode *in) {
+    tmp_inode(fs, fs->private_data, in);
+    return 0;
+}
+
+static int lookup(struct inode *dir, const char *name, struct inode *in) {
+    struct fs_inst *fs = dir->fs;
+    if (!node_of(dir)->dir) {
+        return -ENOTDIR;
+    }
+
+    acquire_lock(&(fs->lock));
+    struct tmp_node *n = dir_find(node_of(dir), name);
+    if (n != NULL) {
+        tmp_inode(fs, n, in);
+    }
+    release_lock(&(fs->lock));
+
+    return (n == NULL)? -ENOENT : 0;
+}
+
+static int check_name(const char *name) {
+    size_t len = strnlen(name, FILE_NAME_LEN);
+    if (len == 0 || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        return -EINVAL;
+    }
+    if (len == FILE_NAME_LEN) {
+        return -ENAMETOOLONG;
+    }
+    return 0;
+}
+
+// creat truncates existing files, like open(O_CREAT|O_TRUNC)
+static int tcreat(struct inode *dir, const char *name) {
+    int err = check_name(name);
+    if (err < 0) {
+        return err;
+    }
+
+    struct fs_inst *fs = dir->fs;
+    acquire_lock(&(fs->lock));
+
+    struct tmp_node *n = dir_find(node_of(dir), name);
+    if (n != NULL && n->dir) {
+        err = -EISDIR;
+    } else if (n != NULL) {
+        truncate(n);
+    } else {
+        dir_add(node_of(dir), new_node(name, strlen(name), false));
+    }
+
+    release_lock(&(fs->lock));
+    return err;
+}
+
+static int tmkdir(struct inode *dir, const char *name) {
+    int err = check_name(name);
+    if (err < 0) {
+        return err;
+    }
+
+    struct fs_inst *fs = dir->fs;
+    acquire_lock(&(fs->lock));
+
+    if (dir_find(node_of(dir), name) != NULL) {
+        err = -EEXIST;
+    } else {
+        dir_add(node_of(dir), new_node(name, strlen(name), true));
+    }
+
+    release_lock(&(fs->lock));
+    return err;
+}
+
+static void tstat(const struct inode *in, struct stat *st) {
+    struct tmp_node *n = node_of(in);
+    st->st_size = n->dir? 0 : n->size;
+}
+
+const struct inode_ops *get_tmpfs(void) {
+    static struct inode_ops iops;
+    iops = (struct inode_ops) {
+        .reg_ops = {
+            .open = topen,
+            .lseek = tlseek,
+            .read = tread,
+            .write = twrite,
+            .getdent = tgetdent,
+            .getdents = tgetdents,
+            .mmap = tmmap,
+        },
+        .mount = tmount,
+        .getroot = getroot,
+        .lookup = lookup,
+        .creat = tcreat,
+        .mkdir = tmkdir,
+        .stat = tstat,
+    };
+    return &iops;
+}
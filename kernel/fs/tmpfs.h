@@ -0,0 +1,8 @@
+#ifndef FS_TMPFS_H
+#define FS_TMPFS_H
+
+#include "../fs.h"
+
+const struct inode_ops *get_tmpfs(void);
+
+#endif
@@ -0,0 +1,399 @@
+// a small single pass inflater (rfc 1951) with a gzip (rfc 1952) wrapper.
+// the output buffer doubles as the window, so it needs no memory of its
+// own. the code tables are static, so only one inflate can run at a time.
+// it is used once at boot.
+
+#include "inflate.h"
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MAX_BITS   15
+#define MAX_LCODES 286
+#define MAX_DCODES 30
+#define FIX_LCODES 288
+
+struct inflate_state {
+    const uint8_t *in;
+    size_t inlen;
+    size_t inpos;
+    uint32_t bitbuf;
+    int bitcnt;
+
+    uint8_t *out;
+    size_t outlen;
+    size_t outpos;
+
+    bool err;
+};
+
+// canonical huffman code: the number of codes of each length, and the
+// symbols ordered by code
+struct huffman {
+    uint16_t count[MAX_BITS+1];
+    uint16_t symbol[FIX_LCODES];
+};
+
+static struct huffman lencode, distcode;
+
+static uint32_t bits(struct inflate_state *s, int need) {
+    uint32_t val = s->bitbuf;
+    while (s->bitcnt < need) {
+        if (s->inpos == s->inlen) {
+            s->err = true;
+            return 0;
+        }
+        val |= (uint32_t) s->in[s->inpos++] << s->bitcnt;
+        s->bitcnt += 8;
+    }
+
+    s->bitbuf = val >> need;
+    s->bitcnt -= need;
+    return val & ((1u << need) - 1);
+}
+
+// returns the symbol, or -1
+static int decode(struct inflate_state *s, const struct huffman *h) {
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len <= MAX_BITS; ++len) {
+        code |= bits(s, 1);
+        if (s->err) {
+            return -1;
+        }
+        int count = h->count[len];
+        if (code - count < first) {
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+// builds h from the code lengths. incomplete codes are allowed, over
+// subscribed ones are not
+static int construct(struct huffman *h, const uint8_t *lengths, int n) {
+    memset(h->count, 0, sizeof(h->count));
+    for (int sym = 0; sym < n; ++sym) {
+        h->count[lengths[sym]]++;
+    }
+
+    int left = 1;
+    for (int len = 1; len <= MAX_BITS; ++len) {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0) {
+            return -1;
+        }
+    }
+
+    uint16_t offs[MAX_BITS+1];
+    offs[1] = 0;
+    for (int len = 1; len < MAX_BITS; ++len) {
+        offs[len + 1] = offs[len] + h->count[len];
+    }
+
+    for (int sym = 0; sym < n; ++sym) {
+        if (lengths[sym] != 0) {
+            h->symbol[offs[lengths[sym]]++] = sym;
+        }
+    }
+    return 0;
+}
+
+static int stored(struct inflate_state *s) {
+    // the length is byte aligned
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+
+    if (s->inlen - s->inpos < 4) {
+        return -1;
+    }
+    size_t len = s->in[s->inpos] | (s->in[s->inpos + 1] << 8);
+    size_t nlen = s->in[s->inpos + 2] | (s->in[s->inpos + 3] << 8);
+    s->inpos += 4;
+    if (len != (~nlen & 0xffff)) {
+        return -1;
+    }
+
+    if (s->inlen - s->inpos < len || s->outlen - s->outpos < len) {
+        return -1;
+    }
+    memcpy(s->out + s->outpos, s->in + s->inpos, len);
+    s->inpos += len;
+    s->outpos += len;
+    return 0;
+}
+
+static const uint16_t lbase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lext[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dbase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+static const uint8_t dext[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static int codes(struct inflate_state *s) {
+    for (;;) {
+        int sym = decode(s, &lencode);
+        if (sym < 0) {
+            return -1;
+        }
+
+        if (sym < 256) {
+            if (s->outpos == s->outlen) {
+                return -1;
+            }
+            s->out[s->outpos++] = sym;
+        } else if (sym == 256) {
+            return 0;
+        } else {
+            sym -= 257;
+            if (sym >= 29) {
+                return -1;
+            }
+            size_t len = lbase[sym] + bits(s, lext[sym]);
+
+            int dsym = decode(s, &distcode);
+            if (dsym < 0 || dsym >= 30) {
+                return -1;
+            }
+            size_t dist = dbase[dsym] + bits(s, dext[dsym]);
+            if (s->err || dist > s->outpos
+                || len > s->outlen - s->outpos) {
+                return -1;
+            }
+
+            // the source may overlap what is being written
+            uint8_t *to = s->out + s->outpos;
+            const uint8_t *from = to - dist;
+            for (size_t i = 0; i < len; ++i) {
+                to[i] = from[i];
+            }
+            s->outpos += len;
+        }
+    }
+}
+
+static int fixed(struct inflate_state *s) {
+    uint8_t lengths[FIX_LCODES];
+    int sym = 0;
+    for (; sym < 144; ++sym) {
+        lengths[sym] = 8;
+    }
+    for (; sym < 256; ++sym) {
+        lengths[sym] = 9;
+    }
+    for (; sym < 280; ++sym) {
+        lengths[sym] = 7;
+    }
+    for (; sym < FIX_LCODES; ++sym) {
+        lengths[sym] = 8;
+    }
+    construct(&lencode, lengths, FIX_LCODES);
+
+    for (sym = 0; sym < MAX_DCODES; ++sym) {
+        lengths[sym] = 5;
+    }
+    construct(&distcode, lengths, MAX_DCODES);
+
+    return codes(s);
+}
+
+static int dynamic(struct inflate_state *s) {
+    static const uint8_t order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+    uint8_t lengths[MAX_LCODES + MAX_DCODES];
+
+    int nlen = bits(s, 5) + 257;
+    int ndist = bits(s, 5) + 1;
+    int ncode = bits(s, 4) + 4;
+    if (s->err || nlen > MAX_LCODES || ndist > MAX_DCODES) {
+        return -1;
+    }
+
+    int idx;
+    for (idx = 0; idx < ncode; ++idx) {
+        lengths[order[idx]] = bits(s, 3);
+    }
+    for (; idx < 19; ++idx) {
+        lengths[order[idx]] = 0;
+    }
+    if (s->err || construct(&lencode, lengths, 19) < 0) {
+        return -1;
+    }
+
+    for (idx = 0; idx < nlen + ndist;) {
+        int sym = decode(s, &lencode);
+        if (sym < 0) {
+            return -1;
+        }
+
+        if (sym < 16) {
+            lengths[idx++] = sym;
+            continue;
+        }
+
+        int len = 0;
+        int rep;
+        if (sym == 16) {
+            if (idx == 0) {
+                return -1;
+            }
+            len = lengths[idx - 1];
+            rep = 3 + bits(s, 2);
+        } else if (sym == 17) {
+            rep = 3 + bits(s, 3);
+        } else {
+            rep = 11 + bits(s, 7);
+        }
+        if (s->err || idx + rep > nlen + ndist) {
+            return -1;
+        }
+        while (rep--) {
+            lengths[idx++] = len;
+        }
+    }
+
+    // there has to be an end of block code
+    if (lengths[256] == 0) {
+        return -1;
+    }
+
+    if (construct(&lencode, lengths, nlen) < 0
+        || construct(&distcode, lengths + nlen, ndist) < 0) {
+        return -1;
+    }
+
+    return codes(s);
+}
+
+static int inflate(struct inflate_state *s) {
+    int last;
+    do {
+        last = bits(s, 1);
+        int type = bits(s, 2);
+        if (s->err) {
+            return -1;
+        }
+
+        int err;
+        if (type == 0) {
+            err = stored(s);
+        } else if (type == 1) {
+            err = fixed(s);
+        } else if (type == 2) {
+            err = dynamic(s);
+        } else {
+            err = -1;
+        }
+
+        if (err < 0 || s->err) {
+            return -1;
+        }
+    } while (!last);
+
+    return 0;
+}
+
+static uint32_t crc32(const uint8_t *buf, size_t len) {
+    static uint32_t table[256];
+    static bool table_done = false;
+
+    if (!table_done) {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1)? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        table_done = true;
+    }
+
+    uint32_t c = 0xffffffff;
+    for (size_t i = 0; i < len; ++i) {
+        c = table[(c ^ buf[i]) & 0xff] ^ (c >> 8);
+    }
+    return c ^ 0xffffffff;
+}
+
+#define GZ_FHCRC    (1<<1)
+#define GZ_FEXTRA   (1<<2)
+#define GZ_FNAME    (1<<3)
+#define GZ_FCOMMENT (1<<4)
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+bool is_gzip(const void *src, size_t len) {
+    const uint8_t *p = src;
+    return len >= 18 && p[0] == 0x1f && p[1] == 0x8b && p[2] == 8;
+}
+
+size_t gzip_size(const void *src, size_t len) {
+    return get32((const uint8_t *) src + len - 4);
+}
+
+ssize_t gunzip(const void *src, size_t len, void *dst, size_t dstlen) {
+    if (!is_gzip(src, len)) {
+        return -EINVAL;
+    }
+
+    const uint8_t *p = src;
+    uint8_t flags = p[3];
+    size_t pos = 10;
+
+    if (flags & GZ_FEXTRA) {
+        pos += 2 + (p[pos] | (p[pos + 1] << 8));
+    }
+    if (flags & GZ_FNAME) {
+        while (pos < len && p[pos] != '\0') {
+            ++pos;
+        }
+        ++pos;
+    }
+    if (flags & GZ_FCOMMENT) {
+        while (pos < len && p[pos] != '\0') {
+            ++pos;
+        }
+        ++pos;
+    }
+    if (flags & GZ_FHCRC) {
+        pos += 2;
+    }
+    if (pos + 8 > len) {
+        return -EINVAL;
+    }
+
+    struct inflate_state s = {
+        .in = p + pos,
+        .inlen = len - pos - 8, // crc32 and isize
+        .out = dst,
+        .outlen = dstlen,
+    };
+    if (inflate(&s) < 0) {
+        return -EINVAL;
+    }
+
+    if (get32(p + len - 4) != (uint32_t) s.outpos
+        || get32(p + len - 8) != crc32(dst, s.outpos)) {
+        return -EINVAL;
+    }
+    return s.outpos;
+}
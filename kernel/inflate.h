@@ -0,0 +1,17 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+bool is_gzip(const void *src, size_t len);
+
+// the uncompressed size from the gzip trailer (mod 2^32)
+size_t gzip_size(const void *src, size_t len);
+
+// decompresses a gzip member into dst, and checks its crc. returns the
+// uncompressed length or -EINVAL. not reentrant
+ssize_t gunzip(const void *src, size_t len, void *dst, size_t dstlen);
+
+#endif
@@ -200,21 +200,24 @@ void kfree(void *ptr) {
 }
 
 void *kmalloc_sync(size_t size) {
-    acquire_lock(&memlock);
+    void *ra = __builtin_return_address(0);
+    acquire_lock_from(&memlock, ra);
     void *km = kmalloc(size);
-    release_lock(&memlock);
+    release_lock_from(&memlock, ra);
     return km;
 }
 
 void *krealloc_sync(void *ptr, size_t size) {
-    acquire_lock(&memlock);
+    void *ra = __builtin_return_address(0);
+    acquire_lock_from(&memlock, ra);
     void *km = krealloc(ptr, size);
-    release_lock(&memlock);
+    release_lock_from(&memlock, ra);
     return km;
 }
 
 void kfree_sync(void *ptr) {
-    acquire_lock(&memlock);
+    void *ra = __builtin_return_address(0);
+    acquire_lock_from(&memlock, ra);
     kfree(ptr);
-    release_lock(&memlock);
+    release_lock_from(&memlock, ra);
 }
@@ -16,30 +16,90 @@
 #include "device.h"
 #include "fs.h"
 #include "fs/tarfs.h"
+#include "fs/packfs.h"
+#include "fs/tmpfs.h"
+#include "fs/ext2.h"
 #include "fs/devfs.h"
 #include "device/fb.h"
+#include "vdata.h"
+#include "inflate.h"
+#include "block.h"
+#include "device/ramdisk.h"
+#include "device/pci.h"
+#include "device/ata.h"
+#include "device/virtio_blk.h"
+#include "device/irqstat.h"
+#include "device/irqsoff.h"
+
+
+// boot, stage by stage, timed with the tsc. printed at the end, since the
+// tsc rate isn't known until init_cpu
+#define MAX_STAGES 16
+
+static uint64_t boot_start;
+static struct {
+    const char *name;
+    uint64_t end;
+} stages[MAX_STAGES];
+static size_t nstages = 0;
+
+static void stage_done(const char *name) {
+    if (nstages < MAX_STAGES) {
+        stages[nstages].name = name;
+        stages[nstages].end = read_cycles();
+        ++nstages;
+    }
+}
 
+static void print_boot_profile(void) {
+    uint64_t hz = cycles_hz();
+    uint64_t prev = boot_start;
+    for (size_t i = 0; i < nstages; ++i) {
+        uint64_t cycles = stages[i].end - prev;
+        if (hz != 0) {
+            kprintf("boot: %s %lluus\n", stages[i].name,
+                    cycles * 1000000 / hz);
+        } else {
+            kprintf("boot: %s %llu cycles\n", stages[i].name, cycles);
+        }
+        prev = stages[i].end;
+    }
+    if (hz != 0) {
+        kprintf("boot: total %lluus\n", (prev - boot_start) * 1000000 / hz);
+    }
+}
 
 void kmain(unsigned long magic, unsigned long addr) {
+    boot_start = read_cycles();
     acquire_global();
 
     tty_init();
     comtty_init();
+    stage_done("tty");
     init_cpu();
+    stage_done("cpu");
     kassert(magic == MULTIBOOT_BOOTLOADER_MAGIC);
 
     multiboot_info_t *mbi = (multiboot_info_t *) addr;
 
     multiboot_module_t *mods = (multiboot_module_t *) mbi->mods_addr;
 
-    kassert(mbi->mods_count == 1);
+    // the initrd, and maybe a ram disk
+    kassert(mbi->mods_count == 1 || mbi->mods_count == 2);
 
-    kprintf("found initramfs '%s' at %X...%X\n",
+    kprintf("found initramfs '%s' at 0x%08X...0x%08X\n",
             (const char *) mods[0].cmdline,
             mods[0].mod_start, mods[0].mod_end);
 
-    kprintf("loading initrd\n");
-    initrd_init((void *)mods[0].mod_start, (void *)mods[0].mod_end);
+    uintptr_t mods_end = mods[0].mod_end;
+    if (mbi->mods_count == 2) {
+        kprintf("found ram disk '%s' at 0x%08X...0x%08X\n",
+                (const char *) mods[1].cmdline,
+                mods[1].mod_start, mods[1].mod_end);
+        if (mods[1].mod_end > mods_end) {
+            mods_end = mods[1].mod_end;
+        }
+    }
 
     multiboot_memory_map_t *mems = (multiboot_memory_map_t *) mbi->mmap_addr;
     multiboot_memory_map_t *mend = ((void *) mems) + mbi->mmap_length;
@@ -51,34 +111,113 @@ void kmain(unsigned long magic, unsigned long addr) {
 
             //TODO: detect initbrk better.
             kprintf("initializing memory manager\n");
-            kprintf("mem: %llX...%llX\n", m->addr, m->addr + m->len);
-            mem_init(m->addr, mods[0].mod_end, m->len);
+            kprintf("mem: 0x%08llX...0x%08llX\n", m->addr, m->addr + m->len);
+            mem_init(m->addr, mods_end, m->len);
             kprintf("%lluMB free\n", m->len / (1024 * 1024));
             break;
         }
     }
+    stage_done("mem");
+
+    init_apic();
+    stage_done("apic");
+
+    kprintf("loading initrd\n");
+    uint64_t initrd_cycles = read_cycles();
+
+    char *rd_start = (char *) mods[0].mod_start;
+    char *rd_end = (char *) mods[0].mod_end;
+    if (is_gzip(rd_start, rd_end - rd_start)) {
+        size_t len = gzip_size(rd_start, rd_end - rd_start);
+        char *image = alloc_pages_ptr(len/PAGE_SIZE + 1);
+        if (image == NULL) {
+            panic("no memory to inflate the initrd");
+        }
+
+        uint64_t start = read_cycles();
+        ssize_t ret = gunzip(rd_start, rd_end - rd_start, image, len);
+        if (ret < 0) {
+            panic("corrupt initrd");
+        }
+        kprintf("inflated initrd: %lu -> %lu bytes in %llu cycles\n",
+                (unsigned long) (rd_end - rd_start), (unsigned long) ret,
+                read_cycles() - start);
 
+        rd_start = image;
+        rd_end = image + ret;
+    }
+    initrd_init(rd_start, rd_end);
 
     struct inode in = {
         .ftype = FT_SPECIAL,
         .dev = MKDEV(DEV_INITRD, 0),
     };
 
-    fs_mount("/", &in, get_tarfs());
-    fs_mount("/dev", &in, get_devfs());
+    const struct inode_ops *rootfs = get_tarfs();
+    if (packfs_probe(rd_start, rd_end - rd_start)) {
+        kprintf("initrd is a packed image\n");
+        rootfs = get_packfs();
+    }
+
+    fs_mount("/", &in, rootfs);
+    kprintf("initrd mounted in %llu cycles\n", read_cycles() - initrd_cycles);
+    stage_done("initrd");
+    fs_mount(DEVFS_MOUNT, &in, get_devfs());
+    fs_mount("/tmp", &in, get_tmpfs());
+    irqstat_init();
+    irqsoff_init();
+
+    stage_done("mounts");
+
+    block_init();
+    if (mbi->mods_count == 2) {
+        ramdisk_init((void *) mods[1].mod_start, (void *) mods[1].mod_end);
+    }
+    pci_init();
+    ata_init();
+    virtio_blk_init();
+
+    // the first disk with ext2 on it
+    const char *const disks[] = { "/dev/ram0", "/dev/hda", "/dev/vda" };
+    for (size_t i = 0; i < sizeof(disks) / sizeof(disks[0]); ++i) {
+        struct inode disk;
+        if (fs_lookup(disks[i], &disk) < 0 || !ext2_probe(&disk)) {
+            continue;
+        }
+        int err = fs_mount("/mnt", &disk, get_ext2());
+        if (err < 0) {
+            kprintf("%s: ext2 mount failed: %s\n", disks[i], strerror(-err));
+        } else {
+            kprintf("%s mounted at /mnt\n", disks[i]);
+        }
+        break;
+    }
+    stage_done("disks");
 
-    if (mbi->framebuffer_type == MULTIBOOT_FRAMEBUFFER_TYPE_RGB) {
+    bool has_fb = mbi->framebuffer_type == MULTIBOOT_FRAMEBUFFER_TYPE_RGB;
+    if (has_fb) {
         kprintf("found framebuffer %p\n",
                 (void *)(uintptr_t)mbi->framebuffer_addr);
         fb_init((void *)(uintptr_t)mbi->framebuffer_addr,
                 mbi->framebuffer_width,
                 mbi->framebuffer_height);
-        fbtty_init();
     }
+    stage_done("fb");
 
     release_global();
 
+    vdata_init();
     init_proc();
+    stage_done("proc");
+
+    // like the rest of the boot log, this goes to the vga and serial
+    // consoles. the fb console draws nothing until it is first opened
+    print_boot_profile();
+    if (has_fb) {
+        acquire_global();
+        fbtty_init();
+        release_global();
+    }
 
     // here we go!
     char *argv[] = {NULL};
@@ -22,6 +22,11 @@ void mem_init(uintptr_t base, uintptr_t initbrk, uintptr_t length) {
     mem_base = base;
     breakptr = initbrk;
 
+    // leave the mmio region alone
+    if (length > MMIO_REGION - base) {
+        length = MMIO_REGION - base;
+    }
+
     sizeof_frames = sizeof(size_t) * CIEL(length/PAGE_SIZE,
                                           CHAR_BIT*sizeof(size_t));
     // odds are this is aligned
@@ -98,6 +103,24 @@ void free_page(page_t page) {
     set_bit(frames, page-mem_base/PAGE_SIZE, false);
 }
 
+void *alloc_pages_ptr(size_t n) {
+    // cached free pages could be inside the run
+    free_stack_top = 0;
+
+    size_t run = 0;
+    for (size_t i = nframes; i-- > 0;) {
+        if (get_bit(frames, i)) {
+            run = 0;
+        } else if (++run == n) {
+            for (size_t j = i; j < i + n; ++j) {
+                set_bit(frames, j, true);
+            }
+            return (void *) ((i + mem_base/PAGE_SIZE) << 12);
+        }
+    }
+    return NULL;
+}
+
 void *alloc_page_ptr(void) {
     return (void *) (alloc_page() << 12);
 }
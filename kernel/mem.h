@@ -23,6 +23,9 @@ void free_page(page_t page);
 void *alloc_page_ptr(void);
 void free_page_ptr(void *page);
 
+// n physically contiguous pages, or NULL. free them one at a time
+void *alloc_pages_ptr(size_t n);
+
 extern petix_lock_t memlock;
 
 page_t alloc_page_sync(void);
@@ -2,6 +2,8 @@
 #include "kmalloc.h"
 #include "string.h"
 #include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
 #include "kdebug.h"
 
 #define READ_END 0x100000000ll
@@ -23,6 +25,21 @@ static ssize_t pread(struct file *f, char *buf, size_t count) {
     ssize_t c = count;
     while (count > 0) {
         acquire_lock(&(pipe->lock));
+        while (pipe->ref_n > 0 && count > 0) {
+            struct pipe_ref *ref = &(pipe->refs[pipe->ref_lo]);
+            size_t len = MIN(ref->len, count);
+            memcpy(buf, ref->ptr, len);
+            buf += len;
+            count -= len;
+            ref->ptr += len;
+            ref->len -= len;
+
+            if (ref->len == 0) {
+                pipe->ref_lo = (pipe->ref_lo + 1) % PIPE_REFS;
+                pipe->ref_n--;
+            }
+        }
+
         while (pipe->hi != pipe->lo && count > 0) {
             *buf = pipe->buffer[pipe->lo];
             ++buf;
@@ -32,15 +49,20 @@ static ssize_t pread(struct file *f, char *buf, size_t count) {
 
         if ((pipe->hi+1)%PIPE_SIZE != pipe->lo) {
             cond_wake(&(pipe->wcond));
+            waitq_wake(&(pipe->wwait));
         }
 
-        if (!pipe->owrite && pipe->hi == pipe->lo) {
+        if (!pipe->owrite && pipe->hi == pipe->lo && pipe->ref_n == 0) {
             release_lock(&(pipe->lock));
             return c-count;
         } else {
             release_lock(&(pipe->lock));
         }
 
+        if (count > 0 && (f->flags & O_NONBLOCK)) {
+            return (c-count > 0)? c-count : -EAGAIN;
+        }
+
         if (count > 0) {
             cond_wait(&(pipe->rcond));
         }
@@ -60,14 +82,20 @@ static ssize_t pwrite(struct file *f, const char *buf, size_t count) {
 
     struct pipe *pipe = (void *)(uintptr_t) (f->private_data & 0xffffffff);
 
+    if (count == 0) {
+        return 0;
+    }
+
     ssize_t c = count;
     while (count > 0) {
         if (!pipe->oread) {
-            return c-count;
+            return (c-count > 0)? c-count : -EPIPE;
         }
 
         acquire_lock(&(pipe->lock));
-        while ((pipe->hi+1)%PIPE_SIZE != pipe->lo && count > 0) {
+        // references queued by splice go first
+        while ((pipe->hi+1)%PIPE_SIZE != pipe->lo && pipe->ref_n == 0
+               && count > 0) {
             pipe->buffer[pipe->hi] = *buf;
             ++buf;
             --count;
@@ -76,10 +104,16 @@ static ssize_t pwrite(struct file *f, const char *buf, size_t count) {
 
         if (pipe->hi != pipe->lo) {
             cond_wake(&(pipe->rcond));
+            waitq_wake(&(pipe->rwait));
         }
 
         release_lock(&(pipe->lock));
 
+        // only non-blocking writes come back short
+        if (count > 0 && (f->flags & O_NONBLOCK)) {
+            return (c-count > 0)? c-count : -EAGAIN;
+        }
+
         if (count > 0) {
             cond_wait(&(pipe->wcond));
         }
@@ -88,6 +122,80 @@ static ssize_t pwrite(struct file *f, const char *buf, size_t count) {
     return c;
 }
 
+// queues a reference to buf. waits for the ring to drain first.
+static ssize_t pwrite_ref(struct file *f, const char *buf, size_t count) {
+    if (f->private_data == 0) {
+        return 0;
+    }
+
+    if (!(f->private_data & WRITE_END)) {
+        return -EPERM;
+    }
+
+    struct pipe *pipe = (void *)(uintptr_t) (f->private_data & 0xffffffff);
+
+    if (count == 0) {
+        return 0;
+    }
+
+    while (1) {
+        if (!pipe->oread) {
+            return -EPIPE;
+        }
+
+        acquire_lock(&(pipe->lock));
+        if (pipe->hi == pipe->lo && pipe->ref_n < PIPE_REFS) {
+            size_t i = (pipe->ref_lo + pipe->ref_n) % PIPE_REFS;
+            pipe->refs[i].ptr = buf;
+            pipe->refs[i].len = count;
+            pipe->ref_n++;
+
+            cond_wake(&(pipe->rcond));
+            waitq_wake(&(pipe->rwait));
+            release_lock(&(pipe->lock));
+            return count;
+        }
+        release_lock(&(pipe->lock));
+
+        if (f->flags & O_NONBLOCK) {
+            return -EAGAIN;
+        }
+
+        cond_wait(&(pipe->wcond));
+    }
+}
+
+static int ppoll(struct file *f, struct poll_table *pt) {
+    if (f->private_data == 0) {
+        return POLLHUP;
+    }
+
+    struct pipe *pipe = (void *)(uintptr_t) (f->private_data & 0xffffffff);
+
+    int mask = 0;
+    acquire_lock(&(pipe->lock));
+    if (f->private_data & READ_END) {
+        poll_wait(pt, &(pipe->rwait));
+        if (pipe->hi != pipe->lo || pipe->ref_n > 0) {
+            mask |= POLLIN;
+        }
+        if (!pipe->owrite) {
+            mask |= POLLHUP;
+        }
+    } else {
+        poll_wait(pt, &(pipe->wwait));
+        if ((pipe->hi+1)%PIPE_SIZE != pipe->lo && pipe->ref_n == 0) {
+            mask |= POLLOUT;
+        }
+        if (!pipe->oread) {
+            mask |= POLLERR;
+        }
+    }
+    release_lock(&(pipe->lock));
+
+    return mask;
+}
+
 static int pclose(struct file *f) {
     if (f->private_data == 0) {
         // pipe is already closed and freed
@@ -105,6 +213,8 @@ static int pclose(struct file *f) {
 
     cond_wake(&(pipe->wcond));
     cond_wake(&(pipe->rcond));
+    waitq_wake(&(pipe->wwait));
+    waitq_wake(&(pipe->rwait));
 
     release_lock(&(pipe->lock));
     if (!pipe->oread && !pipe->owrite) {
@@ -131,9 +241,14 @@ void open_pipe(struct file *rfile, struct file *wfile) {
         .read = pread,
         .write = pwrite,
         .getdent = NULL,
+        .poll = ppoll,
+        .write_ref = pwrite_ref,
         .close = pclose,
     };
 
+    rfile->inode.ftype = FT_FIFO;
+    wfile->inode.ftype = FT_FIFO;
+
     rfile->fops = &fops;
     rfile->private_data = READ_END | (off_t) (uintptr_t) pipe;
 
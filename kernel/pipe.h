@@ -5,16 +5,30 @@
 #include "fs.h"
 
 #define PIPE_SIZE 4096
+#define PIPE_REFS 16
+
+// spliced data that the pipe points at instead of copying
+struct pipe_ref {
+    const char *ptr;
+    size_t len;
+};
 
 struct pipe {
     petix_lock_t lock;
     petix_sem_t rcond;
     petix_sem_t wcond;
+    petix_waitq_t rwait; // pollers of the read end
+    petix_waitq_t wwait;
     bool owrite;
     bool oread;
     size_t lo;
     size_t hi;
     char buffer[PIPE_SIZE];
+    // refs are only queued while the ring is empty, and the ring counts as
+    // full while there are refs, so the order of the data is kept.
+    struct pipe_ref refs[PIPE_REFS];
+    size_t ref_lo;
+    size_t ref_n;
 };
 
 void open_pipe(struct file *rfile, struct file *wfile);
@@ -0,0 +1,148 @@
+#include "syscall.h"
+#include "proc.h"
+#include "sync.h"
+#include "kmalloc.h"
+#include <poll.h>
+#include <errno.h>
+#include <sys/vdata.h>
+
+#define POLL_MAX_FDS 1024
+
+struct poll_entry {
+    struct waitq_ent ent;
+    petix_waitq_t *q;
+    struct poll_entry *next;
+};
+
+struct poll_table {
+    struct poll_entry *ents;
+};
+
+void poll_wait(struct poll_table *pt, petix_waitq_t *q) {
+    if (pt == NULL) {
+        return;
+    }
+
+    acquire_global();
+
+    // kernel stacks are per address space, so this can't live on ours
+    struct poll_entry *pe = kmalloc(sizeof(struct poll_entry));
+    pe->ent.pid = get_pid();
+    pe->ent.next = q->lst;
+    q->lst = &(pe->ent);
+    pe->q = q;
+    pe->next = pt->ents;
+    pt->ents = pe;
+
+    release_global();
+}
+
+static void poll_table_release(struct poll_table *pt) {
+    acquire_global();
+
+    while (pt->ents != NULL) {
+        struct poll_entry *pe = pt->ents;
+        pt->ents = pe->next;
+
+        for (struct waitq_ent **ent = &(pe->q->lst); *ent != NULL;
+             ent = &((*ent)->next)) {
+            if (*ent == &(pe->ent)) {
+                *ent = pe->ent.next;
+                break;
+            }
+        }
+        kfree(pe);
+    }
+
+    release_global();
+}
+
+// fills in revents and returns how many are nonzero
+static ssize_t poll_files(struct pcb *pcb, struct pollfd *fds, nfds_t nfds,
+                          struct poll_table *pt) {
+    ssize_t nready = 0;
+
+    for (nfds_t i = 0; i < nfds; ++i) {
+        int fd = fds[i].fd;
+        fds[i].revents = 0;
+
+        if (fd < 0) {
+            continue;
+        }
+
+        struct file *f = (fd < MAX_FDS)? pcb->fds[fd].file : NULL;
+        int mask;
+        if (f == NULL) {
+            mask = POLLNVAL;
+        } else if (f->fops == NULL || f->fops->poll == NULL) {
+            // files without a hook never block
+            mask = POLLIN | POLLOUT;
+        } else {
+            mask = f->fops->poll(f, pt);
+        }
+
+        fds[i].revents = mask & (fds[i].events | POLLERR | POLLHUP | POLLNVAL);
+        if (fds[i].revents != 0) {
+            ++nready;
+        }
+    }
+
+    return nready;
+}
+
+ssize_t sys_poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+    if (nfds > POLL_MAX_FDS) {
+        return -EINVAL;
+    }
+
+    struct pcb *pcb = get_pcb(get_pid());
+    struct poll_table table = { .ents = NULL };
+
+    acquire_global();
+    pcb->poll.waiting = true;
+    pcb->poll.woken = false;
+    pcb->poll.deadline_ns = 0;
+    if (timeout > 0) {
+        pcb->poll.deadline_ns =
+            vdata_monotonic_ns() + (uint64_t) timeout * 1000000;
+    }
+    release_global();
+
+    // only the first pass registers on the wait queues. they stay there
+    // until we return.
+    struct poll_table *pt = (timeout == 0)? NULL : &table;
+
+    ssize_t nready;
+    while (1) {
+        nready = poll_files(pcb, fds, nfds, pt);
+        pt = NULL;
+
+        if (nready != 0 || timeout == 0) {
+            break;
+        }
+
+        if (pcb->poll.deadline_ns != 0
+            && vdata_monotonic_ns() >= pcb->poll.deadline_ns) {
+            break;
+        }
+
+        acquire_global();
+        if (!pcb->poll.woken) {
+            pcb->rs = RS_BLOCKED;
+            release_global();
+            sched();
+            acquire_global();
+        }
+        pcb->poll.woken = false;
+        release_global();
+    }
+
+    acquire_global();
+    pcb->poll.waiting = false;
+    pcb->poll.deadline_ns = 0;
+    release_global();
+
+    poll_table_release(&table);
+
+    return nready;
+}
@@ -5,6 +5,7 @@
 #include "arch/switch.h"
 #include "kmalloc.h"
 #include "mem.h"
+#include "vdata.h"
 #include <errno.h>
 #include <string.h>
 
@@ -19,7 +20,21 @@ static size_t pt_free = 0;
 
 static pid_t curpid;
 
+// wakes processes whose poll timed out
+static void wake_timeouts(void) {
+    uint64_t now = vdata_monotonic_ns();
+
+    for (size_t i = 0; i < PTABLE_SIZE; ++i) {
+        struct pcb *pcb = &(ptable[i]);
+        if (pcb->rs == RS_BLOCKED && pcb->poll.waiting
+            && pcb->poll.deadline_ns != 0 && now >= pcb->poll.deadline_ns) {
+            pcb->rs = RS_READY;
+        }
+    }
+}
+
 static void timer_handler(void) {
+    wake_timeouts();
     sched();
 }
 
@@ -32,6 +47,7 @@ void init_proc(void) {
     pcb->rs = RS_RUNNING;
     pcb->addr_space = create_proc_addr_space();
     use_addr_space(pcb->addr_space);
+    vdata_proc_init(pcb);
 
     //set up kernel stack
     for (int i = 0; i < KERNEL_STACK_SIZE; i += PAGE_SIZE){
@@ -60,6 +76,10 @@ pid_t get_pid(void) {
     return curpid;
 }
 
+uint64_t get_away_cycles(void) {
+    return ptable[pid_off(curpid)].away_cycles;
+}
+
 struct pcb *get_pcb(pid_t pid) {
     struct pcb *pcb = &(ptable[pid_off(pid)]);
 
@@ -89,6 +109,9 @@ struct pcb *alloc_proc(void) {
     pcb->rs = RS_CREATED;
     pcb->pid = make_pid(pid_gen(pcb->pid) + 1, pt_free);
     pcb->ppid = -1;
+    memset(&pcb->ring, 0, sizeof(pcb->ring));
+    memset(&pcb->poll, 0, sizeof(pcb->poll));
+    pcb->away_cycles = 0;
 
     release_global();
 
@@ -194,7 +217,9 @@ void sched(void) {
                 //kprintf("no processes; halting until interrupt\n");
                 nested = true;
                 release_global();
+                uint64_t start = read_cycles();
                 halt();
+                curpcb->away_cycles += read_cycles() - start;
                 acquire_global();
                 nested = false;
             } else {
@@ -209,7 +234,9 @@ void sched(void) {
         // context switch does not work with the same process
         curpid = newpcb->pid;
 
+        uint64_t start = read_cycles();
         context_switch(newpcb->stack_ptr, &(curpcb->stack_ptr), newpcb->addr_space);
+        curpcb->away_cycles += read_cycles() - start;
     }
 
     release_global();
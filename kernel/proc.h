@@ -8,6 +8,8 @@
 #include <sys/types.h>
 #include "fs.h"
 
+struct petix_ring;
+
 
 enum ready_state {
     RS_NOPROC = 0,
@@ -35,6 +37,19 @@ struct pcb {
         struct file *file;
         bool cloexec;
     } fds[MAX_FDS];
+    struct {
+        struct petix_ring *kaddr; // NULL when there is no ring
+        void *uaddr;
+        bool poll;
+    } ring;
+    struct {
+        bool waiting; // in poll, so wait queues may wake us
+        bool woken;
+        uint64_t deadline_ns; // 0 for no timeout
+    } poll;
+    // cycles spent switched out or halted in sched, so interrupt handlers
+    // that block can leave them out of their own time
+    uint64_t away_cycles;
 
     //TODO all kinds of other stuff
 };
@@ -43,6 +58,8 @@ struct pcb {
 void init_proc(void);
 
 pid_t get_pid(void);
+// the current process's away_cycles
+uint64_t get_away_cycles(void);
 struct pcb *get_pcb(pid_t pid);
 
 struct pcb *alloc_proc(void);
@@ -0,0 +1,118 @@
+#include "ring.h"
+#include "syscall.h"
+#include "mem.h"
+#include "kdebug.h"
+#include "arch/paging.h"
+#include <sys/syscall.h>
+#include <errno.h>
+#include <string.h>
+
+_Static_assert(sizeof(struct petix_ring) <= PAGE_SIZE,
+               "struct petix_ring must fit in a page");
+
+ssize_t sys_ring_setup(struct petix_ring *uaddr, int flags) {
+    struct pcb *pcb = get_pcb(get_pid());
+
+    if (pcb->ring.kaddr != NULL) {
+        return -EBUSY;
+    }
+
+    if ((uintptr_t)uaddr & (PAGE_SIZE-1)) {
+        return -EINVAL;
+    }
+
+    // the kernel keeps its own (identity mapped) pointer to the page, so it
+    // does not depend on the process's mapping
+    struct petix_ring *ring = alloc_page_ptr_sync();
+    memset(ring, 0, PAGE_SIZE);
+
+    if (remap_page_user(pcb->addr_space, uaddr, ring) == -1) {
+        free_page_ptr_sync(ring);
+        return -EFAULT;
+    }
+    flush_tlb();
+
+    pcb->ring.kaddr = ring;
+    pcb->ring.uaddr = uaddr;
+    pcb->ring.poll = (flags & RING_SQPOLL) != 0;
+    return 0;
+}
+
+// syscalls that never return or replace the process can't be batched
+static bool ring_allowed(uint32_t nr) {
+    return nr < 256 && syscall_table[nr] != NULL
+        && nr != SYS_NR_RING_SETUP && nr != SYS_NR_RING_ENTER
+        && nr != SYS_NR_FORK && nr != SYS_NR_EXEC && nr != SYS_NR_EXIT;
+}
+
+static int ring_drain(struct petix_ring *ring, unsigned to_submit) {
+    int done = 0;
+
+    while (ring->sq_head != ring->sq_tail
+           && (to_submit == 0 || done < to_submit)) {
+
+        // stop when there is nowhere to post the completion
+        if (ring->cq_tail - ring->cq_head >= RING_CQ_ENTRIES) {
+            break;
+        }
+
+        // copy the entry first; userspace may scribble on it
+        struct ring_sqe sqe = ring->sq[ring->sq_head & (RING_SQ_ENTRIES-1)];
+        ring->sq_head++;
+
+        ssize_t res = -EINVAL;
+        if (ring_allowed(sqe.nr)) {
+            res = syscall_table[sqe.nr](sqe.args[0], sqe.args[1],
+                                        sqe.args[2], sqe.args[3],
+                                        sqe.args[4]);
+        }
+
+        struct ring_cqe *cqe = &(ring->cq[ring->cq_tail & (RING_CQ_ENTRIES-1)]);
+        cqe->res = res;
+        cqe->user_data = sqe.user_data;
+        ring->cq_tail++;
+
+        ++done;
+    }
+
+    return done;
+}
+
+ssize_t sys_ring_enter(unsigned to_submit) {
+    struct pcb *pcb = get_pcb(get_pid());
+
+    if (pcb->ring.kaddr == NULL) {
+        return -EINVAL;
+    }
+
+    return ring_drain(pcb->ring.kaddr, to_submit);
+}
+
+void ring_poll(void) {
+    struct pcb *pcb = get_pcb(get_pid());
+
+    if (pcb != NULL && pcb->ring.kaddr != NULL && pcb->ring.poll) {
+        ring_drain(pcb->ring.kaddr, 0);
+    }
+}
+
+void ring_fork(struct pcb *parent, struct pcb *child) {
+    memset(&child->ring, 0, sizeof(child->ring));
+
+    // the page table was copied, so the child still points at the parent's
+    // ring page. give it a fresh demand allocated page instead.
+    if (parent->ring.kaddr != NULL) {
+        unmap_page_user(child->addr_space, parent->ring.uaddr);
+    }
+}
+
+void ring_release(struct pcb *pcb) {
+    if (pcb->ring.kaddr != NULL) {
+        if (pcb->addr_space != NULL) {
+            unmap_page_user(pcb->addr_space, pcb->ring.uaddr);
+            flush_tlb();
+        }
+        free_page_ptr_sync(pcb->ring.kaddr);
+    }
+    memset(&pcb->ring, 0, sizeof(pcb->ring));
+}
@@ -0,0 +1,17 @@
+#ifndef RING_H
+#define RING_H
+
+#include <sys/ring.h>
+#include <sys/types.h>
+#include "proc.h"
+
+// drains the current process's ring if it is in RING_SQPOLL mode.
+// called on the way back to userspace from a syscall.
+void ring_poll(void);
+
+// the child of a fork does not inherit the ring
+void ring_fork(struct pcb *parent, struct pcb *child);
+// unmaps and frees the ring, for exec and exit
+void ring_release(struct pcb *pcb);
+
+#endif
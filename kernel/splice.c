@@ -0,0 +1,134 @@
+#include "syscall.h"
+#include "proc.h"
+#include "fs.h"
+#include "kmalloc.h"
+#include <errno.h>
+#include <unistd.h>
+
+#define SPLICE_BUF_SIZE 4096
+
+#define MIN(a, b) (((a)<(b))? (a):(b))
+
+static struct file *get_file(int fd) {
+    struct pcb *pcb = get_pcb(get_pid());
+
+    if (fd >= MAX_FDS || fd < 0) {
+        return NULL;
+    }
+    return pcb->fds[fd].file;
+}
+
+// copies through a kernel buffer, for sources without peek. a source
+// that can seek only moves past what was written. one that can't has
+// already given the data up, so it all has to go
+static ssize_t splice_copy(struct file *out, struct file *in, off_t *off,
+                           size_t count) {
+    if (in->fops->read == NULL) {
+        return -EPERM;
+    }
+
+    char *buf = kmalloc_sync(SPLICE_BUF_SIZE);
+
+    bool seekable = in->fops->lseek != NULL;
+    struct file tmp;
+    struct file *src = in;
+    if (seekable) {
+        tmp = *in;
+        tmp.offset = (off != NULL)? *off : in->offset;
+        src = &tmp;
+    }
+
+    ssize_t n = src->fops->read(src, buf, MIN(count, SPLICE_BUF_SIZE));
+    if (n <= 0) {
+        kfree_sync(buf);
+        return n;
+    }
+
+    ssize_t done = 0;
+    ssize_t ret = 0;
+    while (done < n) {
+        ret = out->fops->write(out, buf + done, n - done);
+        if (ret <= 0 || (seekable && ret < n - done)) {
+            done += (ret > 0)? ret : 0;
+            break;
+        }
+        done += ret;
+    }
+    kfree_sync(buf);
+
+    if (seekable) {
+        if (off != NULL) {
+            *off += done;
+        } else {
+            in->offset += done;
+        }
+    }
+    return (done > 0)? done : ret;
+}
+
+// moves up to count bytes from in to out without going through userspace.
+// reads from *off if it is not NULL, and from in's offset otherwise.
+static ssize_t do_splice(struct file *out, struct file *in, off_t *off,
+                         size_t count) {
+    if (out->fops->write == NULL) {
+        return -EPERM;
+    }
+
+    if (off != NULL && (in->fops->lseek == NULL || *off < 0)) {
+        return (in->fops->lseek == NULL)? -ESPIPE : -EINVAL;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    if (in->fops->peek == NULL) {
+        return splice_copy(out, in, off, count);
+    }
+
+    off_t pos = (off != NULL)? *off : in->offset;
+
+    size_t len;
+    const char *ptr = in->fops->peek(in, pos, &len);
+    if (ptr == NULL || len == 0) {
+        return 0;
+    }
+    len = MIN(len, count);
+
+    // pipes just point at the source, everything else copies once
+    ssize_t ret;
+    if (out->fops->write_ref != NULL) {
+        ret = out->fops->write_ref(out, ptr, len);
+    } else {
+        ret = out->fops->write(out, ptr, len);
+    }
+
+    if (ret > 0) {
+        if (off != NULL) {
+            *off += ret;
+        } else {
+            in->offset += ret;
+        }
+    }
+    return ret;
+}
+
+ssize_t sys_splice(int fd_in, int fd_out, size_t count) {
+    struct file *in = get_file(fd_in);
+    struct file *out = get_file(fd_out);
+    if (in == NULL || out == NULL) {
+        return -EBADF;
+    }
+
+    return do_splice(out, in, NULL, count);
+}
+
+ssize_t sys_sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    struct file *in = get_file(in_fd);
+    struct file *out = get_file(out_fd);
+    if (in == NULL || out == NULL) {
+        return -EBADF;
+    }
+
+    return do_splice(out, in, offset, count);
+}
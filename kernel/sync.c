@@ -3,37 +3,83 @@
 #include "arch/cpu.h"
 #include "kdebug.h"
 #include "kmalloc.h"
+#include <string.h>
 
 static ssize_t acq_depth = 0;
 
-void acquire_global(void) {
+static bool slocks = false;
+
+struct irqsoff_window irqsoff_windows[IRQSOFF_TOP];
+
+// the window that's open now
+static uint64_t off_start;
+static void *off_acquired_by;
+
+// keeps the longest, sorted longest first
+static void irqsoff_record(uint64_t cycles, void *released_by) {
+    if (cycles <= irqsoff_windows[IRQSOFF_TOP - 1].cycles) {
+        return;
+    }
+
+    size_t i = IRQSOFF_TOP - 1;
+    while (i > 0 && irqsoff_windows[i - 1].cycles < cycles) {
+        irqsoff_windows[i] = irqsoff_windows[i - 1];
+        --i;
+    }
+    irqsoff_windows[i].cycles = cycles;
+    irqsoff_windows[i].start = off_start;
+    irqsoff_windows[i].acquired_by = off_acquired_by;
+    irqsoff_windows[i].released_by = released_by;
+}
+
+void irqsoff_reset(void) {
+    acquire_global();
+    memset(irqsoff_windows, 0, sizeof(irqsoff_windows));
+    release_global();
+}
+
+void acquire_global_from(void *ra) {
     cli();
-    acq_depth++;
+    if (acq_depth++ == 0) {
+        off_start = read_cycles();
+        off_acquired_by = ra;
+    }
 }
 
-void release_global(void) {
+void release_global_from(void *ra) {
     cli();
     acq_depth--;
 
     kassert(acq_depth >= 0);
 
     if (acq_depth == 0) {
+        // kmain holds it through all of boot, which would crowd out the
+        // rest. so only once there are processes
+        if (slocks) {
+            irqsoff_record(read_cycles() - off_start, ra);
+        }
         sti();
     }
 }
 
+void acquire_global(void) {
+    acquire_global_from(__builtin_return_address(0));
+}
+
+void release_global(void) {
+    release_global_from(__builtin_return_address(0));
+}
+
 bool is_global_held(void) {
     return acq_depth != 0;
 }
 
-static bool slocks = false;
-
 void enable_sched_locks(void) {
     slocks = true;
 }
 
-void acquire_lock(petix_lock_t *lock) {
-    acquire_global();
+void acquire_lock_from(petix_lock_t *lock, void *ra) {
+    acquire_global_from(ra);
 
     if (slocks) {
         if (lock->locked && (lock->held_by == get_pid() || lock->global)) {
@@ -48,9 +94,9 @@ void acquire_lock(petix_lock_t *lock) {
             struct pcb *pcb = get_pcb(get_pid());
             pcb->rs = RS_BLOCKED;
 
-            release_global();
+            release_global_from(ra);
             sched();
-            acquire_lock(lock);
+            acquire_lock_from(lock, ra);
             return;
         } else {
             lock->locked = true;
@@ -64,11 +110,11 @@ void acquire_lock(petix_lock_t *lock) {
         lock->locked = true;
     }
 
-    release_global();
+    release_global_from(ra);
 }
 
-void release_lock(petix_lock_t *lock) {
-    acquire_global();
+void release_lock_from(petix_lock_t *lock, void *ra) {
+    acquire_global_from(ra);
 
     if (lock->global) {
         kassert(lock->locked == true);
@@ -93,11 +139,102 @@ void release_lock(petix_lock_t *lock) {
         }
     }
 
-    release_global();
+    release_global_from(ra);
 }
 
-void sem_signal(petix_sem_t *sem, size_t n) {
-    acquire_global();
+void acquire_lock(petix_lock_t *lock) {
+    acquire_lock_from(lock, __builtin_return_address(0));
+}
+
+void release_lock(petix_lock_t *lock) {
+    release_lock_from(lock, __builtin_return_address(0));
+}
+
+// blocks until woken by rwlock_wake. the global lock must be held, taken
+// at ra
+static void rwlock_sleep(petix_rwlock_t *lock, void *ra) {
+    struct proc_lst *nplist = kmalloc(sizeof(struct proc_lst));
+    nplist->pid = get_pid();
+    nplist->next = lock->lst;
+    lock->lst = nplist;
+
+    struct pcb *pcb = get_pcb(get_pid());
+    pcb->rs = RS_BLOCKED;
+
+    release_global_from(ra);
+    sched();
+    acquire_global_from(ra);
+}
+
+// wakes every waiter, they recheck the lock themselves
+static void rwlock_wake(petix_rwlock_t *lock) {
+    struct proc_lst *next;
+    for (struct proc_lst *lst = lock->lst; lst != NULL; lst = next) {
+        next = lst->next;
+        struct pcb *pcb = get_pcb(lst->pid);
+        if (pcb != NULL && pcb->rs == RS_BLOCKED) {
+            pcb->rs = RS_READY;
+        }
+        kfree(lst);
+    }
+    lock->lst = NULL;
+}
+
+void read_lock(petix_rwlock_t *lock) {
+    void *ra = __builtin_return_address(0);
+    acquire_global_from(ra);
+
+    // nothing can be waiting before the scheduler is running
+    while (lock->writer || lock->writers_waiting > 0) {
+        kassert(slocks);
+        rwlock_sleep(lock, ra);
+    }
+    lock->readers++;
+
+    release_global_from(ra);
+}
+
+void read_unlock(petix_rwlock_t *lock) {
+    void *ra = __builtin_return_address(0);
+    acquire_global_from(ra);
+
+    kassert(lock->readers > 0);
+    lock->readers--;
+    if (lock->readers == 0) {
+        rwlock_wake(lock);
+    }
+
+    release_global_from(ra);
+}
+
+void write_lock(petix_rwlock_t *lock) {
+    void *ra = __builtin_return_address(0);
+    acquire_global_from(ra);
+
+    lock->writers_waiting++;
+    while (lock->writer || lock->readers > 0) {
+        kassert(slocks);
+        rwlock_sleep(lock, ra);
+    }
+    lock->writers_waiting--;
+    lock->writer = true;
+
+    release_global_from(ra);
+}
+
+void write_unlock(petix_rwlock_t *lock) {
+    void *ra = __builtin_return_address(0);
+    acquire_global_from(ra);
+
+    kassert(lock->writer);
+    lock->writer = false;
+    rwlock_wake(lock);
+
+    release_global_from(ra);
+}
+
+static void sem_signal_from(petix_sem_t *sem, size_t n, void *ra) {
+    acquire_global_from(ra);
 
     if (n == 0) {
         sem->count = 1;
@@ -124,11 +261,11 @@ void sem_signal(petix_sem_t *sem, size_t n) {
     }
     sem->lst = onto;
 
-    release_global();
+    release_global_from(ra);
 }
 
-void sem_wait(petix_sem_t *sem, size_t n) {
-    acquire_global();
+static void sem_wait_from(petix_sem_t *sem, size_t n, void *ra) {
+    acquire_global_from(ra);
 
     if (n == 0) {
         n = 1;
@@ -150,18 +287,46 @@ void sem_wait(petix_sem_t *sem, size_t n) {
         sem->lst = nplist;
 
         pcb->rs = RS_BLOCKED;
-        release_global();
+        release_global_from(ra);
         sched();
-        acquire_global();
+        acquire_global_from(ra);
     }
 
-    release_global();
+    release_global_from(ra);
+}
+
+void sem_signal(petix_sem_t *sem, size_t n) {
+    sem_signal_from(sem, n, __builtin_return_address(0));
+}
+
+void sem_wait(petix_sem_t *sem, size_t n) {
+    sem_wait_from(sem, n, __builtin_return_address(0));
+}
+
+void waitq_wake(petix_waitq_t *q) {
+    void *ra = __builtin_return_address(0);
+    acquire_global_from(ra);
+
+    for (struct waitq_ent *ent = q->lst; ent != NULL; ent = ent->next) {
+        struct pcb *pcb = get_pcb(ent->pid);
+        if (pcb == NULL || !pcb->poll.waiting) {
+            continue;
+        }
+
+        // woken covers an event that arrives before the poller blocks
+        pcb->poll.woken = true;
+        if (pcb->rs == RS_BLOCKED) {
+            pcb->rs = RS_READY;
+        }
+    }
+
+    release_global_from(ra);
 }
 
 void cond_wake(petix_sem_t *sem) {
-    sem_signal(sem, 0);
+    sem_signal_from(sem, 0, __builtin_return_address(0));
 }
 
 void cond_wait(petix_sem_t *sem) {
-    sem_wait(sem, 0);
+    sem_wait_from(sem, 0, __builtin_return_address(0));
 }
@@ -3,12 +3,35 @@
 
 #include <sys/types.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 void acquire_global(void);
 void release_global(void);
 
+// the same, with ra recorded as where it happened. for wrappers to pass
+// their own caller, so the irqsoff windows don't all point at them
+void acquire_global_from(void *ra);
+void release_global_from(void *ra);
+
 bool is_global_held(void);
 
+// the longest stretches the global lock kept interrupts off, as cycles,
+// when they began, and where it was taken and let go. the cli on
+// interrupt entry, before a handler takes the lock, isn't seen
+#define IRQSOFF_TOP 16
+
+struct irqsoff_window {
+    uint64_t cycles; // 0 if unused
+    uint64_t start;
+    void *acquired_by;
+    void *released_by;
+};
+
+// sorted, longest first
+extern struct irqsoff_window irqsoff_windows[IRQSOFF_TOP];
+
+void irqsoff_reset(void);
+
 struct proc_lst {
     pid_t pid;
     struct proc_lst *next;
@@ -26,6 +49,21 @@ void enable_sched_locks(void);
 
 void acquire_lock(petix_lock_t *lock);
 void release_lock(petix_lock_t *lock);
+void acquire_lock_from(petix_lock_t *lock, void *ra);
+void release_lock_from(petix_lock_t *lock, void *ra);
+
+// many readers or one writer. waiting writers hold off new readers.
+typedef struct {
+    size_t readers;
+    bool writer;
+    size_t writers_waiting;
+    struct proc_lst *lst;
+} petix_rwlock_t;
+
+void read_lock(petix_rwlock_t *lock);
+void read_unlock(petix_rwlock_t *lock);
+void write_lock(petix_rwlock_t *lock);
+void write_unlock(petix_rwlock_t *lock);
 
 struct sem_proc_lst {
     pid_t pid;
@@ -46,5 +84,19 @@ void sem_wait(petix_sem_t *sem, size_t n);
 void cond_wake(petix_sem_t *sem);
 void cond_wait(petix_sem_t *sem);
 
+struct waitq_ent {
+    pid_t pid;
+    struct waitq_ent *next;
+};
+
+// processes sleeping in poll on some object. unlike a semaphore, a process
+// can be on many wait queues at once, and removes itself when it is done.
+typedef struct {
+    struct waitq_ent *lst;
+} petix_waitq_t;
+
+// wakes every process polling on q
+void waitq_wake(petix_waitq_t *q);
+
 
 #endif
@@ -9,10 +9,15 @@
 #include "fs.h"
 #include "kmalloc.h"
 #include "pipe.h"
+#include "ring.h"
+#include "vdata.h"
+#include "dcache.h"
+#include "block.h"
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include "mem.h"
 
 
@@ -21,25 +26,19 @@
 #pragma GCC diagnostic ignored "-Wincompatible-pointer-types"
 
 syscall_t syscall_table[256] = {
-    [SYS_NR_READ]    = sys_read,
-    [SYS_NR_WRITE]   = sys_write,
-    [SYS_NR_OPEN]    = sys_open,
-    [SYS_NR_CLOSE]   = sys_close,
-    [SYS_NR_WAITPID] = sys_waitpid,
-    [SYS_NR_DUP2]    = sys_dup2,
-    [SYS_NR_GETDENT] = sys_getdent,
-
-    [SYS_NR_IOCTL]   = sys_ioctl,
-
-    [SYS_NR_MMAP]    = sys_mmap,
-    [SYS_NR_CREAT]   = sys_creat,
-    [SYS_NR_MKDIR]   = sys_mkdir,
-    [SYS_NR_PIPE]    = sys_pipe,
-    [SYS_NR_SCHED_YIELD] = sys_sched_yield,
-    [SYS_NR_FORK]     = sys_fork,
-    [SYS_NR_EXEC]     = sys_exec,
-    [SYS_NR_EXIT]     = sys_exit,
-    [SYS_NR_DB_PRINT] = sys_db_print
+#define SYSCALL0(NAME, name, nr) [nr] = sys_##name,
+#define SYSCALL1(NAME, name, nr, ...) [nr] = sys_##name,
+#define SYSCALL2(NAME, name, nr, ...) [nr] = sys_##name,
+#define SYSCALL3(NAME, name, nr, ...) [nr] = sys_##name,
+#define SYSCALL4(NAME, name, nr, ...) [nr] = sys_##name,
+#define SYSCALL5(NAME, name, nr, ...) [nr] = sys_##name,
+#include <bits/syscall.def>
+#undef SYSCALL0
+#undef SYSCALL1
+#undef SYSCALL2
+#undef SYSCALL3
+#undef SYSCALL4
+#undef SYSCALL5
 };
 
 #pragma GCC diagnostic pop
@@ -76,6 +75,151 @@ ssize_t sys_write(ssize_t fd, const char *buf, size_t count) {
     return f->fops->write(f, buf, count);
 }
 
+static struct file *get_file(ssize_t fd) {
+    struct pcb *pcb = get_pcb(get_pid());
+
+    if (fd >= MAX_FDS || fd < 0) {
+        return NULL;
+    }
+    return pcb->fds[fd].file;
+}
+
+ssize_t sys_lseek(struct sys_lseek_args *args) {
+    struct file *f = get_file(args->fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    if (f->fops->lseek == NULL) {
+        return -ESPIPE;
+    }
+
+    off_t ret = f->fops->lseek(f, args->off, args->whence);
+    if (ret < 0) {
+        return ret;
+    }
+
+    args->off = ret;
+    return 0;
+}
+
+// positional io works on a copy of the file, so the shared offset is never
+// touched. only seekable files support it.
+ssize_t sys_pread(const struct sys_pread_args *args) {
+    struct file *f = get_file(args->fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    if (f->fops->lseek == NULL) {
+        return -ESPIPE;
+    }
+
+    if (f->fops->read == NULL) {
+        return -EPERM;
+    }
+
+    if (args->off < 0) {
+        return -EINVAL;
+    }
+
+    struct file tmp = *f;
+    tmp.offset = args->off;
+    return f->fops->read(&tmp, args->buf, args->count);
+}
+
+ssize_t sys_pwrite(const struct sys_pread_args *args) {
+    struct file *f = get_file(args->fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    if (f->fops->lseek == NULL) {
+        return -ESPIPE;
+    }
+
+    if (f->fops->write == NULL) {
+        return -EPERM;
+    }
+
+    if (args->off < 0) {
+        return -EINVAL;
+    }
+
+    struct file tmp = *f;
+    tmp.offset = args->off;
+    return f->fops->write(&tmp, args->buf, args->count);
+}
+
+ssize_t sys_readv(ssize_t fd, const struct iovec *iov, int iovcnt) {
+    struct file *f = get_file(fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    if (f->fops->read == NULL) {
+        return -EPERM;
+    }
+
+    if (iovcnt < 0 || iovcnt > IOV_MAX) {
+        return -EINVAL;
+    }
+
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+
+        ssize_t ret = f->fops->read(f, iov[i].iov_base, iov[i].iov_len);
+        if (ret < 0) {
+            return (total == 0)? ret : total;
+        }
+
+        total += ret;
+        // a short read means there is nothing more to scatter
+        if (ret < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+ssize_t sys_writev(ssize_t fd, const struct iovec *iov, int iovcnt) {
+    struct file *f = get_file(fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    if (f->fops->write == NULL) {
+        return -EPERM;
+    }
+
+    if (iovcnt < 0 || iovcnt > IOV_MAX) {
+        return -EINVAL;
+    }
+
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+
+        ssize_t ret = f->fops->write(f, iov[i].iov_base, iov[i].iov_len);
+        if (ret < 0) {
+            return (total == 0)? ret : total;
+        }
+
+        total += ret;
+        if (ret < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
 ssize_t sys_open(const char *path, int flags, int mode) {
     ssize_t err;
     struct pcb *pcb = get_pcb(get_pid());
@@ -100,6 +244,7 @@ ssize_t sys_open(const char *path, int flags, int mode) {
         release_fd(pcb, fd);
         return err;
     }
+    pcb->fds[fd].file->flags = flags & O_NONBLOCK;
 
     return fd;
 }
@@ -115,6 +260,29 @@ ssize_t sys_close(ssize_t fd) {
     return 0;
 }
 
+ssize_t sys_fcntl(ssize_t fd, int cmd, int arg) {
+    struct pcb *pcb = get_pcb(get_pid());
+    struct file *f = get_file(fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    if (cmd == F_GETFD) {
+        return pcb->fds[fd].cloexec? FD_CLOEXEC : 0;
+    } else if (cmd == F_SETFD) {
+        pcb->fds[fd].cloexec = (arg & FD_CLOEXEC) != 0;
+        return 0;
+    } else if (cmd == F_GETFL) {
+        return f->flags;
+    } else if (cmd == F_SETFL) {
+        // O_NONBLOCK is the only status flag that can change
+        f->flags = arg & O_NONBLOCK;
+        return 0;
+    } else {
+        return -EINVAL;
+    }
+}
+
 ssize_t sys_dup2(ssize_t fd, ssize_t fd2) {
     struct pcb *pcb = get_pcb(get_pid());
     if (fd >= MAX_FDS || fd < 0 || pcb->fds[fd].file == NULL) {
@@ -158,6 +326,78 @@ ssize_t sys_getdent(ssize_t fd, struct petix_dirent *dent) {
     return f->fops->getdent(f, dent);
 }
 
+// filesystems without a getdents hook fall back to getdent, without the
+// stat fields
+static ssize_t getdents_fallback(struct file *f, char *buf, size_t len) {
+    size_t used = 0;
+    while (1) {
+        off_t off = f->offset;
+
+        struct petix_dirent d;
+        int ret = f->fops->getdent(f, &d);
+        if (ret < 0) {
+            return (used > 0)? (ssize_t) used : ret;
+        }
+        if (!d.present) {
+            break;
+        }
+
+        size_t reclen = fs_put_dirent(buf + used, len - used, d.name, NULL);
+        if (reclen == 0) {
+            // give the entry back for the next call
+            f->offset = off;
+            if (used == 0) {
+                return -EINVAL;
+            }
+            break;
+        }
+        used += reclen;
+    }
+    return used;
+}
+
+ssize_t sys_getdents(ssize_t fd, void *buf, size_t len) {
+    struct file *f = get_file(fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    if (f->inode.ftype != FT_DIR) {
+        return -ENOTDIR;
+    }
+
+    if (f->fops->getdents != NULL) {
+        return f->fops->getdents(f, buf, len);
+    } else if (f->fops->getdent != NULL) {
+        return getdents_fallback(f, buf, len);
+    }
+    return -EPERM;
+}
+
+ssize_t sys_stat(const char *path, struct stat *st) {
+    struct inode in;
+    int err = fs_lookup(path, &in);
+    if (err < 0) {
+        return err;
+    }
+
+    fs_stat(&in, st);
+    return 0;
+}
+
+ssize_t sys_fstat(ssize_t fd, struct stat *st) {
+    struct file *f = get_file(fd);
+    if (f == NULL) {
+        return -EBADF;
+    }
+
+    fs_stat(&(f->inode), st);
+    if (f->inode.ftype == FT_FIFO) {
+        st->st_blksize = PIPE_SIZE;
+    }
+    return 0;
+}
+
 static const char *empty_string = "";
 static void split_dir_path(char *path, char const **dir, char const **name) {
     *name = path;
@@ -198,7 +438,13 @@ ssize_t sys_creat(const char *path) {
         return -EPERM;
     }
 
-    return inode.fs->iops->creat(&inode, name);
+    rc = inode.fs->iops->creat(&inode, name);
+    if (rc >= 0) {
+        // the directory may have grown, as well
+        dcache_invalidate(path);
+        dcache_invalidate(dir);
+    }
+    return rc;
 }
 
 ssize_t sys_mkdir(const char *path) {
@@ -224,7 +470,13 @@ ssize_t sys_mkdir(const char *path) {
         return -EPERM;
     }
 
-    return inode.fs->iops->mkdir(&inode, name);
+    rc = inode.fs->iops->mkdir(&inode, name);
+    if (rc >= 0) {
+        // the directory may have grown, as well
+        dcache_invalidate(path);
+        dcache_invalidate(dir);
+    }
+    return rc;
 }
 
 ssize_t sys_pipe(int filedes[2], size_t flags) {
@@ -241,6 +493,8 @@ ssize_t sys_pipe(int filedes[2], size_t flags) {
     }
 
     open_pipe(pcb->fds[fd1].file, pcb->fds[fd2].file);
+    pcb->fds[fd1].file->flags = flags & O_NONBLOCK;
+    pcb->fds[fd2].file->flags = flags & O_NONBLOCK;
     if (flags & O_CLOEXEC) {
         pcb->fds[fd1].cloexec = true;
         pcb->fds[fd2].cloexec = true;
@@ -302,34 +556,35 @@ ssize_t sys_ioctl(ssize_t fd, size_t req, ...) {
     return f->fops->ioctl(f, req, ap);
 }
 
-void *sys_mmap(void *addr, size_t len, size_t prot, size_t flags,
-               int fd, off_t off, int *errno) {
-
-    if (len == 0) {
-        *errno = EINVAL;
-        return MAP_FAILED;
+ssize_t sys_mmap(const struct sys_mmap_args *args) {
+    if (args->len == 0) {
+        return -EINVAL;
     }
 
-    if ((uintptr_t)addr & (PAGE_SIZE-1)) {
-        *errno = EINVAL;
-        return MAP_FAILED;
+    if ((uintptr_t)args->addr & (PAGE_SIZE-1)) {
+        return -EINVAL;
     }
 
     struct pcb *pcb = get_pcb(get_pid());
 
+    int fd = args->fd;
     if (fd >= MAX_FDS || fd < 0 || pcb->fds[fd].file == NULL) {
-        *errno = EBADF;
-        return MAP_FAILED;
+        return -EBADF;
     }
 
     struct file *f = pcb->fds[fd].file;
 
     if (f->fops->mmap == NULL) {
-        *errno = ENODEV;
-        return MAP_FAILED;
+        return -ENODEV;
     }
 
-    return f->fops->mmap(f, addr, len, prot, flags, off, errno);
+    int err = 0;
+    void *ret = f->fops->mmap(f, args->addr, args->len, args->prot,
+                              args->flags, args->off, &err);
+    if (ret == MAP_FAILED) {
+        return -err;
+    }
+    return (ssize_t) ret;
 }
 
 ssize_t sys_db_print(const char *str) {
@@ -342,6 +597,18 @@ ssize_t sys_sched_yield(void) {
     return 0;
 }
 
+ssize_t sys_getpid(void) {
+    return get_pid();
+}
+
+ssize_t sys_sync(void) {
+    return block_sync(NULL);
+}
+
+ssize_t sys_getppid(void) {
+    return get_pcb(get_pid())->ppid;
+}
+
 ssize_t sys_fork(void) {
     struct pcb *old = get_pcb(get_pid());
     struct pcb *new = alloc_proc();
@@ -354,6 +621,8 @@ ssize_t sys_fork(void) {
     new->ppid = old->pid;
     new->rs = RS_READY;
     memcpy(new->fds, old->fds, sizeof(new->fds));
+    // the child comes back through the parent's handler frames
+    new->away_cycles = old->away_cycles;
 
     for (size_t i = 0; i < MAX_FDS; ++i) {
         if (new->fds[i].file != NULL) {
@@ -367,6 +636,8 @@ ssize_t sys_fork(void) {
         release_global();
         return 0;
     } else {
+        ring_fork(old, new);
+        vdata_proc_init(new);
         release_global();
         return new->pid;
     }
@@ -410,24 +681,47 @@ ssize_t sys_exec(const char *path, char *const argv[], char *const envp[]) {
         return -EPERM;
     }
 
-    void *data = kmalloc_sync(f.size);
-    err = f.fops->read(&f, data, f.size);
-    if (err < 0) {
-        return err;
+    // files in permanent memory (the initrd) are used in place, so their
+    // read-only segments can be mapped instead of copied
+    void *data = NULL;
+    size_t avail = 0;
+    if (f.fops->peek != NULL) {
+        data = (void *) f.fops->peek(&f, 0, &avail);
+    }
+    bool in_place = data != NULL && avail == (size_t) f.size;
+
+    if (!in_place) {
+        data = kmalloc_sync(f.size);
+        err = f.fops->read(&f, data, f.size);
+        if (err < 0) {
+            return err;
+        }
     }
     if (f.fops->close != NULL) {
         f.fops->close(&f);
     }
 
     char *cdata = data;
-    if (cdata[0] == '#' && cdata[1] == '!') {
-        //TODO dont read the whole file to check this
+    if (f.size >= 2 && cdata[0] == '#' && cdata[1] == '!') {
+        // the data may be the initrd itself, so tokenize a copy
+        char line[128];
+        size_t n = f.size - 2;
+        if (n > sizeof(line) - 1) {
+            n = sizeof(line) - 1;
+        }
+        memcpy(line, cdata+2, n);
+        line[n] = '\0';
+
         char *save;
-        char *script = strtok_r(cdata+2, " \n\t", &save);
+        char *script = strtok_r(line, " \n\t", &save);
         //TODO standardize this somewhere
-        char scbuff[128];
-        strncpy(scbuff, script, sizeof(scbuff));
-        kfree_sync(data);
+        char scbuff[128] = {0};
+        if (script != NULL) {
+            strncpy(scbuff, script, sizeof(scbuff) - 1);
+        }
+        if (!in_place) {
+            kfree_sync(data);
+        }
 
         char *newargv[128] = {NULL};
         newargv[0] = scbuff;
@@ -438,9 +732,16 @@ ssize_t sys_exec(const char *path, char *const argv[], char *const envp[]) {
     }
 
     if (!check_elf_header(data)) {
+        if (!in_place) {
+            kfree_sync(data);
+        }
         return -ENOEXEC;
     }
 
+    // past here the exec can't fail, and the new image may want the
+    // page back
+    ring_release(pcb);
+
     // push args;
     size_t argc = 0;
     if (argv != NULL) {
@@ -479,9 +780,11 @@ ssize_t sys_exec(const char *path, char *const argv[], char *const envp[]) {
     // actually copy over data after loading the arguments, or the
     // processes address space will be damaged, and we will get
     // incorrect arguments
-    uintptr_t entry = load_elf_file(data);
+    uintptr_t entry = load_elf_file(data, in_place);
 
-    kfree_sync(data);
+    if (!in_place) {
+        kfree_sync(data);
+    }
 
     jump_to_userspace((void *)entry, (void *)sp);
     // should be unreachable
@@ -514,6 +817,7 @@ ssize_t sys_exit(size_t code) {
     }
 
     pcb->rs = RS_TERMINATED;
+    ring_release(pcb);
     free_proc_addr_space(pcb->addr_space);
 
     pcb->addr_space = NULL;
@@ -3,6 +3,7 @@
 
 #include <sys/types.h>
 #include <stddef.h>
+#include <sys/syscall.h>
 
 typedef ssize_t (*syscall_t)();
 
@@ -15,9 +16,19 @@ ssize_t sys_write(ssize_t fd, const char *buf, size_t count);
 ssize_t sys_open(const char *path, int flags, int mode);
 ssize_t sys_close(ssize_t fd);
 
+ssize_t sys_lseek(struct sys_lseek_args *args);
+ssize_t sys_pread(const struct sys_pread_args *args);
+ssize_t sys_pwrite(const struct sys_pread_args *args);
+ssize_t sys_readv(ssize_t fd, const struct iovec *iov, int iovcnt);
+ssize_t sys_writev(ssize_t fd, const struct iovec *iov, int iovcnt);
+
+ssize_t sys_fcntl(ssize_t fd, int cmd, int arg);
 ssize_t sys_dup2(ssize_t fd, ssize_t fd2);
 
 ssize_t sys_getdent(ssize_t fd, struct petix_dirent *dent);
+ssize_t sys_getdents(ssize_t fd, void *buf, size_t len);
+ssize_t sys_stat(const char *path, struct stat *st);
+ssize_t sys_fstat(ssize_t fd, struct stat *st);
 ssize_t sys_creat(const char *path);
 ssize_t sys_mkdir(const char *path);
 
@@ -27,13 +38,24 @@ ssize_t sys_waitpid(pid_t pid, int *wstatus, int options);
 
 ssize_t sys_ioctl(ssize_t fd, size_t req, ...);
 
-void *sys_mmap(void *addr, size_t len, size_t prot, size_t flags,
-               int filedes, off_t off, int *errno);
+// returns the mapped address, or -errno (see SYSCALL_IS_ERR)
+ssize_t sys_mmap(const struct sys_mmap_args *args);
+
+ssize_t sys_ring_setup(struct petix_ring *uaddr, int flags);
+ssize_t sys_ring_enter(unsigned to_submit);
+ssize_t sys_splice(int fd_in, int fd_out, size_t count);
+ssize_t sys_sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+ssize_t sys_poll(struct pollfd *fds, nfds_t nfds, int timeout);
 
 ssize_t sys_sched_yield(void);
+ssize_t sys_getpid(void);
+ssize_t sys_getppid(void);
 ssize_t sys_fork(void);
 ssize_t sys_exec(const char *path, char *const argv[], char *const envp[]);
 ssize_t sys_exit(size_t code);
 
+// writes back every dirty block
+ssize_t sys_sync(void);
+
 
 #endif
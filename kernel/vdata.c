@@ -0,0 +1,77 @@
+#include "vdata.h"
+#include "arch/paging.h"
+#include "kdebug.h"
+#include "sync.h"
+#include "arch/cpu.h"
+
+static union {
+    struct petix_vdata data;
+    char page[4096];
+} vdata __attribute__((aligned(4096)));
+
+#define barrier() asm volatile ("" ::: "memory")
+
+void vdata_init(void) {
+    // the kernel is identity mapped, so this is also the physical address
+    map_shared_user_page((void *) VDATA_ADDR, &vdata);
+
+    // the biggest shift that keeps mult in 32 bits, for the most precision
+    uint64_t hz = cycles_hz();
+    if (hz != 0) {
+        uint32_t shift = 32;
+        while (shift > 0 && (1000000000ull << shift) / hz > 0xffffffff) {
+            --shift;
+        }
+        vdata.data.tsc_mult = (1000000000ull << shift) / hz;
+        vdata.data.tsc_shift = shift;
+        // before the first tick, so mono_ns is still 0
+        vdata.data.tsc_base = read_cycles();
+    }
+
+    vdata.data.boot_realtime_ns = read_rtc() * 1000000000ull
+                                  - vdata.data.mono_ns;
+}
+
+static uint64_t tsc_ns(uint64_t now) {
+    return vdata_cycles_to_ns(now - vdata.data.tsc_base, vdata.data.tsc_mult,
+                              vdata.data.tsc_shift);
+}
+
+void vdata_tick(uint32_t tick_ns) {
+    // runs in the timer interrupt, so there is only ever one writer
+    vdata.data.seq++;
+    barrier();
+
+    vdata.data.ticks++;
+    if (vdata.data.tsc_mult != 0) {
+        vdata.data.mono_ns = tsc_ns(read_cycles());
+    } else {
+        vdata.data.mono_ns += tick_ns;
+    }
+    vdata.data.tick_ns = tick_ns;
+
+    barrier();
+    vdata.data.seq++;
+}
+
+uint64_t vdata_monotonic_ns(void) {
+    acquire_global();
+    uint64_t ns = vdata.data.mono_ns;
+    if (vdata.data.tsc_mult != 0) {
+        ns = tsc_ns(read_cycles());
+    }
+    release_global();
+    return ns;
+}
+
+void vdata_proc_init(struct pcb *pcb) {
+    struct petix_vdata_proc *proc =
+        get_user_page(pcb->addr_space, (void *) VDATA_PROC_ADDR);
+
+    if (proc == NULL) {
+        proc = alloc_user_page_ro(pcb->addr_space, (void *) VDATA_PROC_ADDR);
+    }
+
+    proc->pid = pcb->pid;
+    proc->ppid = pcb->ppid;
+}
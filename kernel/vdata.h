@@ -0,0 +1,18 @@
+#ifndef VDATA_H
+#define VDATA_H
+
+#include <sys/vdata.h>
+#include <stdint.h>
+#include "proc.h"
+
+// maps the shared page into every address space. must be used before
+// init_proc
+void vdata_init(void);
+
+// called from the timer interrupt
+void vdata_tick(uint32_t tick_ns);
+
+// fills in the per-process page of a new (or newly forked) process
+void vdata_proc_init(struct pcb *pcb);
+
+#endif
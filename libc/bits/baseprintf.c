@@ -1,126 +1,136 @@
 #include <bits/baseprintf.h>
 #include <stdint.h>
+#include <stdbool.h>
 
-static void puts(base_printf_putc_t putfn, void *special,
-                 const char *str) {
-
-    for (; *str != 0; ++str) {
+static int puts(base_printf_putc_t putfn, void *special,
+                const char *str) {
+    int n = 0;
+    for (; *str != 0; ++str, ++n) {
         putfn(*str, special);
     }
+    return n;
 }
 
-static void putuintnz(base_printf_putc_t putfn, void *special,
-                      unsigned long num) {
-    if (num != 0) {
-        putuintnz(putfn, special, num/10);
-        putfn((num % 10) + '0', special);
+// num in base 10 or 16, padded on the left with pad to width
+static int putnum(base_printf_putc_t putfn, void *special,
+                  unsigned long long num, unsigned base, bool upper,
+                  int width, char pad) {
+    const char *digits = upper? "0123456789ABCDEF" : "0123456789abcdef";
+    char buf[20]; // 2^64 in base 10
+    int len = 0;
+    do {
+        buf[len++] = digits[num % base];
+        num /= base;
+    } while (num != 0);
+
+    int n = 0;
+    for (; n < width - len; ++n) {
+        putfn(pad, special);
+    }
+    while (len > 0) {
+        putfn(buf[--len], special);
+        ++n;
     }
+    return n;
 }
 
-
-static void putuint(base_printf_putc_t putfn, void *special,
-                    unsigned long num) {
-    if (num == 0) {
-        putfn('0', special);
-    } else {
-        putuintnz(putfn, special, num);
+static int putint(base_printf_putc_t putfn, void *special,
+                  long long num, int width, char pad) {
+    if (num >= 0) {
+        return putnum(putfn, special, num, 10, false, width, pad);
     }
-}
 
-static void putint(base_printf_putc_t putfn, void *special,
-                   long num) {
-    if (num < 0) {
-        putfn('-', special);
-        putuint(putfn, special, -num);
-    } else {
-        putuint(putfn, special, num);
+    unsigned long long u = -(unsigned long long) num;
+    int n = 0;
+    if (pad == ' ') {
+        // spaces go before the sign, zeros after it
+        int len = 1;
+        for (unsigned long long t = u; t >= 10; t /= 10) {
+            ++len;
+        }
+        for (; n < width - len - 1; ++n) {
+            putfn(' ', special);
+        }
     }
+    putfn('-', special);
+    return n + 1 + putnum(putfn, special, u, 10, false, width - n - 1, pad);
 }
 
-static void puthex(base_printf_putc_t putfn, void *special,
-                   unsigned long n) {
+// %p is always 0x and every digit
+static int putptr(base_printf_putc_t putfn, void *special, uintptr_t n) {
     putfn('0', special);
     putfn('x', special);
-    for (int i = 2*sizeof(n) - 1; i >= 0; --i) {
-        int dig = (n >> (i*4)) & 0xf;
-        if (dig < 10) {
-            putfn(dig + '0', special);
-        } else {
-            putfn((dig-10) + 'A', special);
-        }
-    }
+    return 2 + putnum(putfn, special, n, 16, true, 2*sizeof(n), '0');
 }
 
+// supports %d %i %u %x %X with an optional 0 flag, width and l or ll, plus
+// %s %c %p and %%. returns how many characters were written
 int base_vprintf(base_printf_putc_t putfn, void *special,
                  const char *format, va_list ap) {
-
+    int n = 0;
     for (const char *ch = format; *ch != 0; ++ch) {
-        if (*ch == '%') {
+        if (*ch != '%') {
+            putfn(*ch, special);
+            ++n;
+            continue;
+        }
+        ++ch;
+
+        char pad = ' ';
+        if (*ch == '0') {
+            pad = '0';
             ++ch;
-            if (*(ch) == 'l') {
-                ++ch;
-                if (*(ch) == 'l') {
-                    ++ch;
-                    switch (*ch) {
-                    case 'd':
-                    case 'i':
-                        putint(putfn, special, va_arg(ap, long long int));
-                        break;
-                    case 'u':
-                        putuint(putfn, special, va_arg(ap, long long unsigned int));
-                        break;
-                    case 'x':
-                    case 'X':
-                        puthex(putfn, special, va_arg(ap, long long unsigned int));
-                        break;
-                    }
-                } else {
-                    switch (*ch) {
-                    case 'd':
-                    case 'i':
-                        putint(putfn, special, va_arg(ap, long int));
-                        break;
-                    case 'u':
-                        putuint(putfn, special, va_arg(ap, long unsigned int));
-                        break;
-                    case 'x':
-                    case 'X':
-                        puthex(putfn, special, va_arg(ap, long unsigned int));
-                        break;
-                    }
-                }
+        }
+        int width = 0;
+        for (; *ch >= '0' && *ch <= '9'; ++ch) {
+            width = width*10 + (*ch - '0');
+        }
+        int longs = 0;
+        for (; *ch == 'l' && longs < 2; ++ch) {
+            ++longs;
+        }
+
+        long long sval = 0;
+        unsigned long long uval = 0;
+        if (*ch == 'd' || *ch == 'i') {
+            sval = (longs == 2)? va_arg(ap, long long)
+                 : (longs == 1)? va_arg(ap, long) : va_arg(ap, int);
+        } else if (*ch == 'u' || *ch == 'x' || *ch == 'X') {
+            uval = (longs == 2)? va_arg(ap, unsigned long long)
+                 : (longs == 1)? va_arg(ap, unsigned long)
+                 : va_arg(ap, unsigned int);
+        }
 
-            } else {
-                switch (*ch) {
-                case '%':
-                    putfn(*ch, special);
-                    break;
-                case 'd':
-                case 'i':
-                    putint(putfn, special, va_arg(ap, int));
-                    break;
-                case 'u':
-                    putuint(putfn, special, va_arg(ap, unsigned int));
-                    break;
-                case 's':
-                    puts(putfn, special, va_arg(ap, const char *));
-                    break;
-                case 'c':
-                    putfn(va_arg(ap, int), special);
-                    break;
-                case 'p':
-                    puthex(putfn, special, va_arg(ap, uintptr_t));
-                    break;
-                case 'x':
-                case 'X':
-                    puthex(putfn, special, va_arg(ap, unsigned int));
-                    break;
-                }
-            }
-        } else {
+        switch (*ch) {
+        case '%':
             putfn(*ch, special);
+            ++n;
+            break;
+        case 'd':
+        case 'i':
+            n += putint(putfn, special, sval, width, pad);
+            break;
+        case 'u':
+            n += putnum(putfn, special, uval, 10, false, width, pad);
+            break;
+        case 'x':
+        case 'X':
+            n += putnum(putfn, special, uval, 16, *ch == 'X', width, pad);
+            break;
+        case 's':
+            n += puts(putfn, special, va_arg(ap, const char *));
+            break;
+        case 'c':
+            putfn(va_arg(ap, int), special);
+            ++n;
+            break;
+        case 'p':
+            n += putptr(putfn, special, va_arg(ap, uintptr_t));
+            break;
+        case '\0':
+            // a lone % at the end
+            return n;
         }
     }
-    //TODO
-    return 0;
+    return n;
 }
@@ -2,5 +2,5 @@
 #include <sys/syscall.h>
 
 int getdent(int fd, struct petix_dirent *dent) {
-    return raw_syscall_errno(SYS_NR_GETDENT, fd, dent);
+    return __syscall_errno(__sys_getdent(fd, dent));
 }
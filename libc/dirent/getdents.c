@@ -0,0 +1,6 @@
+#include <dirent.h>
+#include <sys/syscall.h>
+
+ssize_t getdents(int fd, void *buf, size_t len) {
+    return __syscall_errno(__sys_getdents(fd, buf, len));
+}
@@ -0,0 +1,17 @@
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <stdarg.h>
+
+int fcntl(int fd, int cmd, ...) {
+    va_list v;
+    va_start(v, cmd);
+
+    // every command we support takes an int or nothing
+    int arg = 0;
+    if (cmd == F_SETFD || cmd == F_SETFL) {
+        arg = va_arg(v, int);
+    }
+    va_end(v);
+
+    return __syscall_errno(__sys_fcntl(fd, cmd, arg));
+}
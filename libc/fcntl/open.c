@@ -4,5 +4,5 @@
 
 int open(const char *path, int flags, ...) {
     //TODO modes?
-    return raw_syscall_errno(SYS_NR_OPEN, path, flags, 0);
+    return __syscall_errno(__sys_open(path, flags, 0));
 }
@@ -0,0 +1,11 @@
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+
+ssize_t splice(int fd_in, int fd_out, size_t len) {
+    return __syscall_errno(__sys_splice(fd_in, fd_out, len));
+}
+
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    return __syscall_errno(__sys_sendfile(out_fd, in_fd, offset, count));
+}
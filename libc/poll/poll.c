@@ -0,0 +1,6 @@
+#include <poll.h>
+#include <sys/syscall.h>
+
+int poll(struct pollfd fds[], nfds_t nfds, int timeout) {
+    return __syscall_errno(__sys_poll(fds, nfds, timeout));
+}
@@ -1,5 +1,42 @@
 #include "file.h"
+#include <sys/uio.h>
 
+ssize_t stdio_flush_with(FILE *stream, const void *ptr, size_t n) {
+    // the buffer and the payload go out in a single syscall
+    struct iovec iov[2] = {
+        { .iov_base = stream->buffer, .iov_len = stream->end },
+        { .iov_base = (void *) ptr,   .iov_len = n },
+    };
+
+    struct iovec *cur = iov;
+    int cnt = 2;
+    while (cnt > 0) {
+        if (cur->iov_len == 0) {
+            ++cur;
+            --cnt;
+            continue;
+        }
+
+        ssize_t ret = writev(stream->fd, cur, cnt);
+        if (ret == -1) {
+            stream->err = errno;
+            stream->end = 0;
+            return -1;
+        }
+
+        // skip what was written, the rest goes out on the next iteration
+        for (; cnt > 0 && ret >= cur->iov_len; ++cur, --cnt) {
+            ret -= cur->iov_len;
+        }
+        if (cnt > 0) {
+            cur->iov_base = (char *) cur->iov_base + ret;
+            cur->iov_len -= ret;
+        }
+    }
+
+    stream->end = 0;
+    return n;
+}
 
 int fflush(FILE *stream) {
     if (!stream->valid) {
@@ -7,8 +44,9 @@ int fflush(FILE *stream) {
         return EOF;
     }
 
-    write(stream->fd, stream->buffer, stream->end);
-    stream->end = 0;
+    if (stdio_flush_with(stream, NULL, 0) == -1) {
+        return EOF;
+    }
 
     return 0;
 }
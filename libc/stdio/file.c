@@ -2,11 +2,11 @@
 
 FILE stdio_files[FOPEN_MAX] = {
     { .fd = STDIN_FILENO, .err = 0, .bf = _IONBF, .start = 0,
-      .end = 0, .valid = true },
+      .end = 0, .bufsize = BUFSIZ, .valid = true },
     { .fd = STDOUT_FILENO, .err = 0, .bf = _IOLBF, .start = 0,
-      .end = 0, .valid = true },
+      .end = 0, .bufsize = BUFSIZ, .valid = true },
     { .fd = STDERR_FILENO, .err = 0, .bf = _IONBF, .start = 0,
-      .end = 0, .valid = true },
+      .end = 0, .bufsize = BUFSIZ, .valid = true },
 };
 
 FILE *stdin = &(stdio_files[0]);
@@ -13,9 +13,14 @@ struct _stdio_file {
     bool valid;
     bool eof;
     size_t start, end;
+    size_t bufsize; // how much of buffer is used, from st_blksize
     char buffer[BUFSIZ];
 };
 
 extern FILE stdio_files[FOPEN_MAX];
 
+// writes out the buffer followed by n bytes of ptr, then empties the buffer.
+// returns n or -1.
+ssize_t stdio_flush_with(FILE *stream, const void *ptr, size_t n);
+
 #endif
@@ -1,5 +1,6 @@
 #include "file.h"
 #include <fcntl.h>
+#include <sys/stat.h>
 
 FILE *fopen(const char *path, const char *mode) {
     for (size_t i = 0; i < FOPEN_MAX; ++i) {
@@ -14,7 +15,21 @@ FILE *fopen(const char *path, const char *mode) {
             f->err = 0;
             f->valid = true;
             f->eof = false;
-            f->bf = _IOFBF;
+            f->start = 0;
+            f->end = 0;
+            // ttys are line buffered like stdout. reads and writes go in
+            // the file's own block size, up to what the buffer holds
+            struct stat st;
+            bool known = fstat(f->fd, &st) == 0;
+            if (known && S_ISCHR(st.st_mode)) {
+                f->bf = _IOLBF;
+            } else {
+                f->bf = _IOFBF;
+            }
+            f->bufsize = BUFSIZ;
+            if (known && st.st_blksize > 0 && st.st_blksize < BUFSIZ) {
+                f->bufsize = st.st_blksize;
+            }
             return f;
         }
     }
@@ -23,7 +23,7 @@ size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
             stream->start += bufread;
             cptr += bufread;
 
-            if (total > BUFSIZ) {
+            if (total > stream->bufsize) {
                 int r = read(stream->fd, cptr, total);
                 if (r == -1) {
                     ret = -1;
@@ -33,7 +33,7 @@ size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
                 break;
             } else if (total > 0) {
                 stream->start = 0;
-                int r = read(stream->fd, stream->buffer, BUFSIZ);
+                int r = read(stream->fd, stream->buffer, stream->bufsize);
                 if (r == -1) {
                     ret = -1;
                     break;
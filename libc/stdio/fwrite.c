@@ -21,26 +21,17 @@ size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream) {
         bool flushnl = (stream->bf == _IOLBF)
             && (memchr(ptr, '\n', size*nmemb) != NULL);
 
-        if (size*nmemb + stream->end <= BUFSIZ && !flushnl) {
+        if (size*nmemb + stream->end <= stream->bufsize && !flushnl) {
             memcpy(stream->buffer + stream->end, ptr, size*nmemb);
             stream->end += size*nmemb;
             return size*nmemb;
         } else {
-            int r1 = write(stream->fd, stream->buffer, stream->end);
-            if (r1 == -1) {
-                stream->err = r1;
+            ssize_t ret = stdio_flush_with(stream, ptr, size*nmemb);
+            if (ret == -1) {
                 return 0;
             }
 
-            stream->end = 0;
-
-            int r2 = write(stream->fd, ptr, size*nmemb);
-            if (r2 == -1) {
-                stream->err = r2;
-                return r1;
-            }
-
-            return r1+r2;
+            return ret;
         }
 
     }
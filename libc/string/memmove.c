@@ -0,0 +1,17 @@
+#include <string.h>
+
+void *memmove(void *s1, const void *s2, size_t n) {
+    char *cs1 = s1;
+    const char *cs2 = s2;
+    if (cs1 < cs2) {
+        for (size_t i = 0; i < n; ++i) {
+            cs1[i] = cs2[i];
+        }
+    } else {
+        // copy from the end, so an overlapping source isn't overwritten
+        for (size_t i = n; i > 0; --i) {
+            cs1[i-1] = cs2[i-1];
+        }
+    }
+    return s1;
+}
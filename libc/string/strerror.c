@@ -12,14 +12,22 @@ static const char * const errtab[] = {
     [EBADF]  = "Bad file descriptor",
     [ECHILD] = "No child processes",
     [EAGAIN] = "Resource temporarily unavailable",
+    [ENOMEM] = "Cannot allocate memory",
     [EACCES] = "Permission denied",
     [EFAULT] = "Bad address",
+    [EBUSY]  = "Device or resource busy",
+    [EEXIST] = "File exists",
     [ENODEV] = "No such device",
     [ENOTDIR] = "Not a directory",
     [EISDIR] = "Is a directory",
     [EINVAL] = "Invalid argument",
     [EMFILE] = "Too many open files",
     [ENOTTY] = "Inappropriate ioctl for device",
+    [EFBIG]  = "File too large",
+    [ENOSPC] = "No space left on device",
+    [ESPIPE] = "Illegal seek",
+    [EPIPE]  = "Broken pipe",
+    [ENAMETOOLONG] = "File name too long",
     [ENOSYS] = "Function not Implemented",
     [ENOTSUP] = "Operation not supported",
 };
@@ -11,6 +11,7 @@ int ioctl(int fd, unsigned long request, ...) {
     size_t a = va_arg(v, size_t);
     size_t b = va_arg(v, size_t);
     size_t c = va_arg(v, size_t);
+    va_end(v);
 
-    return raw_syscall_errno(SYS_NR_IOCTL, fd, request, a, b, c);
+    return __syscall_errno(__sys_ioctl(fd, request, a, b, c));
 }
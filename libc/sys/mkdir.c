@@ -3,5 +3,5 @@
 
 int mkdir(const char *pathname, mode_t mode) {
     //TODO modes?
-    return raw_syscall_errno(SYS_NR_MKDIR, pathname);
+    return __syscall_errno(__sys_mkdir(pathname));
 }
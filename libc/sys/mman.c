@@ -5,6 +5,20 @@
 void *mmap(void *addr, size_t len, int prot, int flags,
            int fildes, off_t off) {
 
-    return (void *) raw_syscall(SYS_NR_MMAP, addr, len, prot, flags,
-                                fildes, off, &errno);
+    // too wide for registers, see <bits/syscall.def>
+    struct sys_mmap_args args = {
+        .addr = addr,
+        .len = len,
+        .prot = prot,
+        .flags = flags,
+        .fd = fildes,
+        .off = off,
+    };
+
+    ssize_t ret = __sys_mmap(&args);
+    if (SYSCALL_IS_ERR(ret)) {
+        errno = -ret;
+        return MAP_FAILED;
+    }
+    return (void *) ret;
 }
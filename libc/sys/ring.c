@@ -0,0 +1,46 @@
+#include <sys/ring.h>
+#include <sys/syscall.h>
+
+// the kernel replaces this whole page, so nothing else may live in it
+static union {
+    struct petix_ring ring;
+    char page[4096];
+} ring_page __attribute__((aligned(4096)));
+
+// entries handed out by ring_get_sqe but not yet published to the kernel
+static uint32_t local_tail;
+
+struct petix_ring *ring_setup(int flags) {
+    if (__syscall_errno(__sys_ring_setup(&ring_page.ring, flags)) == -1) {
+        return NULL;
+    }
+    local_tail = 0;
+    return &ring_page.ring;
+}
+
+int ring_enter(unsigned to_submit) {
+    return __syscall_errno(__sys_ring_enter(to_submit));
+}
+
+struct ring_sqe *ring_get_sqe(struct petix_ring *ring) {
+    if (local_tail - ring->sq_head >= RING_SQ_ENTRIES) {
+        return NULL;
+    }
+    return &(ring->sq[local_tail++ & (RING_SQ_ENTRIES-1)]);
+}
+
+int ring_submit(struct petix_ring *ring) {
+    ring->sq_tail = local_tail;
+    return ring_enter(0);
+}
+
+struct ring_cqe *ring_peek_cqe(struct petix_ring *ring) {
+    if (ring->cq_head == ring->cq_tail) {
+        return NULL;
+    }
+    return &(ring->cq[ring->cq_head & (RING_CQ_ENTRIES-1)]);
+}
+
+void ring_cqe_seen(struct petix_ring *ring) {
+    ring->cq_head++;
+}
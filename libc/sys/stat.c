@@ -0,0 +1,10 @@
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+int stat(const char *path, struct stat *buf) {
+    return __syscall_errno(__sys_stat(path, buf));
+}
+
+int fstat(int fd, struct stat *buf) {
+    return __syscall_errno(__sys_fstat(fd, buf));
+}
@@ -0,0 +1,10 @@
+#include <sys/uio.h>
+#include <sys/syscall.h>
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt) {
+    return __syscall_errno(__sys_readv(fd, iov, iovcnt));
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
+    return __syscall_errno(__sys_writev(fd, iov, iovcnt));
+}
@@ -0,0 +1,56 @@
+#include <sys/vdata.h>
+
+#define barrier() asm volatile ("" ::: "memory")
+
+static const struct petix_vdata *const vdata =
+    (const struct petix_vdata *) VDATA_ADDR;
+
+// 64 bit loads aren't atomic here, so retry until the kernel wasn't
+// updating the page while we read it.
+#define VDATA_READ(field) ({                      \
+    uint32_t seq;                                 \
+    uint64_t val;                                 \
+    do {                                          \
+        seq = vdata->seq;                         \
+        barrier();                                \
+        val = vdata->field;                       \
+        barrier();                                \
+    } while ((seq & 1) || seq != vdata->seq);     \
+    val;                                          \
+})
+
+uint64_t vdata_ticks(void) {
+    return VDATA_READ(ticks);
+}
+
+static uint64_t rdtsc(void) {
+    uint64_t tsc;
+    asm volatile ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+uint64_t vdata_monotonic_ns(void) {
+    uint32_t seq;
+    uint64_t ns, base;
+    uint32_t mult, shift;
+    do {
+        seq = vdata->seq;
+        barrier();
+        ns = vdata->mono_ns;
+        base = vdata->tsc_base;
+        mult = vdata->tsc_mult;
+        shift = vdata->tsc_shift;
+        barrier();
+    } while ((seq & 1) || seq != vdata->seq);
+
+    if (mult == 0) {
+        return ns;
+    }
+    // straight from the tsc, so it never goes back, even across ticks
+    return vdata_cycles_to_ns(rdtsc() - base, mult, shift);
+}
+
+uint64_t vdata_realtime_ns(void) {
+    // only written before the first process
+    return vdata->boot_realtime_ns + vdata_monotonic_ns();
+}
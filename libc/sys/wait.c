@@ -7,5 +7,5 @@ pid_t wait(int *wstatus) {
 }
 
 pid_t waitpid(pid_t pid, int *wstatus, int options) {
-    return raw_syscall_errno(SYS_NR_WAITPID, pid, wstatus, options);
+    return __syscall_errno(__sys_waitpid(pid, wstatus, options));
 }
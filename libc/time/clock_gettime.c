@@ -0,0 +1,19 @@
+#include <time.h>
+#include <errno.h>
+#include <sys/vdata.h>
+
+int clock_gettime(clockid_t clk, struct timespec *ts) {
+    uint64_t ns;
+    if (clk == CLOCK_MONOTONIC) {
+        ns = vdata_monotonic_ns();
+    } else if (clk == CLOCK_REALTIME) {
+        ns = vdata_realtime_ns();
+    } else {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ts->tv_sec = ns / 1000000000;
+    ts->tv_nsec = ns % 1000000000;
+    return 0;
+}
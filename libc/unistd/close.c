@@ -2,5 +2,5 @@
 #include <sys/syscall.h>
 
 int close(int fd) {
-    return raw_syscall_errno(SYS_NR_CLOSE, fd);
+    return __syscall_errno(__sys_close(fd));
 }
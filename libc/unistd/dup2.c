@@ -2,5 +2,5 @@
 #include <sys/syscall.h>
 
 int dup2(int fd, int fd2) {
-    return raw_syscall(SYS_NR_DUP2, fd, fd2);
+    return __syscall_errno(__sys_dup2(fd, fd2));
 }
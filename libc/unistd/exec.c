@@ -4,7 +4,7 @@
 
 
 int execve(const char *path, char *const argv[], char *const envp[]) {
-    return raw_syscall_errno(SYS_NR_EXEC, path, argv, envp);
+    return __syscall_errno(__sys_exec(path, argv, envp));
 }
 
 int execvp(const char *path, char *const argv[]) {
@@ -3,5 +3,5 @@
 
 
 void _exit(int status) {
-    raw_syscall_errno(SYS_NR_EXIT, status);
+    __sys_exit(status);
 }
@@ -3,5 +3,5 @@
 
 
 pid_t fork(void) {
-    return raw_syscall_errno(SYS_NR_FORK);
+    return __syscall_errno(__sys_fork());
 }
@@ -0,0 +1,12 @@
+#include <unistd.h>
+#include <sys/vdata.h>
+
+// read from the per-process vdata page, no syscall needed
+
+pid_t getpid(void) {
+    return ((const struct petix_vdata_proc *) VDATA_PROC_ADDR)->pid;
+}
+
+pid_t getppid(void) {
+    return ((const struct petix_vdata_proc *) VDATA_PROC_ADDR)->ppid;
+}
@@ -0,0 +1,15 @@
+#include <unistd.h>
+#include <sys/syscall.h>
+
+off_t lseek(int fd, off_t offset, int whence) {
+    struct sys_lseek_args args = {
+        .fd = fd,
+        .whence = whence,
+        .off = offset,
+    };
+
+    if (__syscall_errno(__sys_lseek(&args)) == -1) {
+        return -1;
+    }
+    return args.off;
+}
@@ -6,5 +6,5 @@ int pipe(int filedes[2]) {
 }
 
 int pipe2(int filedes[2], int flags) {
-    return raw_syscall_errno(SYS_NR_PIPE, filedes, flags);
+    return __syscall_errno(__sys_pipe(filedes, flags));
 }
@@ -0,0 +1,22 @@
+#include <unistd.h>
+#include <sys/syscall.h>
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+    struct sys_pread_args args = {
+        .fd = fd,
+        .buf = buf,
+        .count = count,
+        .off = offset,
+    };
+    return __syscall_errno(__sys_pread(&args));
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    struct sys_pread_args args = {
+        .fd = fd,
+        .buf = (void *) buf,
+        .count = count,
+        .off = offset,
+    };
+    return __syscall_errno(__sys_pwrite(&args));
+}
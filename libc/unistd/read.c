@@ -2,5 +2,5 @@
 #include <sys/syscall.h>
 
 ssize_t read(int fd, void *buf, size_t count) {
-    return raw_syscall_errno(SYS_NR_READ, fd, buf, count);
+    return __syscall_errno(__sys_read(fd, buf, count));
 }
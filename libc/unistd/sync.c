@@ -0,0 +1,6 @@
+#include <unistd.h>
+#include <sys/syscall.h>
+
+void sync(void) {
+    __sys_sync();
+}
@@ -2,5 +2,5 @@
 #include <sys/syscall.h>
 
 ssize_t write(int fd, const void *buf, size_t count) {
-    return raw_syscall_errno(SYS_NR_WRITE, fd, buf, count);
+    return __syscall_errno(__sys_write(fd, buf, count));
 }